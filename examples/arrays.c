@@ -0,0 +1,49 @@
+int printf(const char* fmt, ...);
+
+int g[8];
+double weights[4];
+
+int sum(int v[], int n) {
+    int s = 0;
+    for (int i = 0; i < n; i = i + 1) s = s + v[i];
+    return s;
+}
+
+void scale(float* dst, float* src, float k, int n) {
+    for (int i = 0; i < n; i = i + 1) {
+        dst[i] = src[i] * k;
+    }
+}
+
+int counter() {
+    static int calls = 10;
+    calls = calls + 1;
+    return calls;
+}
+
+int main() {
+    int a[16];
+    float x[64];
+    float y[64];
+    char name[4];
+    static long hist[3];
+    for (int i = 0; i < 16; i = i + 1) a[i] = i * i;
+    for (int i = 0; i < 64; i = i + 1) x[i] = i;
+    float half = 0.5;
+    scale(y, x, half, 64);
+    for (int i = 0; i < 8; i = i + 1) g[i] = a[i] + a[15 - i];
+    a[3] += 100;
+    g[2] *= 3;
+    name[0] = 'h'; name[1] = 'i'; name[2] = '!'; name[3] = 0;
+    hist[1] = 5;
+    hist[1] += 2;
+    weights[2] = 1.5;
+    printf("%d %d %d\n", sum(a, 16), sum(g, 8), a[3]);
+    double y10 = y[10];
+    double y63 = y[63];
+    printf("%f %f %s %ld %f\n", y10, y63, name, hist[1], weights[2]);
+    int* p = a;
+    p[5] = 7;
+    printf("%d %d %d\n", a[5], *p, counter() + counter());
+    return 0;
+}
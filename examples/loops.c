@@ -0,0 +1,51 @@
+int printf(const char* fmt, ...);
+
+int main() {
+    int sum = 0;
+    for (int i = 0; i < 10; i = i + 1) {
+        if (i == 3) continue;
+        if (i == 8) break;
+        sum = sum + i;
+    }
+    printf("%d\n", sum);
+
+    int j;
+    for (j = 0; j < 5; j = j + 1);
+    printf("%d\n", j);
+
+    int n = 0;
+    for (;;) {
+        n = n + 1;
+        if (n > 4) break;
+    }
+    printf("%d\n", n);
+
+    int k = 10;
+    do {
+        k = k - 3;
+        if (k == 4) continue;
+        printf("%d ", k);
+    } while (k > 0);
+    printf("\n");
+
+    int total = 0;
+    int row = 0;
+    while (row < 4) {
+        row = row + 1;
+        if (row == 2) continue;
+#pragma unroll 2
+        for (int col = 0; col < row; col = col + 1) {
+            if (col == 2) break;
+            total = total + row * col;
+        }
+    }
+    printf("%d\n", total);
+
+    int m = 0;
+#pragma vectorize
+    for (int v = 0; v < 100; v = v + 1) m = m + v;
+#pragma nounroll
+    while (m > 1000) m = m - 1000;
+    printf("%d\n", m);
+    return 0;
+}
@@ -0,0 +1,32 @@
+int printf(const char* fmt, ...);
+
+int calls = 0;
+
+int side(int v) {
+    calls = calls + 1;
+    return v;
+}
+
+int positive(int* p) {
+    if (p && *p > 0) return 1;
+    return 0;
+}
+
+int main() {
+    int x = 5, y = -1;
+    int a = side(0) && side(1);
+    int b = side(1) || side(0);
+    int c = side(1) && side(2);
+    int d = side(0) || side(0);
+    printf("%d %d %d %d %d\n", a, b, c, d, calls);
+    printf("%d %d\n", positive(&x), positive(&y));
+
+    int i = 0, n = 0;
+    while (i < 10 && !(i == 7 || side(0))) {
+        n = n + i;
+        i = i + 1;
+    }
+    if (!(x > 3) || (x < 10 && side(1))) printf("%d %d\n", n, calls);
+    if (x > 3 && x < 4) printf("unreachable\n");
+    return 0;
+}
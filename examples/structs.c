@@ -0,0 +1,82 @@
+int printf(const char* fmt, ...);
+
+struct point {
+    int x;
+    int y;
+};
+
+struct particle {
+    char alive;
+    double mass;
+    short id;
+    struct point pos;
+    float vel[3];
+};
+
+union value {
+    char c;
+    int i;
+    double d;
+    char bytes[12];
+};
+
+struct node {
+    int v;
+    struct node* next;
+};
+
+struct point origin;
+
+void move(struct point* p, int dx, int dy) {
+    p->x = p->x + dx;
+    p->y += dy;
+}
+
+int total(struct node* n, int count) {
+    int sum = 0;
+    for (int i = 0; i < count; i = i + 1) {
+        sum = sum + n->v;
+        n = n->next;
+    }
+    return sum;
+}
+
+int main() {
+    struct particle ps[4];
+    for (int i = 0; i < 4; i = i + 1) {
+        ps[i].alive = 1;
+        ps[i].mass = i * 0.5;
+        ps[i].id = i + 100;
+        ps[i].pos.x = i;
+        ps[i].pos.y = -i;
+        ps[i].vel[2] = i * 2;
+    }
+    move(&ps[2].pos, 10, 20);
+    struct particle* q = &ps[3];
+    q->pos = ps[2].pos;
+    double m = q->mass;
+    double v = ps[1].vel[2];
+    printf("%d %d %d %f %f\n", ps[2].pos.x, ps[2].pos.y, q->pos.x + q->id, m, v);
+
+    union value u;
+    u.i = 0;
+    u.c = 65;
+    printf("%d %ld %ld\n", u.i, sizeof(union value), _Alignof(union value));
+
+    struct node c;
+    struct node b;
+    struct node a;
+    a.v = 1; a.next = &b;
+    b.v = 2; b.next = &c;
+    c.v = 3; c.next = &a;
+    printf("%d\n", total(&a, 5));
+
+    static struct point last;
+    last.x = 7;
+    move(&origin, 1, 2);
+    printf("%d %d %d\n", origin.x, origin.y, last.x + last.y);
+
+    printf("%ld %ld %ld %ld\n", sizeof(struct point), sizeof(struct particle), _Alignof(struct particle), sizeof ps);
+    printf("%ld %ld %ld\n", sizeof(struct node*), sizeof(q->vel), sizeof(ps[0].pos));
+    return 0;
+}
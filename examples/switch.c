@@ -0,0 +1,102 @@
+int printf(const char* fmt, ...);
+
+int dense(int op, int a, int b) {
+    int r = 0;
+    switch (op) {
+        case 0: r = a + b; break;
+        case 1: r = a - b; break;
+        case 2: r = a * b; break;
+        case 3:
+        case 4: r = a / b; break;
+        case 6: r = a % b;
+        case 7: r = r + 100; break;
+        default: r = -1;
+    }
+    return r;
+}
+
+int sparse(int v) {
+    long x = v;
+    switch (x) {
+        case -1000: return 1;
+        case 7: return 2;
+        case 100000: return 3;
+    }
+    return 0;
+}
+
+int classify(char c) {
+    int kind = 0;
+    switch (c) {
+        default:
+            kind = 9;
+            break;
+        case 'a': case 'e': case 'i': case 'o': case 'u':
+            kind = 1;
+            break;
+        case ' ':
+            kind = 2;
+    }
+    return kind;
+}
+
+int run(int* code, int n, int scale, int base) {
+    int acc = 0;
+    int pc = 0;
+    while (pc < n) {
+        int op = code[pc];
+        pc = pc + 1;
+        switch (op) {
+            case 0: acc = acc + scale * base; break;
+            case 1: acc = acc - (scale + base) / 7; break;
+            case 2:
+                if (acc > 1000) continue;
+                acc = acc * 2;
+                break;
+            case 3: return acc;
+            default: acc = acc + 1;
+        }
+        acc = acc + base % 5;
+    }
+    return acc;
+}
+
+int folded(int a) {
+    int mode = 2;
+    int r = 0;
+    switch (mode) {
+        int unused;
+        case 1: r = a + 1; break;
+        case 2: unused = 5; r = a * 3;
+        case 3: r = r + unused; break;
+        default: r = -a;
+    }
+    switch (mode + 5) {
+        case 1: r = 0;
+    }
+    return r;
+}
+
+int main() {
+    int i = 0;
+    while (i < 9) {
+        printf("%d ", dense(i, 17, 5));
+        i = i + 1;
+    }
+    printf("\n%d %d %d %d\n", sparse(-1000), sparse(7), sparse(100000), sparse(8));
+    printf("%d %d %d\n", classify('e'), classify(' '), classify('z'));
+    int n = 0;
+    while (1) {
+        switch (n) {
+            case 3: n = n + 10;
+        }
+        if (n > 10) break;
+        n = n + 1;
+    }
+    printf("%d\n", n);
+    int code[8];
+    code[0] = 0; code[1] = 2; code[2] = 1; code[3] = 5;
+    code[4] = 2; code[5] = 0; code[6] = 3; code[7] = 0;
+    printf("%d %d %d\n", run(code, 8, 6, 9), run(code, 6, 100, 20), folded(4));
+    return 0;
+}
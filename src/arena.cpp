@@ -0,0 +1,81 @@
+#include <cstdlib>
+#include <new>
+#include "arena.hpp"
+#include "timer.hpp"
+
+thread_local Arena* Arena::current = nullptr;
+
+Arena::Arena(): blocks(), cur{nullptr}, end{nullptr}, dtors(), dtor_slots(), n_tagged{}, bytes_used{0}, bytes_reserved{0}, n_objects{0}, n_released{0}, free_lists() {}
+
+Arena::~Arena() {
+  for (auto it = dtors.rbegin(); it != dtors.rend(); ++it) {
+    if (it->second) it->second(it->first);
+  }
+  for (char* block : blocks) {
+    std::free(block);
+  }
+  if (current == this) {
+    current = nullptr;
+  }
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+  size_t pad = (align - (reinterpret_cast<size_t>(cur) & (align - 1))) & (align - 1);
+  if (!cur || cur + pad + size > end) {
+    // oversized requests get a block of their own
+    size_t bsize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+    char* block = static_cast<char*>(std::malloc(bsize));
+    if (!block) throw std::bad_alloc();
+    count_alloc();
+    blocks.push_back(block);
+    bytes_reserved += bsize;
+    cur = block;
+    end = block + bsize;
+    pad = (align - (reinterpret_cast<size_t>(cur) & (align - 1))) & (align - 1);
+  }
+  count_alloc();
+  void* p = cur + pad;
+  cur += pad + size;
+  bytes_used += size;
+  n_objects++;
+  return p;
+}
+
+void Arena::register_dtor(void* obj, void (*dtor)(void*)) {
+  dtor_slots[obj] = dtors.size();
+  dtors.push_back({obj, dtor});
+}
+
+// the slot stays, so the indices of later registrations do not move
+void Arena::unregister_dtor(void* obj) {
+  auto it = dtor_slots.find(obj);
+  if (it == dtor_slots.end()) return;
+  dtors[it->second].second = nullptr;
+  dtor_slots.erase(it);
+}
+
+void* Arena::reuse(size_t size) {
+  auto it = free_lists.find(size);
+  if (it == free_lists.end() || it->second.empty()) return nullptr;
+  count_alloc();
+  void* p = it->second.back();
+  it->second.pop_back();
+  n_released--;
+  return p;
+}
+
+void Arena::release(void* obj, size_t size) {
+  free_lists[size].push_back(obj);
+  n_released++;
+}
+
+Arena* Arena::active() {
+  // nodes created outside any translation unit (e.g. by test drivers) land
+  // in a thread-lifetime arena
+  static thread_local Arena fallback;
+  return current ? current : &fallback;
+}
+
+void Arena::set_active(Arena* arena) {
+  current = arena;
+}
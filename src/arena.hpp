@@ -0,0 +1,68 @@
+#ifndef ARENA
+#define ARENA
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Bump allocator backing every AST node of a translation unit. The whole
+// arena is torn down in one go when its owner dies: its blocks are freed
+// without visiting the objects in them. Only the few objects that own heap
+// memory (vectors, sets) register a destructor thunk, which is run in reverse
+// registration order at teardown. Objects that became unreachable (folded
+// subtrees) can be released; their memory is handed out again to the next
+// allocation of the same size, whose owner destroys the old occupant and
+// unregisters its thunk first. Owners can tag their objects (AST nodes use
+// their kind) to have the live ones counted for statistics.
+class Arena {
+public:
+    static const size_t MAX_TAGS = 64;
+
+private:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<char*> blocks;
+    char* cur;
+    char* end;
+    std::vector<std::pair<void*, void (*)(void*)>> dtors;     // a null thunk was unregistered
+    std::unordered_map<void*, size_t> dtor_slots;               // index into dtors
+    size_t n_tagged[MAX_TAGS];                                  // live objects with each tag
+    size_t bytes_used;
+    size_t bytes_reserved;
+    size_t n_objects;
+    size_t n_released;
+    std::unordered_map<size_t, std::vector<void*>> free_lists;    // by object size
+
+    static thread_local Arena* current;   // one unit per thread, see CompilerInstance
+
+public:
+    Arena();
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+    void register_dtor(void* obj, void (*dtor)(void*));
+    void unregister_dtor(void* obj);
+    void add_tagged(size_t tag) { n_tagged[tag]++; }
+    void remove_tagged(size_t tag) { n_tagged[tag]--; }
+    // previously released object of the given size, still constructed, or
+    // nullptr
+    void* reuse(size_t size);
+    void release(void* obj, size_t size);
+
+    size_t get_bytes_used() const { return bytes_used; }
+    size_t get_bytes_reserved() const { return bytes_reserved; }
+    size_t get_n_objects() const { return n_objects; }
+    size_t get_n_blocks() const { return blocks.size(); }
+    size_t get_n_released() const { return n_released; }
+    size_t get_n_tagged(size_t tag) const { return n_tagged[tag]; }
+
+    // arena that new AST nodes are placed in
+    static Arena* active();
+    static void set_active(Arena* arena);
+};
+
+#endif
@@ -1,7 +1,10 @@
 #include "ast.hpp"
 #include "debug.hpp"
 #include "error.hpp"
+#include <charconv>
+#include <climits>
 #include <cmath>
+#include <cstdlib>
 #include <sstream>
 
 #define I32_MOD (1ULL<<32)
@@ -118,61 +121,178 @@ string fs2str(FunctionSpecifier fs) {
   }
 }
 
-Identifier::Identifier(string _name) : name(_name) {    // is this fine? Jai
-    cdebug << "Identifier constructor called with name: " << _name << endl;
+// Node types with members that own heap memory. The arena runs the
+// destructors of these only, every other node is freed with its block.
+static bool owns_heap(NodeKind kind) {
+  switch (kind) {
+    case NK_CALL:                       // params
+    case NK_SWITCH:                     // cases
+    case NK_BLOCK:                      // the statements
+    case NK_RECORD_SPECIFIER:           // fields
+    case NK_DECLARATION_SPECIFIERS:     // the specifier sets
+    case NK_PARAMETER_LIST:             // params
+    case NK_DECLARATION:                // decl_list
+      return true;
+    default:
+      return false;
+  }
+}
+
+static_assert(NK_TRANSLATION_UNIT < Arena::MAX_TAGS, "node kinds are arena tags");
+
+Node::Node(NodeKind _kind) : kind(_kind) {
+  Arena* arena = Arena::active();
+  arena->add_tagged(kind);
+  if (owns_heap(kind)) {
+    arena->register_dtor(this, [](void* obj) { static_cast<Node*>(obj)->~Node(); });
+  }
+}
+
+void* Node::operator new(size_t size) {
+  Arena* arena = Arena::active();
+  if (void* p = arena->reuse(size)) {
+    // the released node is only destroyed now, the new one registers itself
+    Node* old = static_cast<Node*>(p);
+    if (owns_heap(old->kind)) arena->unregister_dtor(p);
+    old->~Node();
+    return p;
+  }
+  return arena->allocate(size);
+}
+
+static size_t node_size(NodeKind kind) {
+  switch (kind) {
+    case NK_IDENTIFIER: return sizeof(Identifier);
+    case NK_TERNARY: return sizeof(TernaryExpression);
+    case NK_CALL: return sizeof(FunctionInvocationExpression);
+    case NK_BINARY: return sizeof(BinaryExpression);
+    case NK_UNARY: return sizeof(UnaryExpression);
+    case NK_SUBSCRIPT: return sizeof(SubscriptExpression);
+    case NK_MEMBER: return sizeof(MemberExpression);
+    case NK_TYPE_NAME: return sizeof(TypeName);
+    case NK_LITERAL: return sizeof(Literal);
+    case NK_DECLARATION_STATEMENT: return sizeof(DeclarationStatement);
+    case NK_EXPRESSION_STATEMENT: return sizeof(ExpressionStatement);
+    case NK_IF: return sizeof(IfStatement);
+    case NK_SWITCH: return sizeof(SwitchStatement);
+    case NK_WHILE: return sizeof(WhileStatement);
+    case NK_DO_WHILE: return sizeof(DoWhileStatement);
+    case NK_FOR: return sizeof(ForStatement);
+    case NK_RETURN: return sizeof(ReturnStatement);
+    case NK_GOTO: return sizeof(GotoStatement);
+    case NK_CONTINUE: return sizeof(ContinueStatement);
+    case NK_BREAK: return sizeof(BreakStatement);
+    case NK_BLOCK: return sizeof(BlockStatement);
+    case NK_LABELED: return sizeof(LabeledStatement);
+    case NK_CASE: return sizeof(CaseStatement);
+    case NK_RECORD_SPECIFIER: return sizeof(RecordSpecifier);
+    case NK_DECLARATION_SPECIFIERS: return sizeof(DeclarationSpecifiers);
+    case NK_PURE_DECLARATION: return sizeof(PureDeclaration);
+    case NK_PARAMETER_LIST: return sizeof(FunctionParameterList);
+    case NK_INIT_DECLARATOR: return sizeof(InitDeclarator);
+    case NK_DECLARATION: return sizeof(Declaration);
+    case NK_FUNCTION: return sizeof(Function);
+    case NK_TRANSLATION_UNIT: return sizeof(TranslationUnit);
+  }
+  llvm_unreachable("unknown node kind");
+}
+
+const char* node_kind_name(NodeKind kind) {
+  switch (kind) {
+    case NK_IDENTIFIER: return "Identifier";
+    case NK_TERNARY: return "TernaryExpression";
+    case NK_CALL: return "FunctionInvocationExpression";
+    case NK_BINARY: return "BinaryExpression";
+    case NK_UNARY: return "UnaryExpression";
+    case NK_SUBSCRIPT: return "SubscriptExpression";
+    case NK_MEMBER: return "MemberExpression";
+    case NK_TYPE_NAME: return "TypeName";
+    case NK_LITERAL: return "Literal";
+    case NK_DECLARATION_STATEMENT: return "DeclarationStatement";
+    case NK_EXPRESSION_STATEMENT: return "ExpressionStatement";
+    case NK_IF: return "IfStatement";
+    case NK_SWITCH: return "SwitchStatement";
+    case NK_WHILE: return "WhileStatement";
+    case NK_DO_WHILE: return "DoWhileStatement";
+    case NK_FOR: return "ForStatement";
+    case NK_RETURN: return "ReturnStatement";
+    case NK_GOTO: return "GotoStatement";
+    case NK_CONTINUE: return "ContinueStatement";
+    case NK_BREAK: return "BreakStatement";
+    case NK_BLOCK: return "BlockStatement";
+    case NK_LABELED: return "LabeledStatement";
+    case NK_CASE: return "CaseStatement";
+    case NK_RECORD_SPECIFIER: return "RecordSpecifier";
+    case NK_DECLARATION_SPECIFIERS: return "DeclarationSpecifiers";
+    case NK_PURE_DECLARATION: return "PureDeclaration";
+    case NK_PARAMETER_LIST: return "FunctionParameterList";
+    case NK_INIT_DECLARATOR: return "InitDeclarator";
+    case NK_DECLARATION: return "Declaration";
+    case NK_FUNCTION: return "Function";
+    case NK_TRANSLATION_UNIT: return "TranslationUnit";
+  }
+  llvm_unreachable("unknown node kind");
+}
+
+void Node::release(Node* node) {
+  Arena* arena = Arena::active();
+  arena->remove_tagged(node->kind);
+  arena->release(node, node_size(node->kind));
+}
+
+Identifier::Identifier(istring _name) : Expression(NK_IDENTIFIER), name(_name) {    // is this fine? Jai
+    cdebug << "Identifier constructor called with name: " << *_name << endl;
 }
 
 TernaryExpression::TernaryExpression(Expression *_cond,
                                      Expression *_true_branch,
                                      Expression *_false_branch)
-    : cond(_cond), true_branch(_true_branch), false_branch(_false_branch) {
+    : Expression(NK_TERNARY), cond(_cond), true_branch(_true_branch), false_branch(_false_branch) {
     cdebug << "TernaryExpression constructor called" << endl;
 }
 
-TernaryExpression::~TernaryExpression() {
-    cdebug << "TernaryExpression destructor called" << endl;
-    delete cond;
-    delete true_branch;
-    delete false_branch;
-}
-
 FunctionInvocationExpression::FunctionInvocationExpression(Expression *_fn)
-    : fn(_fn) {
+    : Expression(NK_CALL), fn(_fn) {
     cdebug << "FunctionInvocationExpression constructor called" << endl;
 }
 
 FunctionInvocationExpression::FunctionInvocationExpression(
     Expression *_fn, vector<Expression *> *_params)
-    : fn(_fn), params(_params) {
+    : Expression(NK_CALL), fn(_fn), params(_params) {
     cdebug << "FunctionInvocationExpression constructor called with params" << endl;
 }
 
 FunctionInvocationExpression::~FunctionInvocationExpression() {
     cdebug << "FunctionInvocationExpression destructor called" << endl;
-    delete fn;
-    for (auto expr : *params) {
-        delete expr;
-    }
     delete params;
 }
 
 BinaryExpression::BinaryExpression(Expression *_lhs, Operator _op,
                                    Expression *_rhs)
-    : lhs(_lhs), op(_op), rhs(_rhs) {
+    : Expression(NK_BINARY), lhs(_lhs), op(_op), rhs(_rhs) {
     cdebug << "BinaryExpression constructor called" << endl;
 }
 
-BinaryExpression::~BinaryExpression() {
-    cdebug << "BinaryExpression destructor called" << endl;
-    delete lhs;
-    delete rhs;
-}
-
 UnaryExpression::UnaryExpression(Operator _op, Expression *_expr)
-    : op(_op), expr(_expr) {
+    : Expression(NK_UNARY), op(_op), expr(_expr) {
     cdebug << "UnaryExpression constructor called" << endl;
 }
 
+SubscriptExpression::SubscriptExpression(Expression *_base, Expression *_index)
+    : Expression(NK_SUBSCRIPT), base(_base), index(_index) {
+    cdebug << "SubscriptExpression constructor called" << endl;
+}
+
+MemberExpression::MemberExpression(Expression *_base, istring _field, bool _arrow)
+    : Expression(NK_MEMBER), base(_base), field(_field), arrow(_arrow) {
+    cdebug << "MemberExpression constructor called" << endl;
+}
+
+TypeName::TypeName(DeclarationSpecifiers* _decl_specs, int _ptr_depth)
+    : Expression(NK_TYPE_NAME), decl_specs(_decl_specs), ptr_depth(_ptr_depth) {
+    cdebug << "TypeName constructor called" << endl;
+}
+
 int hex2int(char c) {
   if (c >= '0' && c <= '9') return c - '0';
   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
@@ -195,126 +315,121 @@ char get_esc_char(char c) {
   return esctab[c];
 }
 
-void parse_int_literal(Literal* literal) {
-  string value = literal->value;
-  int i = 0;
-  if (value[0] == '0') {
-    i = 1;
-    if (value.size() == 1) { literal->data.i = 0; literal->ltype = LT_INT32; return; }
-    if (value[1] == 'x' || value[1] == 'X') { // hex 
-      i = 2;
-      for (; i<value.size(); i++) {
-        if (!isxdigit(value[i])) break;
-        literal->data.l = (literal->data.l*16) + hex2int(value[i]);
-      }
-    }
-    else {
-      for (; i<value.size(); i++) {
-        if (value[i] < '0' || value[i] > '7') break;
-        literal->data.l = (literal->data.l*8) + (value[i] - '0');
-      }
-    }
-  }
-  else if (isdigit(value[0])) {
-    for (; i<value.size(); i++) {
-      if (value[i] < '0' || value[i] > '9') break;
-      literal->data.l = (literal->data.l*10) + (value[i] - '0');
+// u, l, ll and U, L, LL in either order, but not lL or Ll
+static bool parse_int_suffix(const char* suffix, bool& is_unsigned, int& longs) {
+  is_unsigned = false;
+  longs = 0;
+  for (int i = 0; suffix[i]; i++) {
+    if ((suffix[i] == 'u' || suffix[i] == 'U') && !is_unsigned) is_unsigned = true;
+    else if ((suffix[i] == 'l' || suffix[i] == 'L') && !longs) {
+      longs = 1;
+      if (suffix[i + 1] == suffix[i]) { longs = 2; i++; }
     }
+    else return false;
   }
-  else if (value[0] == 'u' || value[0] == '\'') {
+  return true;
+}
+
+// The value is accumulated in a single pass with overflow checks, and the
+// type is the first of the candidates of C11 6.4.4.1 that can hold it:
+// octal and hex constants may become unsigned, decimal ones only get longer.
+// long and long long are both 64 bits wide here.
+void parse_int_literal(Literal* literal, const string& value) {
+  if (value[0] == 'u' || value[0] == '\'') {
     // char
-    i = 1;
+    int i = 1;
     if (value[i] == '\'') i++;
     // check escapes and stuff
     // we don't handle unicode sequences
     if (value[i] == '\\') {
       i++;
-      literal->data.c = get_esc_char(value[i]);
+      literal->data.l = get_esc_char(value[i]);
     }
-    else literal->data.c = value[i];
+    else literal->data.l = value[i];
     literal->ltype = LT_CHAR;
     return;
   }
 
-  if (i >= value.size()) { literal->ltype = LT_INT32; return; }
-  if (value[i] == 'u' || value[i] == 'U') {
-    i++;
-    if (i >= value.size()) { literal->ltype = LT_UINT32; return; }
-    literal->ltype = LT_UINT64; return; // can only be l, L, ll or LL
+  unsigned base = 10;
+  int i = 0;
+  if (value[0] == '0' && value.size() > 1 && (value[1] == 'x' || value[1] == 'X')) { base = 16; i = 2; }
+  else if (value[0] == '0') base = 8;
+
+  unsigned long n = 0;
+  bool overflow = false;
+  for (; i < value.size() && isxdigit(value[i]); i++) {
+    unsigned digit = hex2int(value[i]);
+    if (digit >= base) break;
+    overflow |= __builtin_mul_overflow(n, base, &n);
+    overflow |= __builtin_add_overflow(n, digit, &n);
   }
-  else if (value[i] == 'l' || value[i] == 'L') {
-    i++;
-    if (i >= value.size()) { literal->ltype = LT_INT64; return; }
-    i++;
-    if (i >= value.size()) { literal->ltype = LT_INT64; return; }
-    if (value[i] == 'U' || value[i] == 'u') { literal->ltype = LT_UINT64; return; }
-    i++;
-    if (i >= value.size()) { literal->ltype = LT_INT64; return; }
-    if (value[i] == 'U' || value[i] == 'u') { literal->ltype = LT_UINT64; return; }
+
+  bool is_unsigned;
+  int longs;
+  if (!parse_int_suffix(value.c_str() + i, is_unsigned, longs)) {
+    ehdl::report(ehdl::E_INT_LITERAL, literal->pos);
+    return;
   }
-  ehdl::err("Could not parse int literal", literal->pos);
-  return;
-}
-
-void parse_float_literal(Literal* literal) {
-  double d = 0.0;
-  string value = literal->value;
-
-  // floats are guaranteed to have two chars atleast
-  int fpos=0, i=0;
-  bool hexfloat = false;
-  if (value[0] == '0' && (value[1] == 'x' || value[1] == 'X')) {
-    // hexfloat
-    // find the position of the fp first 
-    hexfloat = true;
-    fpos = i = 2;
-    int neg = -1;
-    while (fpos < value.size() && value[fpos] != '.') fpos++;
-    for (; i<value.size(); i++) {
-      if (!isxdigit(value[i]) && value[i] != '.') break;
-      if (value[i] == '.') { neg = 0; continue; }
-      d += double(hex2int(value[i])) * pow(16, fpos-i+neg);
-    }
+  if (overflow) {
+    ehdl::report(ehdl::E_INT_TOO_LARGE, literal->pos);
   }
+
+  if (is_unsigned) literal->ltype = (!longs && n <= UINT_MAX) ? LT_UINT32 : LT_UINT64;
+  else if (!longs && n <= INT_MAX) literal->ltype = LT_INT32;
+  else if (!longs && base != 10 && n <= UINT_MAX) literal->ltype = LT_UINT32;
+  else if (n <= LONG_MAX) literal->ltype = LT_INT64;
   else {
-    // intfloat
-    int neg = -1;
-    while (fpos < value.size() && value[fpos] != '.') fpos++;
-    for (; i<value.size(); i++) {
-      if (!isdigit(value[i]) && value[i] != '.') break;
-      if (value[i] == '.') {neg = 0; continue; }
-      d += double(value[i] - '0') * pow(10, fpos-i+neg);
-    }
+    if (base == 10) ehdl::report(ehdl::W_INT_SO_LARGE_UNSIGNED, literal->pos);
+    literal->ltype = LT_UINT64;
   }
-  if (i < value.size() && (value[i] == 'p' || value[i] == 'P' || value[i] == 'e' || value[i] == 'E')) {
-    // exponent
-    i++;
-    int exp = 0;
-    int sign = 1;
-    if (i < value.size()) {
-      if (value[i] == '-') { sign = -1; i++; }
-      else if (value[i] == '+') { i++; }
-    }
-    for (;i < value.size(); i++) {
-      if (!isdigit(value[i])) break;
-      exp = (exp*10) + (value[i] - '0');
-    }
-    exp *= sign;
-    if (hexfloat) d *= pow(2, exp);
-    else d *= pow(10, exp);
-  }
-  if (i < value.size() && value[i] == 'f') {
+  literal->data.l = n;          // fits the type, so already normalized
+}
+
+// text of a decimal, or hex without its 0x, to a correctly rounded T.
+// Returns false if the value is too large for T. libstdc++'s from_chars is
+// an Eisel-Lemire fast path with an exact fallback for the rare hard cases;
+// standard libraries without floating point from_chars go through strtod,
+// which is just as exact but slower.
+template<typename T>
+static bool parse_fp(const char* first, const char* last, bool hex, T& result) {
+#ifdef __cpp_lib_to_chars
+  auto [ptr, ec] = std::from_chars(first, last, result, hex ? std::chars_format::hex : std::chars_format::general);
+  if (ec == std::errc()) return true;
+  // out of range, from_chars leaves result alone
+#endif
+  string text = (hex ? "0x" : "") + string(first, last);
+  if constexpr (std::is_same<T, float>::value) result = strtof(text.c_str(), nullptr);
+  else result = strtod(text.c_str(), nullptr);
+  return !std::isinf(result);
+}
+
+void parse_float_literal(Literal* literal, const string& value) {
+  bool hex = value.size() > 1 && value[0] == '0' && (value[1] == 'x' || value[1] == 'X');
+  size_t end = value.size();
+  char suffix = value[end - 1];
+  // a hex float always ends in its binary exponent, so f is not a digit there
+  bool is_float = (suffix == 'f' || suffix == 'F');
+  if (is_float || suffix == 'l' || suffix == 'L') end--;          // long double is double
+
+  const char* first = value.data() + (hex ? 2 : 0);
+  const char* last = value.data() + end;
+  bool in_range;
+  literal->data.l = 0;
+  if (is_float) {
     literal->ltype = LT_FLOAT;
-    literal->data.f = d;
+    in_range = parse_fp(first, last, hex, literal->data.f);
   }
   else {
     literal->ltype = LT_DOUBLE;
-    literal->data.d = d;
+    in_range = parse_fp(first, last, hex, literal->data.d);
+  }
+  if (!in_range) {
+    ehdl::report(ehdl::W_FLOAT_OUT_OF_RANGE, literal->pos, {is_float ? "float" : "double"});
   }
 }
 
-void parse_string_literal(Literal *literal) {
-  string value = literal->value.substr(1, literal->value.size()-2);
+void parse_string_literal(Literal *literal, const string& text) {
+  string value = text.substr(1, text.size()-2);
   stringstream val_parsed;
   for (int i=0; i<value.size(); i++) {
     if (value[i] == '\\') {
@@ -323,36 +438,37 @@ void parse_string_literal(Literal *literal) {
     }
     else val_parsed << value[i];
   }
-  literal->value = val_parsed.str();
+  literal->value = intern(val_parsed.str());
 }
 
-Literal::Literal(string _value, LiteralType _ltype)
-    : value(_value), ltype(_ltype), data{0} {
+Literal::Literal(string _value, LiteralType _ltype, sympos _pos)
+    : Expression(NK_LITERAL), ltype(_ltype), data{0} {
+  pos = _pos;
   cdebug << "Literal constructor called with value: " << _value << endl;
   // parse literal to int/float etc
   // has to be done here for us to be able to evaluate literal expressions 
   // instantaneously
   switch (ltype) {
     case LT_INT_LIKE:
-      parse_int_literal(this);
+      parse_int_literal(this, _value);
       break;
     case LT_FLOAT_LIKE:
-      parse_float_literal(this);
+      parse_float_literal(this, _value);
       break;
     case LT_STRING:
-      parse_string_literal(this);
+      parse_string_literal(this, _value);
       break;
   }
 }
 
 Literal::Literal(long _data, LiteralType _ltype) :
-  data{0}, ltype(_ltype), value("") { data.l = _data; }
+  Expression(NK_LITERAL), data{0}, ltype(_ltype) { data.l = _data; }
 
 Literal::Literal(float _data, LiteralType _ltype) :
-  data{0}, ltype(_ltype), value("") { data.f = _data; }
+  Expression(NK_LITERAL), data{0}, ltype(_ltype) { data.f = _data; }
 
 Literal::Literal(double _data, LiteralType _ltype) :
-  data{0}, ltype(_ltype), value("") { data.d = _data; }
+  Expression(NK_LITERAL), data{0}, ltype(_ltype) { data.d = _data; }
 
 int get_rank(LiteralType ltype) {
   if (ltype == LT_BOOL) return 0;
@@ -422,6 +538,19 @@ LiteralType symbol_to_literal(SymbolType st){
   if (st == U8) return LT_CHAR;
 }
 
+// the narrow integer folds only write their own member of data; this keeps
+// data.l sign (or zero) extended from it, so that comparisons, widening and
+// lattice equality can read data.l for every integer type
+void normalize_literal(Literal* l) {
+  switch (l->ltype) {
+    case LT_CHAR: l->data.l = l->data.c; break;
+    case LT_SHORT: l->data.l = l->data.s; break;
+    case LT_INT32: l->data.l = l->data.i; break;
+    case LT_UINT32: l->data.l = (unsigned int) l->data.i; break;
+    default: break;
+  }
+}
+
 void assign_literals(SymbolType lhstype, Literal* rhslit) {
   if (rhslit->ltype == LT_STRING) {
 
@@ -449,7 +578,7 @@ void assign_literals(SymbolType lhstype, Literal* rhslit) {
             // cout << rhslit->data.f << endl;
           }
           else{
-            rhslit->data.l = floor(rhslit->data.d);
+            rhslit->data.l = long(rhslit->data.d);      // C truncates towards zero
           }
         break;
         case LT_FLOAT: 
@@ -476,6 +605,7 @@ void assign_literals(SymbolType lhstype, Literal* rhslit) {
     }
     rhslit->ltype = symbol_to_literal(lhstype);
   }
+  normalize_literal(rhslit);
 }
 
 void add_literals(Literal* lhs, Literal* rhs) {
@@ -505,6 +635,18 @@ void mul_literals(Literal* lhs, Literal* rhs) {
   else lhs->data.l *= rhs->data.l;
 }
 
+// true if dividing the widened integer literals would trap here: by zero, or
+// the most negative value by -1. Such divisions are left to run time.
+static bool division_traps(Literal* lhs, Literal* rhs) {
+  switch (lhs->ltype) {
+    case LT_FLOAT: case LT_DOUBLE: return false;
+    case LT_CHAR: return rhs->data.c == 0;
+    case LT_SHORT: return rhs->data.s == 0;
+    case LT_INT32: case LT_UINT32: return rhs->data.i == 0 || (lhs->data.i == INT_MIN && rhs->data.i == -1);
+    default: return rhs->data.l == 0 || (lhs->data.l == LONG_MIN && rhs->data.l == -1);
+  }
+}
+
 // Udiv different from sdiv?
 void div_literals(Literal* lhs, Literal* rhs) {
   // cout << rhs->ltype << " " << rhs->data.s << endl;
@@ -518,7 +660,7 @@ void div_literals(Literal* lhs, Literal* rhs) {
 }
 
 void mod_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::err("Can't take modulo of floating point literals", lhs->pos);
+  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::report(ehdl::E_FLOAT_LITERAL_OPERAND, lhs->pos, {"take modulo of"});
   else if (lhs->ltype == LT_CHAR) lhs->data.c %= rhs->data.c;
   else if (lhs->ltype == LT_SHORT) lhs->data.s %= rhs->data.s;
   else if (lhs->ltype == LT_INT32 || lhs->ltype == LT_UINT32) lhs->data.i %= rhs->data.i;
@@ -526,54 +668,54 @@ void mod_literals(Literal* lhs, Literal* rhs) {
 }
 
 void gt_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT) lhs->data.f = (lhs->data.f > rhs->data.f);
-  else if (lhs->ltype == LT_DOUBLE) lhs->data.d = (lhs->data.d > rhs->data.d);
+  if (lhs->ltype == LT_FLOAT) lhs->data.l = (lhs->data.f > rhs->data.f);
+  else if (lhs->ltype == LT_DOUBLE) lhs->data.l = (lhs->data.d > rhs->data.d);
   else lhs->data.l = (lhs->data.l > rhs->data.l);
   lhs->ltype = LT_BOOL;
 }
 
 void ge_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT) lhs->data.f = (lhs->data.f >= rhs->data.f);
-  else if (lhs->ltype == LT_DOUBLE) lhs->data.d = (lhs->data.d >= rhs->data.d);
+  if (lhs->ltype == LT_FLOAT) lhs->data.l = (lhs->data.f >= rhs->data.f);
+  else if (lhs->ltype == LT_DOUBLE) lhs->data.l = (lhs->data.d >= rhs->data.d);
   else lhs->data.l = (lhs->data.l >= rhs->data.l);
   lhs->ltype = LT_BOOL;
 }
 
 void lt_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT) lhs->data.f = (lhs->data.f < rhs->data.f);
-  else if (lhs->ltype == LT_DOUBLE) lhs->data.d = (lhs->data.d < rhs->data.d);
+  if (lhs->ltype == LT_FLOAT) lhs->data.l = (lhs->data.f < rhs->data.f);
+  else if (lhs->ltype == LT_DOUBLE) lhs->data.l = (lhs->data.d < rhs->data.d);
   else lhs->data.l = (lhs->data.l < rhs->data.l);
   lhs->ltype = LT_BOOL;
 }
 
 void le_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT) lhs->data.f = (lhs->data.f <= rhs->data.f);
-  else if (lhs->ltype == LT_DOUBLE) lhs->data.d = (lhs->data.d <= rhs->data.d);
+  if (lhs->ltype == LT_FLOAT) lhs->data.l = (lhs->data.f <= rhs->data.f);
+  else if (lhs->ltype == LT_DOUBLE) lhs->data.l = (lhs->data.d <= rhs->data.d);
   else lhs->data.l = (lhs->data.l <= rhs->data.l);
   lhs->ltype = LT_BOOL;
 }
 
 void eq_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT) lhs->data.f = (lhs->data.f == rhs->data.f);
-  else if (lhs->ltype == LT_DOUBLE) lhs->data.d = (lhs->data.d == rhs->data.d);
+  if (lhs->ltype == LT_FLOAT) lhs->data.l = (lhs->data.f == rhs->data.f);
+  else if (lhs->ltype == LT_DOUBLE) lhs->data.l = (lhs->data.d == rhs->data.d);
   else lhs->data.l = (lhs->data.l == rhs->data.l);
   lhs->ltype = LT_BOOL;
 }
 
 void ne_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT) lhs->data.f = (lhs->data.f != rhs->data.f);
-  else if (lhs->ltype == LT_DOUBLE) lhs->data.d = (lhs->data.d != rhs->data.d);
+  if (lhs->ltype == LT_FLOAT) lhs->data.l = (lhs->data.f != rhs->data.f);
+  else if (lhs->ltype == LT_DOUBLE) lhs->data.l = (lhs->data.d != rhs->data.d);
   else lhs->data.l = (lhs->data.l != rhs->data.l);
   lhs->ltype = LT_BOOL;
 }
 
 void and_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::err("Can't take and of floating point literals", rhs->pos);
+  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::report(ehdl::E_FLOAT_LITERAL_OPERAND, rhs->pos, {"take and of"});
   else lhs->data.l &= rhs->data.l;
 }
 
 void or_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::err("Can't take or of floating point literals", rhs->pos);
+  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::report(ehdl::E_FLOAT_LITERAL_OPERAND, rhs->pos, {"take or of"});
   else if (lhs->ltype == LT_CHAR) lhs->data.c |= rhs->data.c;
   else if (lhs->ltype == LT_SHORT) lhs->data.s |= rhs->data.s;
   else if (lhs->ltype == LT_INT32 || lhs->ltype == LT_UINT32) lhs->data.i |= rhs->data.i;
@@ -581,7 +723,7 @@ void or_literals(Literal* lhs, Literal* rhs) {
 }
 
 void xor_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::err("Can't take xor of floating point literals", rhs->pos);
+  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::report(ehdl::E_FLOAT_LITERAL_OPERAND, rhs->pos, {"take xor of"});
   else if (lhs->ltype == LT_CHAR) lhs->data.c ^= rhs->data.c;
   else if (lhs->ltype == LT_SHORT) lhs->data.s ^= rhs->data.s;
   else if (lhs->ltype == LT_INT32 || lhs->ltype == LT_UINT32) lhs->data.i ^= rhs->data.i;
@@ -589,7 +731,7 @@ void xor_literals(Literal* lhs, Literal* rhs) {
 }
 
 void lshift_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::err("Can't left shift floating point literals", rhs->pos);
+  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::report(ehdl::E_FLOAT_LITERAL_OPERAND, rhs->pos, {"left shift"});
   else if (lhs->ltype == LT_CHAR) lhs->data.c <<= rhs->data.c;
   else if (lhs->ltype == LT_SHORT) lhs->data.s <<= rhs->data.s;
   else if (lhs->ltype == LT_INT32 || lhs->ltype == LT_UINT32) lhs->data.i <<= rhs->data.i;
@@ -597,7 +739,7 @@ void lshift_literals(Literal* lhs, Literal* rhs) {
 }
 
 void rshift_literals(Literal* lhs, Literal* rhs) {
-  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::err("Can't right shift floating point literals", rhs->pos);
+  if (lhs->ltype == LT_FLOAT || lhs->ltype == LT_DOUBLE) ehdl::report(ehdl::E_FLOAT_LITERAL_OPERAND, rhs->pos, {"right shift"});
   else if (lhs->ltype == LT_CHAR) lhs->data.c >>= rhs->data.c;
   else if (lhs->ltype == LT_SHORT) lhs->data.s >>= rhs->data.s;
   else if (lhs->ltype == LT_INT32 || lhs->ltype == LT_UINT32) lhs->data.i >>= rhs->data.i;
@@ -627,7 +769,7 @@ void boolnot_literal(Literal* l) {
 }
 
 void not_literal(Literal* l) {
-  if (l->ltype == LT_FLOAT || l->ltype == LT_DOUBLE) ehdl::err("Can't take not of floating point literals", l->pos);
+  if (l->ltype == LT_FLOAT || l->ltype == LT_DOUBLE) ehdl::report(ehdl::E_FLOAT_LITERAL_OPERAND, l->pos, {"take not of"});
   else if (l->ltype == LT_CHAR) l->data.c = ~l->data.c;
   else if (l->ltype == LT_SHORT) l->data.s = ~l->data.s;
   else if (l->ltype == LT_INT32 || l->ltype == LT_UINT32) l->data.i = ~l->data.i;
@@ -645,27 +787,36 @@ void negate_literal_value(Literal* l) {
 
 // TODO add more operators (bitwise, relational, logical and unary)
 
-
-
-
-Expression* FoldConstants(Expression* expr){
-  BinaryExpression* bin_exp;
-  UnaryExpression* un_exp;
-  if ((bin_exp = dynamic_cast<BinaryExpression*>(expr))) {
-    Expression* result = allocateBinaryExpression(FoldConstants(bin_exp->lhs), bin_exp->op, FoldConstants(bin_exp->rhs));
-    return result;
+// element and member accesses that can be evaluated twice without side effects
+static bool is_simple_lvalue(Expression* expr) {
+  if (isa<Identifier>(expr)) return true;
+  if (SubscriptExpression *sub = dyn_cast<SubscriptExpression>(expr)) {
+    return is_simple_lvalue(sub->base) && (isa<Identifier>(sub->index) || isa<Literal>(sub->index));
   }
-  else if((un_exp = dynamic_cast<UnaryExpression*>(expr))){
-    // cout << "unary expression" << endl;
-    Expression* result = allocateUnaryExpression(un_exp->op, FoldConstants(un_exp->expr));
-    return result;
+  if (MemberExpression *member = dyn_cast<MemberExpression>(expr)) {
+    return is_simple_lvalue(member->base);
   }
-  return expr;
+  return false;
 }
 
 Expression* allocateBinaryExpression(Expression* lhs, Operator op, Expression* rhs) {
   Identifier *ident;
-  if ((ident = dynamic_cast<Identifier*>(lhs))) {
+  // a[i] op= e and s.f op= e read the target through a copy of it
+  if (!isa<Identifier>(lhs) && is_simple_lvalue(lhs)) {
+    switch(op) {
+      case OP_ADD_ASSIGN:   return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_ADD,    rhs));
+      case OP_SUB_ASSIGN:   return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_SUB,    rhs));
+      case OP_MUL_ASSIGN:   return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_MUL,    rhs));
+      case OP_DIV_ASSIGN:   return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_DIV,    rhs));
+      case OP_MOD_ASSIGN:   return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_MOD,    rhs));
+      case OP_AND_ASSIGN:   return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_AND,    rhs));
+      case OP_OR_ASSIGN:    return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_OR,     rhs));
+      case OP_XOR_ASSIGN:   return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_XOR,    rhs));
+      case OP_LEFT_ASSIGN:  return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_LSHIFT, rhs));
+      case OP_RIGHT_ASSIGN: return allocateBinaryExpression(lhs, OP_ASSIGN, allocateBinaryExpression(lhs->copy_exp(), OP_RSHIFT, rhs));
+    }
+  }
+  if ((ident = dyn_cast<Identifier>(lhs))) {
     // assignments can get constant folded because of this
     switch(op) {
       case OP_ADD_ASSIGN:   return allocateBinaryExpression(ident, OP_ASSIGN, allocateBinaryExpression(ident, OP_ADD,    rhs));
@@ -681,8 +832,11 @@ Expression* allocateBinaryExpression(Expression* lhs, Operator op, Expression* r
     }
   }
   Literal *lhslit, *rhslit;
-  if ((lhslit = dynamic_cast<Literal*>(lhs)) && (rhslit = dynamic_cast<Literal*>(rhs))) {
+  if ((lhslit = dyn_cast<Literal>(lhs)) && (rhslit = dyn_cast<Literal>(rhs))) {
     widen_literals(lhslit, rhslit);
+    if ((op == OP_DIV || op == OP_MOD) && division_traps(lhslit, rhslit)) {
+      return new BinaryExpression(lhslit, op, rhslit);
+    }
     switch(op) {
       case OP_ADD: add_literals(lhslit, rhslit); break;
       case OP_SUB: sub_literals(lhslit, rhslit); break;
@@ -712,10 +866,12 @@ Expression* allocateBinaryExpression(Expression* lhs, Operator op, Expression* r
       case OP_OR_ASSIGN:
       case OP_XOR_ASSIGN:
       case OP_LEFT_ASSIGN:
-      case OP_RIGHT_ASSIGN: ehdl::err("Cannot assign a constant to a value", lhs->pos); break;
+      case OP_RIGHT_ASSIGN: ehdl::report(ehdl::E_ASSIGN_TO_CONSTANT, lhs->pos); break;
       default: return new BinaryExpression(lhslit, op, rhslit);
     }
-    delete rhs;
+    // folded into lhslit, nothing else refers to the fresh rhs
+    Node::release(rhslit);
+    normalize_literal(lhslit);
     return lhs;
   }
   return new BinaryExpression(lhs, op, rhs);
@@ -724,136 +880,143 @@ Expression* allocateBinaryExpression(Expression* lhs, Operator op, Expression* r
 
 Expression* allocateUnaryExpression(Operator op, Expression* expr) {
   Literal *lit;
-  if ((lit = dynamic_cast<Literal*>(expr))) {
+  if ((lit = dyn_cast<Literal>(expr))) {
     switch(op) {
       case OP_UNARY_PLUS: return lit;
-      case OP_UNARY_MINUS: negate_literal_value(lit); return lit;
+      case OP_UNARY_MINUS: negate_literal_value(lit); normalize_literal(lit); return lit;
       case OP_BOOL_NOT: boolnot_literal(lit); return lit;
-      case OP_NOT: not_literal(lit); return lit;
+      case OP_NOT: not_literal(lit); normalize_literal(lit); return lit;
       default: return new UnaryExpression(op, expr);
     }
   }
   return new UnaryExpression(op, expr);
 }
 
-ExpressionStatement::ExpressionStatement(Expression *_expr) : expr(_expr) {
+ExpressionStatement::ExpressionStatement(Expression *_expr) : Statement(NK_EXPRESSION_STATEMENT), expr(_expr) {
     cdebug << "ExpressionStatement constructor called" << endl;
 }
 
-ExpressionStatement::~ExpressionStatement() {
-    cdebug << "ExpressionStatement destructor called" << endl;
-    delete expr;
-}
-
 IfStatement::IfStatement(Expression *_cond, Statement *_true_branch,
                          Statement *_false_branch)
-    : cond(_cond), true_branch(_true_branch), false_branch(_false_branch) {
+    : Statement(NK_IF), cond(_cond), true_branch(_true_branch), false_branch(_false_branch) {
     cdebug << "IfStatement constructor called" << endl;
 }
 
-IfStatement::~IfStatement() {
-    cdebug << "IfStatement destructor called" << endl;
-    delete cond;
-    delete true_branch;
-    delete false_branch;
-}
-
-SwitchStatement::~SwitchStatement() {
-    cdebug << "SwitchStatement destructor called" << endl;
-    delete expr;
-    delete stmt;
-}
-
 WhileStatement::WhileStatement(Expression *_cond, Statement *_stmt)
-    : cond(_cond), stmt(_stmt) {
+    : LoopStatement(NK_WHILE), cond(_cond), stmt(_stmt) {
     cdebug << "WhileStatement constructor called" << endl;
 }
 
-WhileStatement::~WhileStatement() {
-    cdebug << "WhileStatement destructor called" << endl;
-    delete cond;
-    delete stmt;
-}
-
 DoWhileStatement::DoWhileStatement(Expression *_cond, Statement *_stmt)
-    : cond(_cond), stmt(_stmt) {
+    : LoopStatement(NK_DO_WHILE), cond(_cond), stmt(_stmt) {
     cdebug << "DoWhileStatement constructor called" << endl;
 }
 
-DoWhileStatement::~DoWhileStatement() {
-    cdebug << "DoWhileStatement destructor called" << endl;
-    delete cond;
-    delete stmt;
+ForStatement::ForStatement(Statement *_init, Expression *_cond, Statement *_step, Statement *_stmt)
+    : LoopStatement(NK_FOR), init(_init), cond(_cond), step(_step), stmt(_stmt) {
+    cdebug << "ForStatement constructor called" << endl;
 }
 
-ReturnStatement::ReturnStatement(Expression *_ret_expr) : ret_expr(_ret_expr) {
-    cdebug << "ReturnStatement constructor called" << endl;
+// text is the whole line, "#pragma unroll 4"
+bool LoopHints::add_pragma(const string& text) {
+    istringstream in(text.substr(text.find("pragma") + 6));
+    string hint, rest;
+    int n = 0;
+    in >> hint;
+    bool has_count = bool(in >> n);
+    if (!has_count) in.clear();
+    if (in >> rest || (has_count && n < 1)) return false;
+
+    if (hint == "unroll") {
+        unroll = HINT_ENABLE;
+        unroll_count = n;
+    }
+    else if (hint == "vectorize") {
+        vectorize = HINT_ENABLE;
+        vectorize_width = n;
+    }
+    else if (hint == "nounroll" && !has_count) unroll = HINT_DISABLE;
+    else if (hint == "novectorize" && !has_count) vectorize = HINT_DISABLE;
+    else return false;
+    return true;
 }
 
-ReturnStatement::~ReturnStatement() {
-    cdebug << "ReturnStatement destructor called" << endl;
-    delete ret_expr;
+ReturnStatement::ReturnStatement(Expression *_ret_expr) : Statement(NK_RETURN), ret_expr(_ret_expr) {
+    cdebug << "ReturnStatement constructor called" << endl;
 }
 
-GotoStatement::GotoStatement(char *_label) : label(_label) {
+GotoStatement::GotoStatement(istring _label) : Statement(NK_GOTO), label(_label) {
     cdebug << "GotoStatement constructor called" << endl;
 }
 
 DeclarationSpecifiers::DeclarationSpecifiers()
-    : storage_specs(), type_specs{}, type_quals(), func_specs() {
+    : Node(NK_DECLARATION_SPECIFIERS), storage_specs(), type_specs{}, type_quals(), func_specs() {
     cdebug << "DeclarationSpecifiers constructor called" << endl;
 }
 
 void DeclarationSpecifiers::add_type_specifier(TypeSpecifier ts) {
+    if (record_spec) {
+        ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {ts2str(ts), "a struct or union"});
+        return;
+    }
     // FLOAT cannot be combined with unsigned/signed
     if (ts == TS_FLOAT || ts == TS_DOUBLE) {
         if (!type_specs.empty()) {
-          ehdl::err("Cannot combine " + ts2str(ts) + " with previous decls", pos);
+          ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {ts2str(ts), "previous decls"});
             return;
         }
     }
     else if (type_specs.find(TS_FLOAT) != type_specs.end() || type_specs.find(TS_DOUBLE) != type_specs.end()) {
-        ehdl::err("cannot combine a type specifier with floating point types", pos);
+        ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"a type specifier", "floating point types"});
         return;
     }
 
     if (ts == TS_CHAR) {
         if (type_specs.size() == 1 && !(*type_specs.begin() == TS_SIGNED || *type_specs.begin() == TS_UNSIGNED)) {
-            ehdl::err("cannot combine char with previous decls", pos);
+            ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"char", "previous decls"});
             return;
         }
         else if (type_specs.size() > 1) {
-            ehdl::err("cannot combine char with previous decls", pos);
+            ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"char", "previous decls"});
             return;
         }
     }
     else if (ts == TS_SIGNED || ts == TS_UNSIGNED) {
         if ((ts == TS_SIGNED && type_specs.find(TS_UNSIGNED) != type_specs.end()) ||
             (ts == TS_UNSIGNED && type_specs.find(TS_SIGNED) != type_specs.end())) {
-            ehdl::err("cannot combine signed with unsigned", pos);
+            ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"signed", "unsigned"});
             return;
         }
     }
     else if (ts == TS_SHORT) {
         if (type_specs.find(TS_CHAR) != type_specs.end() || type_specs.find(TS_LONG) != type_specs.end()) {
-            ehdl::err("cannot combine short with char, long or llong", pos);
+            ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"short", "char, long or llong"});
             return;
         }
     }
     else if (ts == TS_LONG) {
         if (type_specs.find(TS_CHAR) != type_specs.end() || type_specs.find(TS_SHORT) != type_specs.end()) {
-            ehdl::err("cannot combine long with char or short", pos);
+            ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"long", "char or short"});
             return;
         }
     }
     else if (ts == TS_INT) {
         if (type_specs.find(TS_CHAR) != type_specs.end()) {
-            ehdl::err("cannot combine int with char", pos);
+            ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"int", "char"});
         }
     }
     type_specs.insert(ts);
 }
 
+void DeclarationSpecifiers::add_record_specifier(RecordSpecifier* rs) {
+    if (!type_specs.empty()) {
+        ehdl::report(ehdl::E_TYPE_COMBINATION, pos, {"a struct or union", "previous decls"});
+        return;
+    }
+    type_specs.insert(rs->keyword);
+    record_spec = rs;
+}
+
 void DeclarationSpecifiers::add_storage_specifier(StorageSpecifier ss) {
     storage_specs.insert(ss);
 }
@@ -866,106 +1029,77 @@ void DeclarationSpecifiers::add_func_specifier(FunctionSpecifier fs) {
     func_specs.insert(fs);
 }
 
+RecordSpecifier::RecordSpecifier(TypeSpecifier _keyword, istring _tag, std::vector<Declaration*>* _fields)
+    : Node(NK_RECORD_SPECIFIER), keyword{_keyword}, tag{_tag}, fields{_fields} {
+    cdebug << "RecordSpecifier constructor called" << endl;
+}
+
+RecordSpecifier::~RecordSpecifier() {
+    delete fields;
+}
+
 PureDeclaration::PureDeclaration(DeclarationSpecifiers *_decl_specs,
                                  int _ptr_depth, Identifier *_ident)
-    : decl_specs{_decl_specs}, ptr_depth{_ptr_depth}, ident{_ident} {
+    : Node(NK_PURE_DECLARATION), decl_specs{_decl_specs}, ptr_depth{_ptr_depth}, ident{_ident} {
     cdebug << "PureDeclaration constructor called" << endl;
 }
 
 FunctionParameterList::FunctionParameterList(std::vector<PureDeclaration*>* _params, bool _has_varargs)
-    : params{_params}, has_varargs{_has_varargs} {
+    : Node(NK_PARAMETER_LIST), params{_params}, has_varargs{_has_varargs} {
     cdebug << "FunctionParameterList constructor called" << endl;
 }
 
 InitDeclarator::InitDeclarator(int _ptr_depth, Identifier *_ident,
-                               Expression *_init_expr)
-    : ptr_depth{_ptr_depth}, ident{_ident}, init_expr{_init_expr} {
+                               Expression *_init_expr, Expression *_array_size)
+    : Node(NK_INIT_DECLARATOR), ptr_depth{_ptr_depth}, ident{_ident}, init_expr{_init_expr}, array_size{_array_size} {
     cdebug << "InitDeclarator constructor called" << endl;
 }
 
 Declaration::Declaration(DeclarationSpecifiers *_decl_specs,
                          vector<InitDeclarator *> *_decl_list)
-    : decl_specs(_decl_specs), decl_list(_decl_list) {
+    : Node(NK_DECLARATION), decl_specs(_decl_specs), decl_list(_decl_list) {
     cdebug << "Declaration constructor called" << endl;
 }
 
 Declaration::~Declaration() {
     cdebug << "Declaration destructor called" << endl;
-    // TODO delete stuff
+    delete decl_list;
 }
 
-DeclarationStatement::DeclarationStatement(Declaration *_decl) : decl(_decl) {
+DeclarationStatement::DeclarationStatement(Declaration *_decl) : Statement(NK_DECLARATION_STATEMENT), decl(_decl) {
     cdebug << "DeclarationStatement constructor called" << endl;
 }
 
-DeclarationStatement::~DeclarationStatement() {
-    cdebug << "DeclarationStatement destructor called" << endl;
-    delete decl;
-}
-
-BlockStatement::~BlockStatement() {
-    cdebug << "BlockStatement destructor called" << endl;
-    for (auto stmt : *this) {
-        delete stmt;
-    }
-}
-
 LabeledStatement::LabeledStatement(Identifier *_label, Statement *_stmt)
-    : label{_label}, stmt{_stmt} {
+    : Statement(NK_LABELED), label{_label}, stmt{_stmt} {
     cdebug << "LabeledStatement constructor called" << endl;
 }
 
-LabeledStatement::~LabeledStatement() {
-    cdebug << "LabeledStatement destructor called" << endl;
-    delete label;
-    delete stmt;
-}
-
 CaseStatement::CaseStatement(Expression *_const_expr, Statement *_stmt)
-    : const_expr{_const_expr}, stmt{_stmt} {
+    : Statement(NK_CASE), const_expr{_const_expr}, stmt{_stmt} {
     cdebug << "CaseStatement constructor called" << endl;
 }
 
-CaseStatement::~CaseStatement() {
-    cdebug << "CaseStatement destructor called" << endl;
-    delete const_expr;
-    delete stmt;
-}
-
-PureDeclaration::~PureDeclaration() {
-    cdebug << "PureDeclaration destructor called" << endl;
-    delete decl_specs;
-    delete ident;
-}
-
 SwitchStatement::SwitchStatement(Expression* _expr, Statement* _stmt)
-    : expr{_expr}, stmt{_stmt} {
+    : Statement(NK_SWITCH), expr{_expr}, stmt{_stmt} {
     cdebug << "SwitchStatement constructor called" << endl;
 }
 
 FunctionParameterList::~FunctionParameterList() {
     cdebug << "FunctionParameterList destructor called" << endl;
-    for (auto pd : *params) {
-        delete pd;
-    }
+    delete params;
 }
 
 Function::Function(PureDeclaration *_func_decl, FunctionParameterList *_params,
                    BlockStatement *_stmts)
-    : func_decl{_func_decl}, params{_params}, stmts{_stmts} {
+    : Node(NK_FUNCTION), func_decl{_func_decl}, params{_params}, stmts{_stmts} {
     cdebug << "Function constructor called" << endl;
 }
 
-Function::~Function() {
-    cdebug << "Function destructor called" << endl;
-    delete func_decl;
-    delete params;
-    delete stmts;
-}
-
 TranslationUnit::TranslationUnit()
-    : nodes(new vector<Node *>) {
+    : Node(NK_TRANSLATION_UNIT), nodes(new vector<Node *>), arena() {
     cdebug << "TranslationUnit constructor called" << endl;
+    Arena::set_active(&arena);
 }
 
 void TranslationUnit::add_function(Function *func) {
@@ -978,9 +1112,7 @@ void TranslationUnit::add_declaration(DeclarationStatement *decl) {
 
 TranslationUnit::~TranslationUnit() {
     cdebug << "TranslationUnit destructor called" << endl;
-    for (auto *node : *nodes) {
-        delete node;
-    }
+    // the nodes themselves go away with the arena
     delete nodes;
 }
 
@@ -993,7 +1125,7 @@ Expression* Expression::copy_exp(){
 }
 
 Expression* Identifier::copy_exp(){
-  Identifier* newexp = new Identifier("");
+  Identifier* newexp = new Identifier(name);
   if (true) {
     newexp->ident_info = ident_info;
     newexp->name = name;
@@ -1038,6 +1170,24 @@ Expression* BinaryExpression::copy_exp(){
 }
 
 
+Expression* SubscriptExpression::copy_exp(){
+  SubscriptExpression* newexp = new SubscriptExpression(base->copy_exp(), index->copy_exp());
+  newexp->type_info = type_info;
+  return newexp;
+}
+
+Expression* MemberExpression::copy_exp(){
+  MemberExpression* newexp = new MemberExpression(base->copy_exp(), field, arrow);
+  newexp->type_info = type_info;
+  return newexp;
+}
+
+Expression* TypeName::copy_exp(){
+  TypeName* newexp = new TypeName(decl_specs, ptr_depth);
+  newexp->type_info = type_info;
+  return newexp;
+}
+
 Expression* FunctionInvocationExpression::copy_exp(){
   FunctionInvocationExpression* newexp = new FunctionInvocationExpression(this);
 
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "symtab.hpp"
+#include "arena.hpp"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/Casting.h"
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -12,7 +15,17 @@
 using namespace std;
 // using namespace llvm;
 
+class CFG;
+class ConstEnv;
+struct LatticeValue;
+
 namespace ast {
+// nodes implement classof, so LLVM's casting templates work on them
+using llvm::isa;
+using llvm::cast;
+using llvm::dyn_cast;
+using llvm::dyn_cast_or_null;
+
 enum Operator {
   // arithmetic
   OP_ADD,
@@ -131,25 +144,87 @@ string ts2str(TypeSpecifier ts);
 string tq2str(TypeQualifier tq);
 string fs2str(FunctionSpecifier fs);
 
+// Byte range [begin, end) of a node in its source file. The line and column
+// are only worked out for diagnostics, see SourceFile::line_col.
 struct sympos
 {
-  int first_line;
-  int first_column;
-  int last_line;
-  int last_column;
+  uint32_t begin;
+  uint32_t end;
+};
+
+// Concrete node types, tested with isa/cast/dyn_cast instead of RTTI. The
+// kinds of each abstract base are contiguous so its classof is a range check;
+// keep them in sync with ASTVisitor (visitor.hpp) when adding a node.
+enum NodeKind {
+  // expressions
+  NK_IDENTIFIER,
+  NK_TERNARY,
+  NK_CALL,
+  NK_BINARY,
+  NK_UNARY,
+  NK_SUBSCRIPT,
+  NK_MEMBER,
+  NK_TYPE_NAME,
+  NK_LITERAL,
+  // statements
+  NK_DECLARATION_STATEMENT,
+  NK_EXPRESSION_STATEMENT,
+  NK_IF,
+  NK_SWITCH,
+  NK_WHILE,
+  NK_DO_WHILE,
+  NK_FOR,
+  NK_RETURN,
+  NK_GOTO,
+  NK_CONTINUE,
+  NK_BREAK,
+  NK_BLOCK,
+  NK_LABELED,
+  NK_CASE,
+  // declarations
+  NK_RECORD_SPECIFIER,
+  NK_DECLARATION_SPECIFIERS,
+  NK_PURE_DECLARATION,
+  NK_PARAMETER_LIST,
+  NK_INIT_DECLARATOR,
+  NK_DECLARATION,
+  NK_FUNCTION,
+  NK_TRANSLATION_UNIT
 };
 
 struct Node {
+  const NodeKind kind;
   sympos pos;
+
+  Node(NodeKind _kind);
   virtual string dump_ast(string prefix) = 0;
   virtual void scopify() = 0;
+  virtual ~Node() {}
+
+  // nodes are placed in the active Arena and released together with it
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr) {}
+  // hands an unreachable node back to the arena to be reused by a later node
+  // of the same type; node must not be referenced anywhere anymore
+  static void release(Node* node);
 };
 
+// name of the node type of a kind, e.g. BinaryExpression for NK_BINARY
+const char* node_kind_name(NodeKind kind);
+
+struct LoopInfo;
+
 struct Statement : Node {
+  Statement(NodeKind _kind) : Node(_kind) {}
+  static bool classof(const Node* node) { return node->kind >= NK_DECLARATION_STATEMENT && node->kind <= NK_CASE; }
+
   virtual llvm::Value* codegen();
-  virtual Statement* const_prop();              // moved decl of statement
-  virtual void remove_pointers();
-  virtual ~Statement() {}
+  virtual void lower(CFG& cfg);                 // appends the statement to the CFG
+  virtual void const_prop(ConstEnv& env);       // transfer function of the statement
+  virtual void prune(const CFG& cfg);           // drops statements control never reaches
+  virtual void find_writes(std::set<int>& written);     // locals assigned or declared
+  virtual Statement* hoist_invariants();        // returns the statement replacing this one
+  virtual void hoist(LoopInfo& loop);           // moves invariant expressions into loop
 };
 
 
@@ -163,36 +238,42 @@ struct ExprTypeInfo{
 };
 
 struct Expression : Node {
-  virtual ~Expression() {}
   ExprTypeInfo type_info;
   Expression* const_value = nullptr;
+
+  Expression(NodeKind _kind) : Node(_kind) {}
+  static bool classof(const Node* node) { return node->kind >= NK_IDENTIFIER && node->kind <= NK_LITERAL; }
+
   virtual llvm::Value* codegen();                      // codegen when rvalue
   // virtual llvm::Value* assign(Expression* R);         // codegen when lvalue
   virtual Expression* flatten_tree(Statement*);
-  virtual Expression* const_prop();
+  // evaluates the expression over env into val, returns its replacement
+  virtual Expression* const_prop(ConstEnv& env, LatticeValue& val);
   virtual llvm::Value* get_address();                                // use this to replace assign  
-  virtual void remove_pointers();        
+  virtual void branchgen(llvm::BasicBlock* if_true, llvm::BasicBlock* if_false);   // codegen as a condition
   virtual Expression* copy_exp();     
+  virtual void find_writes(std::set<int>& written);
 
 };
 
 struct Identifier : Expression {
-  string name;
+  istring name;
   SymbolInfo ident_info;
 
-  Identifier(string _name);
+  Identifier(istring _name);
+  static bool classof(const Node* node) { return node->kind == NK_IDENTIFIER; }
   Expression* copy_exp() override;
   string dump_ast(string prefix) override;
   llvm::Value* codegen() override;
   Expression* flatten_tree(Statement*) override;
-  Expression* const_prop() override;
+  Expression* const_prop(ConstEnv& env, LatticeValue& val) override;
   llvm::Value* get_address() override;
-  // void remove_pointers() override;
   void scopify() override;
 };
 
 
-Expression* FoldConstants(Expression* expr);
+// locals whose address is taken with & anywhere below node
+void find_address_taken(Node* node, std::set<int>& taken);
 
 struct TernaryExpression : Expression {
   Expression *cond;
@@ -201,27 +282,30 @@ struct TernaryExpression : Expression {
 
   TernaryExpression(Expression *_cond, Expression *_true_branch,
                     Expression *_false_branch);
+  static bool classof(const Node* node) { return node->kind == NK_TERNARY; }
 
   string dump_ast(string prefix);
   void scopify();
-  ~TernaryExpression();
+  Expression* const_prop(ConstEnv& env, LatticeValue& val);
+  void find_writes(std::set<int>& written);
 };
 
 struct FunctionInvocationExpression : Expression {
 
   Expression *fn;
-  vector<Expression *> *params;
+  vector<Expression *> *params = nullptr;
 
   FunctionInvocationExpression(Expression *_fn);
   FunctionInvocationExpression(Expression *_fn, vector<Expression *> *_params);
+  static bool classof(const Node* node) { return node->kind == NK_CALL; }
 
   string dump_ast(string prefix) override;
   llvm::Value* codegen() override;
-  Expression* const_prop() override;
+  Expression* const_prop(ConstEnv& env, LatticeValue& val) override;
   Expression* flatten_tree(Statement*) override;
   Expression* copy_exp() override;
   void scopify() override;
-  void remove_pointers() override;
+  void find_writes(std::set<int>& written) override;
   ~FunctionInvocationExpression();
 };
 
@@ -231,14 +315,16 @@ struct BinaryExpression : Expression {
   Expression *rhs;
 
   BinaryExpression(Expression *_lhs, Operator _op, Expression *_rhs);
+  static bool classof(const Node* node) { return node->kind == NK_BINARY; }
   string dump_ast(string prefix) override;
   void scopify() override;
-  Expression* const_prop() override;
+  Expression* const_prop(ConstEnv& env, LatticeValue& val) override;
   Expression* flatten_tree(Statement*) override;
   llvm::Value* codegen() override;
+  llvm::Value* logicalgen();
+  void branchgen(llvm::BasicBlock* if_true, llvm::BasicBlock* if_false) override;
   Expression* copy_exp() override;
-  void remove_pointers() override;
-  ~BinaryExpression();
+  void find_writes(std::set<int>& written) override;
 };
 
 struct UnaryExpression : Expression {
@@ -246,18 +332,70 @@ struct UnaryExpression : Expression {
   Expression *expr;
 
   UnaryExpression(Operator _op, Expression *_expr);
+  static bool classof(const Node* node) { return node->kind == NK_UNARY; }
   llvm::Value* codegen() override;
   llvm::Value* get_address() override;
-  Expression* const_prop() override;
+  void branchgen(llvm::BasicBlock* if_true, llvm::BasicBlock* if_false) override;
+  Expression* const_prop(ConstEnv& env, LatticeValue& val) override;
   Expression* flatten_tree(Statement*) override;
   string dump_ast(string prefix) override;                      // Add assign method
   Expression* copy_exp() override;
-  void remove_pointers() override;
+  void find_writes(std::set<int>& written) override;
+  void scopify() override;
+};
+
+// base[index]; base is an array, which decays to a pointer, or a pointer
+struct SubscriptExpression : Expression {
+  Expression *base;
+  Expression *index;
+
+  SubscriptExpression(Expression *_base, Expression *_index);
+  static bool classof(const Node* node) { return node->kind == NK_SUBSCRIPT; }
+  llvm::Value* codegen() override;
+  llvm::Value* get_address() override;
+  Expression* const_prop(ConstEnv& env, LatticeValue& val) override;
+  Expression* flatten_tree(Statement*) override;
+  string dump_ast(string prefix) override;
+  Expression* copy_exp() override;
+  void find_writes(std::set<int>& written) override;
+  void scopify() override;
+};
+
+// base.field, or base->field when arrow is set
+struct MemberExpression : Expression {
+  Expression *base;
+  istring field;
+  bool arrow;
+
+  MemberExpression(Expression *_base, istring _field, bool _arrow);
+  static bool classof(const Node* node) { return node->kind == NK_MEMBER; }
+  llvm::Value* codegen() override;
+  llvm::Value* get_address() override;
+  Expression* const_prop(ConstEnv& env, LatticeValue& val) override;
+  Expression* flatten_tree(Statement*) override;
+  string dump_ast(string prefix) override;
+  Expression* copy_exp() override;
+  void find_writes(std::set<int>& written) override;
+  void scopify() override;
+};
+
+struct DeclarationSpecifiers;
+
+// the type operand of sizeof and _Alignof; scopify puts the type in type_info
+struct TypeName : Expression {
+  DeclarationSpecifiers* decl_specs;
+  int ptr_depth;
+
+  TypeName(DeclarationSpecifiers* _decl_specs, int _ptr_depth);
+  static bool classof(const Node* node) { return node->kind == NK_TYPE_NAME; }
+  Expression* flatten_tree(Statement*) override;
+  string dump_ast(string prefix) override;
+  Expression* copy_exp() override;
   void scopify() override;
 };
 
 struct Literal : Expression {
-  string value;
+  istring value = nullptr;      // string literals only, with escapes resolved
   LiteralType ltype;
   union {
     long l;
@@ -267,13 +405,16 @@ struct Literal : Expression {
     double d;
     float f;
   } data;
+  bool interned = false;        // shared, owned by a LiteralPool
 
-  Literal(string _value, LiteralType _ltype);
+  // parse diagnostics point at _pos, so the parser passes it in
+  Literal(string _value, LiteralType _ltype, sympos _pos = {});
   Literal(long data, LiteralType _ltype);
   Literal(float data, LiteralType _ltype);
   Literal(double data, LiteralType _ltype);
+  static bool classof(const Node* node) { return node->kind == NK_LITERAL; }
   void scopify() override;
-  Expression* const_prop() override;
+  Expression* const_prop(ConstEnv& env, LatticeValue& val) override;
   Expression* flatten_tree(Statement*) override;
   llvm::Constant* codegen() override;
   Expression* copy_exp() override;
@@ -281,6 +422,7 @@ struct Literal : Expression {
 };
 
 void assign_literals(SymbolType lhstype, Literal* rhslit);
+bool lit2bool(Literal* l);
 Expression* allocateBinaryExpression(Expression* lhs, Operator op, Expression* rhs);
 Expression* allocateUnaryExpression(Operator op, Expression* expr);
 
@@ -288,15 +430,34 @@ Expression* allocateUnaryExpression(Operator op, Expression* expr);
 // Declarations
 ////////////////////////////////////////////////////////////////////////////////
 
+struct Declaration;
+
+// struct or union: a definition when fields is set, else a reference by tag
+struct RecordSpecifier : Node {
+  TypeSpecifier keyword;                    // TS_STRUCT or TS_UNION
+  istring tag;                              // nullptr for anonymous records
+  std::vector<Declaration*>* fields;
+  int record = -1;                          // in the RecordTable, set by scopify
+
+  RecordSpecifier(TypeSpecifier _keyword, istring _tag, std::vector<Declaration*>* _fields);
+  static bool classof(const Node* node) { return node->kind == NK_RECORD_SPECIFIER; }
+  string dump_ast(string prefix);
+  void scopify();
+  ~RecordSpecifier();
+};
+
 struct DeclarationSpecifiers : Node {
   std::set<StorageSpecifier> storage_specs;
   std::set<TypeSpecifier> type_specs;
   std::set<TypeQualifier> type_quals;
   std::set<FunctionSpecifier> func_specs;
+  RecordSpecifier* record_spec = nullptr;
 
   DeclarationSpecifiers();
+  static bool classof(const Node* node) { return node->kind == NK_DECLARATION_SPECIFIERS; }
 
   void add_type_specifier(TypeSpecifier ts);
+  void add_record_specifier(RecordSpecifier* rs);
   void add_storage_specifier(StorageSpecifier ss);
   void add_type_qualifier(TypeQualifier tq);
   void add_func_specifier(FunctionSpecifier fs);
@@ -311,10 +472,10 @@ struct PureDeclaration : Node {
   Identifier *ident;
 
   PureDeclaration(DeclarationSpecifiers* _decl_specs, int _ptr_depth, Identifier *_ident);
+  static bool classof(const Node* node) { return node->kind == NK_PURE_DECLARATION; }
 
   string dump_ast(string prefix);
   void scopify();
-  ~PureDeclaration();
 };
 
 struct FunctionParameterList : Node {
@@ -323,6 +484,7 @@ struct FunctionParameterList : Node {
   bool has_varargs;
 
   FunctionParameterList(std::vector<PureDeclaration*>* _params, bool _has_varargs);
+  static bool classof(const Node* node) { return node->kind == NK_PARAMETER_LIST; }
   string dump_ast(string prefix);
   void scopify();
   ~FunctionParameterList();
@@ -332,13 +494,14 @@ struct InitDeclarator : Node {
   int ptr_depth;
   Identifier *ident;
   Expression *init_expr;
+  Expression *array_size;         // between the brackets of an array declarator, else null
 
-  InitDeclarator(int _ptr_depth, Identifier *_ident, Expression *_init_expr);
+  InitDeclarator(int _ptr_depth, Identifier *_ident, Expression *_init_expr, Expression *_array_size = nullptr);
+  static bool classof(const Node* node) { return node->kind == NK_INIT_DECLARATOR; }
 
   string dump_ast(string prefix);
   void scopify();
   // Value* codegen();
-  ~InitDeclarator();
 };
 
 struct Declaration : Node {
@@ -346,10 +509,12 @@ struct Declaration : Node {
   std::vector<InitDeclarator*>* decl_list;
 
   Declaration(DeclarationSpecifiers* _decl_specs , vector<InitDeclarator*> *_decl_list);
+  static bool classof(const Node* node) { return node->kind == NK_DECLARATION; }
   string dump_ast(string prefix);
   void scopify();
   llvm::Value* codegen();
   llvm::Value* globalgen();
+  void globaldecl();              // external declarations only, for codegen shards
   ~Declaration();
 };
 
@@ -367,25 +532,30 @@ struct DeclarationStatement : Statement {
   Declaration *decl;
 
   DeclarationStatement(Declaration *_decl);
+  static bool classof(const Node* node) { return node->kind == NK_DECLARATION_STATEMENT; }
   string dump_ast(string prefix) override;
   void scopify() override;
   llvm::Value* codegen() override;
-  Statement* const_prop() override;
+  void lower(CFG& cfg) override;
+  void const_prop(ConstEnv& env) override;
   llvm::Value* globalgen();
-  void remove_pointers() override;
-  ~DeclarationStatement();
+  void globaldecl();
+  void find_writes(std::set<int>& written) override;
+  void hoist(LoopInfo& loop) override;
 };
 
 struct ExpressionStatement : Statement {
   Expression *expr;
 
   ExpressionStatement(Expression *_expr);
+  static bool classof(const Node* node) { return node->kind == NK_EXPRESSION_STATEMENT; }
   string dump_ast(string prefix) override;
   void scopify() override;
-  Statement* const_prop() override;
+  void lower(CFG& cfg) override;
+  void const_prop(ConstEnv& env) override;
   llvm::Value* codegen() override;
-  void remove_pointers() override;
-  ~ExpressionStatement();
+  void find_writes(std::set<int>& written) override;
+  void hoist(LoopInfo& loop) override;
 };
 
 struct IfStatement : Statement {
@@ -396,50 +566,112 @@ struct IfStatement : Statement {
 
   IfStatement(Expression *_cond, Statement *_true_branch,
               Statement *_false_branch);
+  static bool classof(const Node* node) { return node->kind == NK_IF; }
   string dump_ast(string prefix) override;
   void scopify() override;
-  Statement* const_prop() override;
+  void lower(CFG& cfg) override;
+  void prune(const CFG& cfg) override;
   llvm::Value* codegen() override;
-  void remove_pointers() override;
-  ~IfStatement();
+  void find_writes(std::set<int>& written) override;
+  Statement* hoist_invariants() override;
+  void hoist(LoopInfo& loop) override;
 };
 
+struct CaseStatement;
+
 struct SwitchStatement : Statement {
 
   Expression *expr;
   Statement *stmt;
+  vector<CaseStatement*> cases;     // labels of this switch in source order, filled by scopify
 
   SwitchStatement(Expression* _expr, Statement* _stmt);
+  static bool classof(const Node* node) { return node->kind == NK_SWITCH; }
   string dump_ast(string prefix);
   void scopify();
-  // llvm::Value* codegen();
-  ~SwitchStatement();
+  void lower(CFG& cfg);
+  void prune(const CFG& cfg);
+  void find_writes(std::set<int>& written);
+  Statement* hoist_invariants();
+  void hoist(LoopInfo& loop);
+  llvm::Value* codegen();
+};
+
+enum LoopHint {
+  HINT_DEFAULT,
+  HINT_ENABLE,
+  HINT_DISABLE
+};
+
+// #pragma unroll [N], nounroll, vectorize [N] and novectorize in front of a
+// loop, passed on to the LLVM loop passes as llvm.loop metadata
+struct LoopHints {
+  LoopHint unroll = HINT_DEFAULT;
+  int unroll_count = 0;             // 0 leaves the count to the unroller
+  LoopHint vectorize = HINT_DEFAULT;
+  int vectorize_width = 0;          // 0 leaves the width to the vectorizer
+
+  bool add_pragma(const string& text);      // false if the pragma is malformed
+};
+
+struct LoopStatement : Statement {
+  LoopHints hints;
+
+  LoopStatement(NodeKind _kind) : Statement(_kind) {}
+  static bool classof(const Node* node) { return node->kind >= NK_WHILE && node->kind <= NK_FOR; }
 };
 
-struct WhileStatement : Statement {
+struct WhileStatement : LoopStatement {
 
   Expression *cond;
   Statement *stmt;
 
   WhileStatement(Expression *_cond, Statement *_stmt);
+  static bool classof(const Node* node) { return node->kind == NK_WHILE; }
   string dump_ast(string prefix) override;
   void scopify() override;
-  Statement* const_prop() override;
+  void lower(CFG& cfg) override;
+  void prune(const CFG& cfg) override;
   llvm::Value* codegen() override;
-  void remove_pointers() override;
-  ~WhileStatement();
+  void find_writes(std::set<int>& written) override;
+  Statement* hoist_invariants() override;
+  void hoist(LoopInfo& loop) override;
 };
 
-struct DoWhileStatement : Statement {
+struct DoWhileStatement : LoopStatement {
 
   Expression *cond;
   Statement *stmt;
 
   DoWhileStatement(Expression *_cond, Statement *_stmt);
+  static bool classof(const Node* node) { return node->kind == NK_DO_WHILE; }
   string dump_ast(string prefix);
   void scopify();
-  // llvm::Value* codegen();
-  ~DoWhileStatement();
+  void lower(CFG& cfg);
+  void prune(const CFG& cfg);
+  void find_writes(std::set<int>& written);
+  Statement* hoist_invariants();
+  void hoist(LoopInfo& loop);
+  llvm::Value* codegen();
+};
+
+struct ForStatement : LoopStatement {
+
+  Statement *init;                  // declaration or expression statement
+  Expression *cond;                 // nullptr if omitted
+  Statement *step;                  // expression statement, nullptr if omitted
+  Statement *stmt;
+
+  ForStatement(Statement *_init, Expression *_cond, Statement *_step, Statement *_stmt);
+  static bool classof(const Node* node) { return node->kind == NK_FOR; }
+  string dump_ast(string prefix) override;
+  void scopify() override;
+  void lower(CFG& cfg) override;
+  void prune(const CFG& cfg) override;
+  llvm::Value* codegen() override;
+  void find_writes(std::set<int>& written) override;
+  Statement* hoist_invariants() override;
+  void hoist(LoopInfo& loop) override;
 };
 
 struct ReturnStatement : Statement {
@@ -447,43 +679,57 @@ struct ReturnStatement : Statement {
   Expression *ret_expr;
 
   ReturnStatement(Expression *_ret_expr);
+  static bool classof(const Node* node) { return node->kind == NK_RETURN; }
   string dump_ast(string prefix) override;
   void scopify() override;
-  Statement* const_prop() override;
+  void lower(CFG& cfg) override;
+  void const_prop(ConstEnv& env) override;
   llvm::Value* codegen() override;
-  void remove_pointers() override;
-  ~ReturnStatement();
+  void find_writes(std::set<int>& written) override;
+  void hoist(LoopInfo& loop) override;
 };
 
 struct GotoStatement : Statement {
-  string label;
-  GotoStatement(char* _label);
+  istring label;
+  GotoStatement(istring _label);
+  static bool classof(const Node* node) { return node->kind == NK_GOTO; }
   string dump_ast(string prefix);
   // llvm::Value* codegen();
   void scopify();
 };
 
 struct ContinueStatement : Statement {
+  ContinueStatement() : Statement(NK_CONTINUE) {}
+  static bool classof(const Node* node) { return node->kind == NK_CONTINUE; }
+
   string dump_ast(string prefix);
   void scopify();
-  // llvm::Value* codegen();
+  void lower(CFG& cfg);
+  llvm::Value* codegen();
 };
 
 struct BreakStatement : Statement {
 
+  BreakStatement() : Statement(NK_BREAK) {}
+  static bool classof(const Node* node) { return node->kind == NK_BREAK; }
   string dump_ast(string prefix);
   void scopify();
-  // llvm::Value* codegen();
+  void lower(CFG& cfg);
+  llvm::Value* codegen();
 };
 
 struct BlockStatement : Statement, vector<Statement *> {
 
+  BlockStatement() : Statement(NK_BLOCK) {}
+  static bool classof(const Node* node) { return node->kind == NK_BLOCK; }
   string dump_ast(string prefix) override;
   void scopify() override;
-  Statement* const_prop() override;
+  void lower(CFG& cfg) override;
+  void prune(const CFG& cfg) override;
   llvm::Value* codegen() override;
-  void remove_pointers() override;
-  ~BlockStatement();
+  void find_writes(std::set<int>& written) override;
+  Statement* hoist_invariants() override;
+  void hoist(LoopInfo& loop) override;
 };
 
 struct LabeledStatement : Statement {
@@ -492,22 +738,28 @@ struct LabeledStatement : Statement {
   Statement* stmt;
 
   LabeledStatement(Identifier* _label, Statement* _stmt);
+  static bool classof(const Node* node) { return node->kind == NK_LABELED; }
   string dump_ast(string prefix);
   // llvm::Value* codegen();
   void scopify();
-  ~LabeledStatement();
 };
 
 struct CaseStatement : Statement {
 
-  Expression* const_expr;
-  Statement* stmt;
+  Expression* const_expr;           // nullptr for default
+  Statement* stmt;                  // nullptr once const_prop found it unreachable
+  llvm::BasicBlock* block = nullptr;    // created by the enclosing switch during codegen
 
   CaseStatement(Expression* _const_expr, Statement* _stmt);
+  static bool classof(const Node* node) { return node->kind == NK_CASE; }
   string dump_ast(string prefix);
-  // llvm::Value* codegen();
+  llvm::Value* codegen();
   void scopify();
-  ~CaseStatement();
+  void lower(CFG& cfg);
+  void prune(const CFG& cfg);
+  void find_writes(std::set<int>& written);
+  Statement* hoist_invariants();
+  void hoist(LoopInfo& loop);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -521,11 +773,28 @@ struct Function : Node {
   BlockStatement* stmts;
 
   Function(PureDeclaration* _func_decl, FunctionParameterList* _params, BlockStatement* _stmts);
+  static bool classof(const Node* node) { return node->kind == NK_FUNCTION; }
   string dump_ast(string prefix);
   void scopify();
   void const_prop();
+  void hoist_invariants();
+  llvm::Function* prototype();
   llvm::Function* codegen(); 
-  ~Function();
+};
+
+enum EmitKind {
+  EMIT_LL, EMIT_BC, EMIT_ASM, EMIT_OBJ
+};
+
+struct CodegenOptions {
+  bool ssa = false;           // keep locals whose address is never taken in SSA values
+  int opt_level = 0;          // PassBuilder default pipeline, 0-3
+  string passes;              // custom pipeline text, overrides opt_level
+  EmitKind emit = EMIT_LL;
+  string march;               // target architecture, host if empty
+  string mcpu;                // target cpu, "native" for the host cpu and features
+  string jit_cache_dir;       // --run: reuse compiled objects from here, if set
+  int codegen_threads = 1;    // > 1: generate function bodies in parallel shards
 };
 
 struct TranslationUnit : Node {
@@ -533,14 +802,26 @@ struct TranslationUnit : Node {
   vector<Node*> *nodes;
 
   TranslationUnit();
+  static bool classof(const Node* node) { return node->kind == NK_TRANSLATION_UNIT; }
 
   void add_function(Function *func);
   void add_declaration(DeclarationStatement *decl);
 
   string dump_ast(string prefix);
   void scopify();
-  string codegen();
+  bool codegen(const CodegenOptions& opts);
+  bool emit(const string& filename, const CodegenOptions& opts);
+  int run(const vector<string>& args, const CodegenOptions& opts);
   void const_prop();
+  void hoist_invariants();
   ~TranslationUnit();
+  const Arena& get_arena() const { return arena; }
+
+  // owns the arena, so it cannot live in it
+  static void* operator new(size_t size) { return ::operator new(size); }
+  static void operator delete(void* ptr) { ::operator delete(ptr); }
+
+private:
+  Arena arena;
 };
 } // namespace ast
@@ -6,18 +6,41 @@
 #include "error.hpp"
 using namespace std;
 
-// stuff from flex that bison needs to know about:
-extern "C" int yylex();
-extern "C" FILE *yyin;
- 
 // #define YYDEBUG 1
 // #define YYERROR_VERBOSE 1
-void yyerror(ast::TranslationUnit* tu, const char *s);
 
 void setpos(ast::Node *n, void* info);
+ast::sympos getpos(void* info);
+
+// a rule spans from the start of its first symbol to the end of its last, an
+// empty rule sits at the end of the symbol before it
+#define YYLLOC_DEFAULT(Cur, Rhs, N) \
+  do { \
+    if (N) { (Cur).begin = YYRHSLOC(Rhs, 1).begin; (Cur).end = YYRHSLOC(Rhs, N).end; } \
+    else { (Cur).begin = (Cur).end = YYRHSLOC(Rhs, 0).end; } \
+  } while (0)
 %}
 
-%parse-param {ast::TranslationUnit* tu}
+%code requires {
+// the scanner is reentrant, its state is passed around as a yyscan_t
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+}
+
+%code {
+// stuff from flex that bison needs to know about:
+extern "C" int yylex(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, yyscan_t yyscanner);
+
+void yyerror(YYLTYPE* loc, ast::TranslationUnit* tu, yyscan_t scanner, const char *s);
+}
+
+%define api.pure full
+%locations
+%define api.location.type {ast::sympos}
+%parse-param {ast::TranslationUnit* tu} {yyscan_t scanner}
+%lex-param {yyscan_t scanner}
 %define parse.error verbose
 
 %union {
@@ -43,8 +66,10 @@ void setpos(ast::Node *n, void* info);
     vector<ast::InitDeclarator*>*  ast_init_declarator_list; 
     vector<ast::PureDeclaration*>* ast_parameter_list;
     vector<ast::Expression*>* ast_expression_list;
+    ast::RecordSpecifier*  ast_record_specifier;
+    vector<ast::Declaration*>* ast_declaration_list;
 
-    char* str;
+    istring str;
     int ast_pointer_list;
 }
 
@@ -52,6 +77,7 @@ void setpos(ast::Node *n, void* info);
 %token  <str> IDENTIFIER
 %token  <str> I_CONSTANT F_CONSTANT
 %token  <str> STRING_LITERAL
+%token  <str> LOOP_PRAGMA
 %token	PTR_OP INC_OP DEC_OP LEFT_OP RIGHT_OP LE_OP GE_OP EQ_OP NE_OP
 %token	AND_OP OR_OP MUL_ASSIGN DIV_ASSIGN MOD_ASSIGN ADD_ASSIGN
 %token	SUB_ASSIGN LEFT_ASSIGN RIGHT_ASSIGN AND_ASSIGN
@@ -105,6 +131,7 @@ void setpos(ast::Node *n, void* info);
 %nterm <ast_expression> conditional_expression
 %nterm <ast_expression> assignment_expression
 %nterm <ast_expression> expression
+%nterm <ast_expression> type_name
 
 %nterm <ast_expression_list> argument_expression_list
 
@@ -113,14 +140,16 @@ void setpos(ast::Node *n, void* info);
 %nterm <ast_init_declarator> init_declarator
 %nterm <ast_pointer_list> pointer_list
 
-%nterm <ast_type_specifier> type_specifier
+%nterm <ast_type_specifier> type_specifier struct_or_union
+%nterm <ast_record_specifier> struct_or_union_specifier
+%nterm <ast_declaration_list> struct_declaration_list
 %nterm <ast_storage_specifier> storage_class_specifier
 %nterm <ast_type_qualifier> type_qualifier
 %nterm <ast_function_specifier> function_specifier
 %nterm <ast_declaration_specifiers> declaration_specifiers
 %nterm <ast_init_declarator_list> init_declarator_list
 %nterm <ast_function_parameter_list> function_parameter_list
-%nterm <ast_pure_declaration> pure_declaration
+%nterm <ast_pure_declaration> pure_declaration parameter_declaration
 %nterm <ast_expression_statement> expression_statement
 %nterm <ast_declaration_statement> declaration_statement
 
@@ -137,21 +166,21 @@ primary_expression
     ;
 
 constant
-    : I_CONSTANT { $$ = new ast::Literal($1, ast::LT_INT_LIKE); setpos($$, &@$); }
-    | F_CONSTANT { $$ = new ast::Literal($1, ast::LT_FLOAT_LIKE);setpos($$, &@$); }
+    : I_CONSTANT { $$ = new ast::Literal(*$1, ast::LT_INT_LIKE, getpos(&@$)); }
+    | F_CONSTANT { $$ = new ast::Literal(*$1, ast::LT_FLOAT_LIKE, getpos(&@$)); }
     ;
 
 string
-    : STRING_LITERAL { $$ = new ast::Literal($1, ast::LT_STRING); setpos($$, &@$); }
+    : STRING_LITERAL { $$ = new ast::Literal(*$1, ast::LT_STRING, getpos(&@$)); }
     ;
 
 postfix_expression
     : primary_expression { $$ = $1; } // lvalue
-    | postfix_expression '[' expression ']' // lvalue, not handled
+    | postfix_expression '[' expression ']' { $$ = new ast::SubscriptExpression($1, $3); setpos($$, &@$); } // lvalue
     | postfix_expression '(' ')' { $$ = new ast::FunctionInvocationExpression($1); setpos($$, &@$); }
     | postfix_expression '(' argument_expression_list ')' { $$ = new ast::FunctionInvocationExpression($1, $3); setpos($$, &@$); }
-    | postfix_expression '.' IDENTIFIER // lvalue, not handled
-    | postfix_expression PTR_OP IDENTIFIER // lvalue, not handled
+    | postfix_expression '.' IDENTIFIER { $$ = new ast::MemberExpression($1, $3, false); setpos($$, &@$); } // lvalue
+    | postfix_expression PTR_OP IDENTIFIER { $$ = new ast::MemberExpression($1, $3, true); setpos($$, &@$); } // lvalue
     | postfix_expression INC_OP { $$ = ast::allocateUnaryExpression(ast::OP_POST_INCR, $1); setpos($$, &@$); }
     | postfix_expression DEC_OP { $$ = ast::allocateUnaryExpression(ast::OP_POST_DECR, $1); setpos($$, &@$); }
     ;
@@ -166,6 +195,14 @@ unary_expression
     | INC_OP unary_expression { $$ = ast::allocateUnaryExpression(ast::OP_PRE_INCR, $2); setpos($$, &@$); } // rvalue
     | DEC_OP unary_expression { $$ = ast::allocateUnaryExpression(ast::OP_PRE_DECR, $2); setpos($$, &@$); } // rvalue
     | unary_operator unary_expression { $$ = ast::allocateUnaryExpression($1, $2); setpos($$, &@$); }
+    | SIZEOF unary_expression { $$ = new ast::UnaryExpression(ast::OP_SIZEOF, $2); setpos($$, &@$); }
+    | SIZEOF '(' type_name ')' { $$ = new ast::UnaryExpression(ast::OP_SIZEOF, $3); setpos($$, &@$); }
+    | ALIGNOF '(' type_name ')' { $$ = new ast::UnaryExpression(ast::OP_ALIGNOF, $3); setpos($$, &@$); }
+    ;
+
+type_name
+    : declaration_specifiers { $$ = new ast::TypeName($1, 0); setpos($$, &@$); }
+    | declaration_specifiers pointer_list { $$ = new ast::TypeName($1, $2); setpos($$, &@$); }
     ;
 
 unary_operator
@@ -271,7 +308,7 @@ constant_expression
 /* -Declarations------------------------------------------------------------- */
 
 declaration
-	: declaration_specifiers ';' { $$ = new ast::Declaration($1, nullptr); setpos($$, &@$); }      /* idk just put nullptr here TODO */
+	: declaration_specifiers ';' { $$ = new ast::Declaration($1, new std::vector<ast::InitDeclarator*>()); setpos($$, &@$); }      /* declares only a struct or union tag */
 	| declaration_specifiers init_declarator_list ';' { $$ = new ast::Declaration($1, $2); setpos($$, &@$); }
 	;
 
@@ -284,6 +321,25 @@ declaration_specifiers
 	| type_qualifier { $$ = new ast::DeclarationSpecifiers(); $$->add_type_qualifier($1); setpos($$, &@$); }
 	| function_specifier declaration_specifiers { $2->add_func_specifier($1); $$ = $2; setpos($$, &@$); }
 	| function_specifier { $$ = new ast::DeclarationSpecifiers(); $$->add_func_specifier($1); setpos($$, &@$); }
+	| struct_or_union_specifier declaration_specifiers { $2->add_record_specifier($1); $$ = $2; setpos($$, &@$); }
+	| struct_or_union_specifier { $$ = new ast::DeclarationSpecifiers(); $$->add_record_specifier($1); setpos($$, &@$); }
+	;
+
+struct_or_union_specifier
+	: struct_or_union IDENTIFIER '{' struct_declaration_list '}' { $$ = new ast::RecordSpecifier($1, $2, $4); setpos($$, &@$); }
+	| struct_or_union '{' struct_declaration_list '}' { $$ = new ast::RecordSpecifier($1, nullptr, $3); setpos($$, &@$); }
+	| struct_or_union IDENTIFIER { $$ = new ast::RecordSpecifier($1, $2, nullptr); setpos($$, &@$); }
+	;
+
+struct_or_union
+	: STRUCT { $$ = ast::TS_STRUCT; }
+	| UNION { $$ = ast::TS_UNION; }
+	;
+
+/* fields are parsed as declarations, scopify rejects what a field can't have */
+struct_declaration_list
+	: declaration { $$ = new std::vector<ast::Declaration*>(); $$->push_back($1); }
+	| struct_declaration_list declaration { $1->push_back($2); $$ = $1; }
 	;
 
 init_declarator_list
@@ -296,6 +352,8 @@ init_declarator
 	| IDENTIFIER '=' assignment_expression { $$ = new ast::InitDeclarator(0, new ast::Identifier($1), $3); setpos($$, &@$); }
 	| pointer_list IDENTIFIER { $$ = new ast::InitDeclarator($1, new ast::Identifier($2), nullptr); setpos($$, &@$); }
 	| IDENTIFIER { $$ = new ast::InitDeclarator(0, new ast::Identifier($1), nullptr); setpos($$, &@$); }
+	| pointer_list IDENTIFIER '[' constant_expression ']' { $$ = new ast::InitDeclarator($1, new ast::Identifier($2), nullptr, $4); setpos($$, &@$); }
+	| IDENTIFIER '[' constant_expression ']' { $$ = new ast::InitDeclarator(0, new ast::Identifier($1), nullptr, $3); setpos($$, &@$); }
 	;
 
 pointer_list
@@ -345,8 +403,17 @@ function_parameter_list
 	;
 
 parameter_list
-	: pure_declaration { $$ = new std::vector<ast::PureDeclaration*>(); $$->push_back($1); } 
-	| parameter_list ',' pure_declaration { $1->push_back($3); $$ = $1; } 
+	: parameter_declaration { $$ = new std::vector<ast::PureDeclaration*>(); $$->push_back($1); } 
+	| parameter_list ',' parameter_declaration { $1->push_back($3); $$ = $1; } 
+	;
+
+/* array parameters decay to pointers, the size is not checked */
+parameter_declaration
+	: pure_declaration { $$ = $1; }
+	| declaration_specifiers pointer_list IDENTIFIER '[' ']' { $$ = new ast::PureDeclaration($1, $2 + 1, new ast::Identifier($3)); setpos($$, &@$); }
+	| declaration_specifiers IDENTIFIER '[' ']' { $$ = new ast::PureDeclaration($1, 1, new ast::Identifier($2)); setpos($$, &@$); }
+	| declaration_specifiers pointer_list IDENTIFIER '[' constant_expression ']' { $$ = new ast::PureDeclaration($1, $2 + 1, new ast::Identifier($3)); setpos($$, &@$); }
+	| declaration_specifiers IDENTIFIER '[' constant_expression ']' { $$ = new ast::PureDeclaration($1, 1, new ast::Identifier($2)); setpos($$, &@$); }
 	;
 
 pure_declaration
@@ -372,7 +439,7 @@ declaration_statement
 labeled_statement
 	: IDENTIFIER ':' statement { $$ = new ast::LabeledStatement(new ast::Identifier($1), $3); setpos($$, &@$); }
 	| CASE constant_expression ':' statement { $$ = new ast::CaseStatement($2, $4); setpos($$, &@$); }
-	| DEFAULT ':' statement { $$ = $3; setpos($$, &@$); }
+	| DEFAULT ':' statement { $$ = new ast::CaseStatement(nullptr, $3); setpos($$, &@$); }
 	;
 
 compound_statement 
@@ -398,6 +465,17 @@ selection_statement
 iteration_statement
 	: WHILE '(' expression ')' statement { $$ = new ast::WhileStatement($3, $5); setpos($$, &@$); }
 	| DO statement WHILE '(' expression ')' ';' { $$ = new ast::DoWhileStatement($5, $2); setpos($$, &@$); }
+	| FOR '(' expression_statement expression_statement ')' statement { $$ = new ast::ForStatement($3, $4->expr, nullptr, $6); setpos($$, &@$); }
+	| FOR '(' expression_statement expression_statement expression ')' statement {
+		ast::Statement* step = new ast::ExpressionStatement($5); setpos(step, &@5);
+		$$ = new ast::ForStatement($3, $4->expr, step, $7); setpos($$, &@$); }
+	| FOR '(' declaration_statement expression_statement ')' statement { $$ = new ast::ForStatement($3, $4->expr, nullptr, $6); setpos($$, &@$); }
+	| FOR '(' declaration_statement expression_statement expression ')' statement {
+		ast::Statement* step = new ast::ExpressionStatement($5); setpos(step, &@5);
+		$$ = new ast::ForStatement($3, $4->expr, step, $7); setpos($$, &@$); }
+	| LOOP_PRAGMA iteration_statement {
+		if (!static_cast<ast::LoopStatement*>($2)->hints.add_pragma(*$1)) yyerror(&@1, tu, scanner, "malformed loop pragma");
+		$$ = $2; setpos($$, &@$); }
 	;
 
 jump_statement
@@ -411,12 +489,12 @@ jump_statement
 /* -Translation Unit and Functions------------------------------------------- */
 
 translation_unit
-	: function_definition { $$ = new ast::TranslationUnit(); $$->add_function($1); *tu = *$$; setpos($$, &@$); }
-    | function_declaration { $$ = new ast::TranslationUnit(); $$->add_function($1); *tu = *$$; setpos($$, &@$); }
-	| declaration { $$ = new ast::TranslationUnit(); $$->add_declaration(new ast::DeclarationStatement($1)); *tu = *$$; setpos($$, &@$); }
-	| translation_unit function_definition { $1->add_function($2); $$ = $1; *tu = *$$; setpos($$, &@$); }
-    | translation_unit function_declaration { $1->add_function($2); $$ = $1; *tu = *$$; setpos($$, &@$); }
-	| translation_unit declaration { $1->add_declaration(new ast::DeclarationStatement($2)); $$ = $1; *tu = *$$; setpos($$, &@$); }
+	: function_definition { tu->add_function($1); $$ = tu; setpos($$, &@$); }
+    | function_declaration { tu->add_function($1); $$ = tu; setpos($$, &@$); }
+	| declaration { tu->add_declaration(new ast::DeclarationStatement($1)); $$ = tu; setpos($$, &@$); }
+	| translation_unit function_definition { $1->add_function($2); $$ = $1; setpos($$, &@$); }
+    | translation_unit function_declaration { $1->add_function($2); $$ = $1; setpos($$, &@$); }
+	| translation_unit declaration { $1->add_declaration(new ast::DeclarationStatement($2)); $$ = $1; setpos($$, &@$); }
 	;
 
 function_definition
@@ -434,17 +512,16 @@ function_declaration
 %%
 #include <stdio.h>
 
-void yyerror(ast::TranslationUnit* tu, const char *s)
+void yyerror(YYLTYPE* loc, ast::TranslationUnit* tu, yyscan_t scanner, const char *s)
 {
-  YYLTYPE info = yylloc;
-  ehdl::err(s, {info.first_line, info.last_line, info.first_column, info.last_column});
+  ehdl::report(ehdl::E_SYNTAX, *loc, {s});
 }
 
 
+ast::sympos getpos(void* info_v) {
+    return *((YYLTYPE*)info_v);
+}
+
 void setpos(ast::Node *n, void* info_v) {
-    YYLTYPE info = *((YYLTYPE*)info_v);
-    n->pos.first_line = info.first_line;
-    n->pos.last_line = info.last_line;
-    n->pos.first_column = info.first_column;
-    n->pos.last_column = info.last_column;
+    n->pos = getpos(info_v);
 }
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <sstream>
+#include <sys/time.h>
+#include <vector>
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "cache.hpp"
+
+using namespace llvm;
+
+struct CacheEntry {
+    string path;
+    uint64_t size;
+    sys::TimePoint<> used;
+};
+
+static vector<CacheEntry> list_entries(const string& dir) {
+    vector<CacheEntry> entries;
+    std::error_code ec;
+    for (sys::fs::directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+        sys::fs::file_status st;
+        if (sys::fs::status(it->path(), st) || st.type() != sys::fs::file_type::regular_file) continue;
+        entries.push_back({it->path(), st.getSize(), st.getLastModificationTime()});
+    }
+    return entries;
+}
+
+// writes data to a new file next to path and renames it over path, so that
+// readers see either the old file or all of the new one
+static bool write_atomic(const string& path, StringRef data) {
+    SmallString<128> tmp;
+    int fd;
+    if (sys::fs::createUniqueFile(path + ".%%%%%%%%.tmp", fd, tmp)) return false;
+    raw_fd_ostream os(fd, true);
+    os << data;
+    os.close();
+    if (os.has_error()) {
+        os.clear_error();
+        sys::fs::remove(tmp);
+        return false;
+    }
+    if (sys::fs::rename(tmp, path)) {
+        sys::fs::remove(tmp);
+        return false;
+    }
+    return true;
+}
+
+CompileCache::CompileCache(const string& dir, uint64_t max_bytes): dir{dir}, max_bytes{max_bytes} {
+    sys::fs::create_directories(dir);
+
+    // a rebuilt compiler may emit different code for the same source
+    stringstream id;
+    id << "cc 1.0, llvm " LLVM_VERSION_STRING;
+    sys::fs::file_status st;
+    if (!sys::fs::status(sys::fs::getMainExecutable(nullptr, nullptr), st)) {
+        id << ", " << st.getSize() << " bytes built at " << st.getLastModificationTime().time_since_epoch().count();
+    }
+    compiler_id = id.str();
+
+    native_cpu = sys::getHostCPUName().str();
+    StringMap<bool> features;
+    if (sys::getHostCPUFeatures(features)) {
+        vector<string> enabled;
+        for (auto& feature : features) {
+            if (feature.second) enabled.push_back(feature.first().str());
+        }
+        std::sort(enabled.begin(), enabled.end());
+        for (auto& feature : enabled) native_cpu += "," + feature;
+    }
+}
+
+string CompileCache::path_for(const string& key) const {
+    SmallString<128> path(dir);
+    sys::path::append(path, key);
+    return path.str().str();
+}
+
+// Everything create_target_machine and optimize_module look at. The number of
+// codegen threads never changes the output, so units compiled with any
+// --codegen-threads share entries.
+string CompileCache::key(string_view source, const ast::CodegenOptions& opts) const {
+    stringstream flags;
+    flags << compiler_id << '\0' << opts.ssa << ' ' << opts.opt_level << ' ' << opts.emit << '\0'
+          << opts.passes << '\0' << opts.march << '\0' << sys::getDefaultTargetTriple() << '\0'
+          << (opts.mcpu == "native" ? native_cpu : opts.mcpu) << '\0';
+
+    MD5 md5;
+    md5.update(flags.str());
+    md5.update(StringRef(source.data(), source.size()));
+    MD5::MD5Result hash;
+    md5.final(hash);
+    return hash.digest().str().str();
+}
+
+bool CompileCache::fetch(const string& key, const string& output) {
+    string path = path_for(key);
+    auto buf = MemoryBuffer::getFile(path, false, false);
+    if (!buf || !write_atomic(output, (*buf)->getBuffer())) {
+        misses++;
+        return false;
+    }
+    // the modification time is what eviction orders entries by
+    utimes(path.c_str(), nullptr);
+    hits++;
+    return true;
+}
+
+void CompileCache::store(const string& key, const string& output) {
+    auto buf = MemoryBuffer::getFile(output, false, false);
+    if (!buf || !write_atomic(path_for(key), (*buf)->getBuffer())) return;
+    stores++;
+    evict();
+}
+
+void CompileCache::evict() {
+    std::lock_guard<std::mutex> lock(evict_mutex);
+    vector<CacheEntry> entries = list_entries(dir);
+    uint64_t total = 0;
+    for (auto& entry : entries) total += entry.size;
+    if (total <= max_bytes) return;
+
+    std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b) {
+        return a.used < b.used;
+    });
+    for (auto& entry : entries) {
+        if (total <= max_bytes) break;
+        // another process may have evicted it already
+        if (!sys::fs::remove(entry.path, false)) {
+            total -= entry.size;
+            evictions++;
+        }
+    }
+}
+
+void CompileCache::print_stats(ostream& os) const {
+    vector<CacheEntry> entries = list_entries(dir);
+    uint64_t total = 0;
+    for (auto& entry : entries) total += entry.size;
+    os << "cache " << dir << ": " << hits << " hits, " << misses << " misses, " << stores << " stored, "
+       << evictions << " evicted; " << entries.size() << " entries, " << total << " of " << max_bytes
+       << " bytes" << endl;
+}
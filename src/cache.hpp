@@ -0,0 +1,53 @@
+#ifndef CACHE
+#define CACHE
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "ast.hpp"
+
+using namespace std;
+
+// Content-addressed cache of emitted files for --cache-dir. An entry is named
+// by the MD5 of the source bytes, the compiler build and every option that
+// changes the output, so a hit can be copied to the output without parsing.
+// Entries and outputs are written to a temporary file and renamed into place,
+// so other processes sharing the directory never see half of one. A hit
+// touches the entry, and stores evict the least recently used entries once
+// the directory grows past its limit.
+class CompileCache {
+private:
+    string dir;
+    uint64_t max_bytes;
+    string compiler_id;             // version and build of this executable
+    string native_cpu;              // what -mcpu=native means on this host
+
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<size_t> stores{0};
+    std::atomic<size_t> evictions{0};
+    std::mutex evict_mutex;         // units finishing together scan the directory once
+
+    string path_for(const string& key) const;
+    void evict();
+
+public:
+    CompileCache(const string& dir, uint64_t max_bytes);
+    CompileCache(const CompileCache&) = delete;
+    CompileCache& operator=(const CompileCache&) = delete;
+
+    string key(string_view source, const ast::CodegenOptions& opts) const;
+
+    // copies the entry to output, false on a miss
+    bool fetch(const string& key, const string& output);
+    // adds the emitted output under key
+    void store(const string& key, const string& output);
+
+    // hits and misses of this run, and what the directory holds now
+    void print_stats(ostream& os) const;
+};
+
+#endif
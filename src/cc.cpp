@@ -1,86 +1,342 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
-#include <assert.h>
-#include <fstream>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
 #include "ast.hpp"
 #include "error.hpp"
 #include "debug.hpp"
-#include "c.tab.hpp"
 #include "symtab.hpp"
+#include "compiler.hpp"
+#include "cache.hpp"
 #include "argparse.hpp"
 
-extern "C" FILE *yyin;
+// driver settings that are not codegen options
+struct DriverOptions {
+  bool print_ast = false;
+  bool mem_stats = false;
+  bool time_report = false;
+  bool warn_padding = false;    // -Wpadding
+  ehdl::DiagnosticFormat diagnostics_format = ehdl::DF_TEXT;
+  bool run = false;
+  string output;                // -o, only valid for a single source
+  vector<string> run_args;      // argv for main with --run
+  CompileCache* cache = nullptr;  // --cache-dir, not used with --run, -t, -m, -Wpadding or --time-report
+};
+
+// units compiled in parallel report one at a time
+static std::mutex output_mutex;
+
+// everything the passes reported for the unit, in one piece
+static void print_diags(const CompilerInstance& ci, const DriverOptions& dopts) {
+  std::lock_guard<std::mutex> lock(output_mutex);
+  ci.diags.print(std::cout, dopts.diagnostics_format);
+}
+
+// Compiles one source file in its own CompilerInstance. Returns 1 if the unit
+// has errors, otherwise main's exit code with --run and 0 without.
+int compile(const string& filename, const ast::CodegenOptions& opts, const DriverOptions& dopts) {
+  CompilerInstance ci(filename);
+
+  static const char* extensions[] = { ".ll", ".bc", ".s", ".o" };
+  std::string output_fname = filename.substr(0,filename.find_last_of('.'))+extensions[opts.emit];
+  if (!dopts.output.empty()) {
+    output_fname = dopts.output;
+  }
+
+  // a hit skips every pass, parse included, so units asked for anything
+  // the passes print besides the output always compile
+  bool cacheable = !dopts.run && !dopts.print_ast && !dopts.mem_stats && !dopts.time_report && !dopts.warn_padding;
+  string cache_key;
+  if (dopts.cache && cacheable && ci.load()) {
+    cache_key = dopts.cache->key(ci.get_source()->text(), opts);
+    if (dopts.cache->fetch(cache_key, output_fname)) return 0;
+  }
+
+  bool parsed;
+  {
+    TimeReport::Scope phase(ci.time_report, "parse");
+    parsed = ci.parse();
+  }
+  if (!parsed) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    ci.diags.print(std::cout, dopts.diagnostics_format);
+    // stdout only carries JSON objects in json mode
+    (dopts.diagnostics_format == ehdl::DF_JSON ? cerr : cout) << "Error: parse error. Not proceeding with further steps" << endl;
+    return 1;
+  }
+  ast::TranslationUnit* tu = ci.get_tu();
+
+  {
+    TimeReport::Scope phase(ci.time_report, "scopify");
+    tu->scopify();
+  }
+
+  if (dopts.warn_padding) {
+    ci.records.report_padding();
+  }
+
+  if (dopts.print_ast) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << tu->dump_ast("") << std::endl;
+  }
+
+  if (ci.diags.n_errs() > 0) {
+    print_diags(ci, dopts);
+    return 1;
+  }
+
+  cdebug << "scopify done" << endl;
+
+  {
+    TimeReport::Scope phase(ci.time_report, "const_prop");
+    tu->const_prop();
+  }
+
+  {
+    TimeReport::Scope phase(ci.time_report, "licm");
+    tu->hoist_invariants();
+  }
+
+  cdebug << "optimization done" << endl;
+
+  bool ok = tu->codegen(opts);
+
+  print_diags(ci, dopts);
+  if (ci.diags.n_errs() > 0 || !ok) {
+    return 1;
+  }
+
+  if (dopts.mem_stats) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    const Arena& arena = tu->get_arena();
+    size_t n_nodes = arena.get_n_objects();
+    std::cout << filename << ": ast arena: " << n_nodes << " nodes, " << arena.get_bytes_used() << " bytes ("
+              << (n_nodes ? double(arena.get_bytes_used()) / n_nodes : 0.0) << " bytes/node), "
+              << arena.get_n_blocks() << " blocks, " << arena.get_bytes_reserved() << " bytes reserved" << std::endl;
+  }
+
+  int ret = 0;
+  if (dopts.run) {
+    TimeReport::Scope phase(ci.time_report, "run");
+    ret = tu->run(dopts.run_args, opts);
+  }
+  else {
+    TimeReport::Scope phase(ci.time_report, "emit");
+    bool emitted = tu->emit(output_fname, opts);
+    // units with warnings are not cached, a hit could not repeat them
+    if (emitted && !cache_key.empty() && ci.diags.n_warns() == 0) {
+      dopts.cache->store(cache_key, output_fname);
+    }
+    ret = emitted ? 0 : 1;
+  }
+
+  if (dopts.time_report) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    ci.time_report.print(std::cerr, filename, tu->get_arena());
+  }
+
+  return ret;
+}
+
+// options followed by a separate value, as in -o out.ll
+static const std::set<string> value_options = {
+  "-o", "--object", "--passes", "--emit", "-march", "-mcpu", "--jit-cache", "--cache-dir", "--cache-size",
+  "--codegen-threads", "--diagnostics-format", "--time-trace", "-j", "--jobs"
+};
+
+// With --run everything after the program, or after --, is its argv and not
+// ours: removes those arguments from args and returns them. A --run after
+// the program, as in cc prog.c --run, still belongs to cc.
+static vector<string> split_program_args(vector<string>& args) {
+  size_t run_at = 0;
+  for (size_t i = 1; i < args.size() && args[i] != "--" && !run_at; i++) {
+    if (args[i] == "-r" || args[i] == "--run") run_at = i;
+  }
+  if (!run_at) return {};
+
+  bool options_done = false;
+  for (size_t i = 1; i < args.size(); i++) {
+    if (args[i] == "--" && !options_done) {
+      args.erase(args.begin() + i--);
+      options_done = true;
+    }
+    else if (!options_done && args[i].size() > 1 && args[i][0] == '-') {
+      if (value_options.count(args[i])) i++;
+    }
+    else {
+      if (run_at > i) args.erase(args.begin() + run_at);
+      vector<string> program_args(args.begin() + i + 1, args.end());
+      args.resize(i + 1);
+      if (run_at > i) args.push_back("--run");
+      if (!program_args.empty() && program_args[0] == "--") program_args.erase(program_args.begin());
+      return program_args;
+    }
+  }
+  return {};
+}
 
 int main(int argc, char **argv) {
 
   argparse::ArgumentParser cc("cc", "1.0");
 
-  cc.add_argument("source").help("Source file to compile");
+  cc.add_argument("source").help("Source files to compile (with --run: the program, then its arguments)").nargs(argparse::nargs_pattern::at_least_one);
   cc.add_argument("-o", "--object").help("Object file to generate");
   cc.add_argument("-t", "--print-ast").help("Print AST").flag();
+  cc.add_argument("-m", "--mem-stats").help("Print AST arena statistics").flag();
+  cc.add_argument("--ssa").help("Build SSA form directly instead of alloca/load/store").flag();
+  cc.add_argument("-O0").help("Disable optimizations (default)").flag();
+  cc.add_argument("-O1").help("Run the LLVM O1 pipeline").flag();
+  cc.add_argument("-O2").help("Run the LLVM O2 pipeline").flag();
+  cc.add_argument("-O3").help("Run the LLVM O3 pipeline").flag();
+  cc.add_argument("--passes").help("Run a custom LLVM pass pipeline, e.g. --passes=mem2reg,instcombine");
+  cc.add_argument("--emit").help("Output format: obj, asm, bc or ll").default_value(string("ll"));
+  cc.add_argument("-march").help("Target architecture (default: host)");
+  cc.add_argument("-mcpu").help("Target cpu, 'native' to use the host's features (default: generic)");
+  cc.add_argument("-r", "--run").help("JIT compile and run main instead of writing output").flag();
+  cc.add_argument("--jit-cache").help("Directory to cache objects compiled by --run in");
+  cc.add_argument("--cache-dir").help("Reuse output emitted earlier for the same source and flags from this directory");
+  cc.add_argument("--cache-size").help("Size limit of --cache-dir in MB, least recently used entries go first").default_value(1024).scan<'i', int>();
+  cc.add_argument("--cache-stats").help("Print cache hits, misses and size after compiling").flag();
+  cc.add_argument("--codegen-threads").help("Number of threads generating function bodies of one file").default_value(1).scan<'i', int>();
+  cc.add_argument("-Wpadding").help("Warn about padding inside structs and suggest a smaller field order").flag();
+  cc.add_argument("--diagnostics-format").help("Print errors and warnings as text or json, one object per line").default_value(string("text"));
+  cc.add_argument("--time-report").help("Print time, memory and allocations per phase and AST node counts").flag();
+  cc.add_argument("--time-trace").help("Write a Chrome trace of the compilation to this file");
+  cc.add_argument("-j", "--jobs").help("Number of files to compile in parallel").default_value(1).scan<'i', int>();
   if (argc == 1) {
     std::cerr << cc;
     return 0;
   }
 
+  // argparse only splits --name=value, accept gcc style -march=x/-mcpu=x too
+  vector<string> args(argv, argv + argc);
+  for (size_t i = 1; i < args.size(); i++) {
+    size_t eq = args[i].find('=');
+    if (eq != string::npos && (args[i].rfind("-march=", 0) == 0 || args[i].rfind("-mcpu=", 0) == 0)) {
+      args.insert(args.begin() + i + 1, args[i].substr(eq + 1));
+      args[i].resize(eq);
+      i++;
+    }
+  }
+  vector<string> program_args = split_program_args(args);
+
   try {
-    cc.parse_args(argc, argv);
+    cc.parse_args(args);
   }
   catch (const std::exception& err) {
     std::cerr << err.what() << std::endl;
     std::cerr << cc;
-    return 0;
+    return 1;
   }
 
-  string filename = cc.get("source");
-  ehdl::set_filename(filename);
-  yyin = fopen(filename.c_str(), "r");
-  assert(yyin);
-  ast::TranslationUnit* tu = new ast::TranslationUnit();
-  int ret = yyparse(tu);
+  vector<string> sources = cc.get<vector<string>>("source");
 
-  if (ret != 0) {
-    ehdl::print_errs();
-    cout << "Error: parse error. Not proceeding with further steps" << endl;
-    delete tu;
-    return 0;
+  DriverOptions dopts;
+  dopts.print_ast = (cc["--print-ast"] == true);
+  dopts.mem_stats = (cc["--mem-stats"] == true);
+  dopts.run = (cc["--run"] == true);
+  dopts.time_report = (cc["--time-report"] == true);
+  dopts.warn_padding = (cc["-Wpadding"] == true);
+  if (auto oname = cc.present("-o")) {
+    dopts.output = *oname;
   }
-
-  tu->scopify();
-
-  if (cc["--print-ast"] == true) {
-    std::cout << tu->dump_ast("") << std::endl;
+  string diagnostics_format = cc.get("--diagnostics-format");
+  if (diagnostics_format == "text") dopts.diagnostics_format = ehdl::DF_TEXT;
+  else if (diagnostics_format == "json") dopts.diagnostics_format = ehdl::DF_JSON;
+  else {
+    cerr << "Error: unknown --diagnostics-format '" << diagnostics_format << "', expected text or json" << endl;
+    return 1;
   }
 
-  if (ehdl::n_errs() > 0) {
-    ehdl::print_errs();
-    delete tu;
-    return 0;
+  ast::CodegenOptions opts;
+  opts.ssa = (cc["--ssa"] == true);
+  for (int level = 1; level <= 3; level++) {
+    if (cc["-O" + to_string(level)] == true) opts.opt_level = level;
   }
+  if (auto passes = cc.present("--passes")) {
+    opts.passes = *passes;
+  }
+  string emit = cc.get("--emit");
+  if (emit == "obj") opts.emit = ast::EMIT_OBJ;
+  else if (emit == "asm") opts.emit = ast::EMIT_ASM;
+  else if (emit == "bc") opts.emit = ast::EMIT_BC;
+  else if (emit == "ll") opts.emit = ast::EMIT_LL;
+  else {
+    cerr << "Error: unknown --emit kind '" << emit << "', expected obj, asm, bc or ll" << endl;
+    return 1;
+  }
+  if (auto march = cc.present("-march")) {
+    opts.march = *march;
+  }
+  if (auto mcpu = cc.present("-mcpu")) {
+    opts.mcpu = *mcpu;
+  }
+  opts.codegen_threads = cc.get<int>("--codegen-threads");
 
-  cdebug << "scopify done" << endl;
-
-  tu->const_prop();
+  auto time_trace = cc.present("--time-trace");
+  if (time_trace) {
+    llvm::timeTraceProfilerInitialize(0, "cc");
+  }
 
-  cdebug << "optimization done" << endl;
+  int ret = 0;
+  if (dopts.run) {
+    if (auto dir = cc.present("--jit-cache")) {
+      opts.jit_cache_dir = *dir;
+    }
+    dopts.run_args = {sources[0]};
+    dopts.run_args.insert(dopts.run_args.end(), program_args.begin(), program_args.end());
+    ret = compile(sources[0], opts, dopts);
+  }
+  else if (!dopts.output.empty() && sources.size() > 1) {
+    cerr << "Error: -o can only be used with a single source file" << endl;
+    ret = 1;
+  }
+  else {
+    std::unique_ptr<CompileCache> cache;
+    if (auto dir = cc.present("--cache-dir")) {
+      cache = std::make_unique<CompileCache>(*dir, uint64_t(std::max(0, cc.get<int>("--cache-size"))) << 20);
+      dopts.cache = cache.get();
+    }
 
-  string code = tu->codegen();
+    // every worker takes the next file until none are left; the build fails
+    // if any unit does
+    int jobs = std::max(1, std::min(cc.get<int>("--jobs"), (int)sources.size()));
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto worker = [&]() {
+      size_t i;
+      while ((i = next++) < sources.size()) {
+        if (compile(sources[i], opts, dopts) != 0) failed = true;
+      }
+    };
+    vector<std::thread> pool;
+    for (int i = 1; i < jobs; i++) {
+      pool.emplace_back([&]() {
+        if (time_trace) llvm::timeTraceProfilerInitialize(0, "cc");
+        worker();
+        if (time_trace) llvm::timeTraceProfilerFinishThread();
+      });
+    }
+    worker();
+    for (auto& t : pool) {
+      t.join();
+    }
+    ret = failed ? 1 : 0;
 
-  if (ehdl::n_errs() > 0) {
-    ehdl::print_errs();
-    delete tu;
-    return 0;
+    if (cache && cc["--cache-stats"] == true) {
+      cache->print_stats(std::cerr);
+    }
   }
 
-  std::string output_fname = filename.substr(0,filename.find_last_of('.'))+".ll";
-  if (auto oname = cc.present("-o")) {
-    output_fname = *oname;
+  if (time_trace) {
+    if (auto err = llvm::timeTraceProfilerWrite(*time_trace, "cc")) {
+      cerr << "Error: could not write " << *time_trace << ": " << llvm::toString(std::move(err)) << endl;
+    }
+    llvm::timeTraceProfilerCleanup();
   }
-  std::fstream f(output_fname, f.out);
-  f << code << endl;
-  f.flush();
-  f.close();
 
-  return 0;
+  return ret;
 }
@@ -0,0 +1,276 @@
+#include <unordered_set>
+#include "cfg.hpp"
+#include "debug.hpp"
+
+CFG::CFG(ast::Function* func): current{ENTRY}, exit{0}, supported{true} {
+  new_block();                      // ENTRY
+  exit = new_block();
+  if (func->stmts) {
+    lower(func->stmts);
+  }
+  add_edge(current, exit);
+  cdebug << "CFG of " << *func->func_decl->ident->name << ": " << blocks.size() << " blocks" << endl;
+}
+
+void CFG::lower(ast::Statement* stmt) {
+  stmt_block[stmt] = current;
+  stmt->lower(*this);
+}
+
+int CFG::new_block() {
+  blocks.emplace_back();
+  return blocks.size() - 1;
+}
+
+void CFG::add_edge(int from, int to) {
+  blocks[from].succs.push_back(to);
+  blocks[to].preds.push_back(from);
+}
+
+void CFG::append(ast::Statement* stmt) {
+  blocks[current].stmts.push_back(stmt);
+}
+
+void CFG::branch(ast::Expression** cond, int if_true, int if_false) {
+  blocks[current].cond = cond;
+  add_edge(current, if_true);
+  add_edge(current, if_false);
+}
+
+// ends the current block with a jump to the exit; whatever follows lands in a
+// block without predecessors
+void CFG::jump_to_exit() {
+  add_edge(current, exit);
+  current = new_block();
+}
+
+// labels control can jump to straight from the switch: those directly in its
+// body, possibly one after the other as in case 1: case 2:
+static void direct_labels(ast::Statement* body, unordered_set<ast::CaseStatement*>& labels) {
+  vector<ast::Statement*> stmts{body};
+  if (ast::BlockStatement* block = llvm::dyn_cast<ast::BlockStatement>(body)) stmts.assign(block->begin(), block->end());
+  for (auto stmt : stmts) {
+    while (ast::CaseStatement* label = llvm::dyn_cast_or_null<ast::CaseStatement>(stmt)) {
+      labels.insert(label);
+      stmt = label->stmt;
+    }
+  }
+}
+
+// ends the current block with the multi-way branch of sw; the body is
+// lowered into a block without predecessors, since it is only entered
+// through its labels
+void CFG::begin_switch(ast::SwitchStatement* sw, int after_block) {
+  unordered_set<ast::CaseStatement*> labels;
+  direct_labels(sw->stmt, labels);
+
+  int switch_block = current;
+  blocks[switch_block].cond = &sw->expr;
+  blocks[switch_block].sw = sw;
+  bool has_default = false;
+  for (auto label : sw->cases) {
+    if (!labels.count(label)) unsupported();      // a label inside a loop or an if
+    has_default |= !label->const_expr;
+    int block = new_block();
+    case_blocks[label] = block;
+    add_edge(switch_block, block);
+  }
+  if (!has_default) add_edge(switch_block, after_block);
+
+  targets.push_back({-1, after_block});
+  current = new_block();
+}
+
+void CFG::end_switch(int after_block) {
+  targets.pop_back();
+  add_edge(current, after_block);
+  current = after_block;
+}
+
+// falls through from the statements before the label into its block
+void CFG::start_case(ast::CaseStatement* label) {
+  auto it = case_blocks.find(label);
+  if (it == case_blocks.end()) {
+    unsupported();                  // not a label of the enclosing switch
+    return;
+  }
+  add_edge(current, it->second);
+  current = it->second;
+  stmt_block[label] = current;
+}
+
+void CFG::push_loop(int continue_target, int break_target) {
+  targets.push_back({continue_target, break_target});
+}
+
+void CFG::pop_loop() {
+  targets.pop_back();
+}
+
+int CFG::break_target() const {
+  return targets.empty() ? -1 : targets.back().second;
+}
+
+int CFG::continue_target() const {
+  // continue inside a switch continues the loop around it
+  for (auto it = targets.rbegin(); it != targets.rend(); it++) {
+    if (it->first >= 0) return it->first;
+  }
+  return -1;
+}
+
+bool CFG::is_executable(ast::Statement* stmt) const {
+  auto it = stmt_block.find(stmt);
+  if (it == stmt_block.end()) return true;
+  return blocks[it->second].executable;
+}
+
+void CFG::dump(ostream& os) const {
+  for (int i = 0; i < blocks.size(); i++) {
+    os << "bb" << i << (i == ENTRY ? " (entry)" : i == exit ? " (exit)" : "")
+       << ": " << blocks[i].stmts.size() << " stmts";
+    if (blocks[i].sw) os << ", switch";
+    else if (blocks[i].cond) os << ", branch";
+    os << " ->";
+    for (int succ : blocks[i].succs) os << " bb" << succ;
+    os << (blocks[i].executable ? "" : " [unreachable]") << endl;
+  }
+}
+
+namespace ast {
+
+// goto and labels are not lowered yet, functions using them are left to
+// codegen as they are
+void Statement::lower(CFG& cfg) {
+  cfg.unsupported();
+}
+
+void DeclarationStatement::lower(CFG& cfg) {
+  cfg.append(this);
+}
+
+void ExpressionStatement::lower(CFG& cfg) {
+  cfg.append(this);
+}
+
+void ReturnStatement::lower(CFG& cfg) {
+  cfg.append(this);
+  cfg.jump_to_exit();
+}
+
+void BlockStatement::lower(CFG& cfg) {
+  for (auto stmt : *this) {
+    cfg.lower(stmt);
+  }
+}
+
+void IfStatement::lower(CFG& cfg) {
+  int then_block = cfg.new_block();
+  int else_block = cfg.new_block();
+  int join_block = cfg.new_block();
+  cfg.branch(&cond, then_block, else_block);
+
+  cfg.set_current(then_block);
+  if (true_branch) cfg.lower(true_branch);
+  cfg.add_edge(cfg.get_current(), join_block);
+
+  cfg.set_current(else_block);
+  if (false_branch) cfg.lower(false_branch);
+  cfg.add_edge(cfg.get_current(), join_block);
+
+  cfg.set_current(join_block);
+}
+
+void WhileStatement::lower(CFG& cfg) {
+  int cond_block = cfg.new_block();
+  int body_block = cfg.new_block();
+  int after_block = cfg.new_block();
+  cfg.add_edge(cfg.get_current(), cond_block);
+
+  cfg.set_current(cond_block);
+  cfg.branch(&cond, body_block, after_block);
+
+  cfg.push_loop(cond_block, after_block);
+  cfg.set_current(body_block);
+  if (stmt) cfg.lower(stmt);
+  cfg.add_edge(cfg.get_current(), cond_block);
+  cfg.pop_loop();
+
+  cfg.set_current(after_block);
+}
+
+void DoWhileStatement::lower(CFG& cfg) {
+  int body_block = cfg.new_block();
+  int cond_block = cfg.new_block();
+  int after_block = cfg.new_block();
+  cfg.add_edge(cfg.get_current(), body_block);
+
+  cfg.push_loop(cond_block, after_block);
+  cfg.set_current(body_block);
+  if (stmt) cfg.lower(stmt);
+  cfg.add_edge(cfg.get_current(), cond_block);
+  cfg.pop_loop();
+
+  cfg.set_current(cond_block);
+  cfg.branch(&cond, body_block, after_block);
+
+  cfg.set_current(after_block);
+}
+
+void ForStatement::lower(CFG& cfg) {
+  cfg.lower(init);
+  int cond_block = cfg.new_block();
+  int body_block = cfg.new_block();
+  int step_block = cfg.new_block();
+  int after_block = cfg.new_block();
+  cfg.add_edge(cfg.get_current(), cond_block);
+
+  cfg.set_current(cond_block);
+  if (cond) cfg.branch(&cond, body_block, after_block);
+  else cfg.add_edge(cond_block, body_block);
+
+  cfg.push_loop(step_block, after_block);
+  cfg.set_current(body_block);
+  if (stmt) cfg.lower(stmt);
+  cfg.add_edge(cfg.get_current(), step_block);
+  cfg.pop_loop();
+
+  cfg.set_current(step_block);
+  if (step) cfg.lower(step);
+  cfg.add_edge(cfg.get_current(), cond_block);
+
+  cfg.set_current(after_block);
+}
+
+void SwitchStatement::lower(CFG& cfg) {
+  int after_block = cfg.new_block();
+  cfg.begin_switch(this, after_block);
+  cfg.lower(stmt);
+  cfg.end_switch(after_block);
+}
+
+void CaseStatement::lower(CFG& cfg) {
+  cfg.start_case(this);
+  if (stmt) cfg.lower(stmt);
+}
+
+// to the end of the innermost loop or switch
+void BreakStatement::lower(CFG& cfg) {
+  if (cfg.break_target() < 0) {
+    cfg.unsupported();
+    return;
+  }
+  cfg.add_edge(cfg.get_current(), cfg.break_target());
+  cfg.set_current(cfg.new_block());
+}
+
+void ContinueStatement::lower(CFG& cfg) {
+  if (cfg.continue_target() < 0) {
+    cfg.unsupported();
+    return;
+  }
+  cfg.add_edge(cfg.get_current(), cfg.continue_target());
+  cfg.set_current(cfg.new_block());
+}
+
+}
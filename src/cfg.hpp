@@ -0,0 +1,75 @@
+#ifndef CONTROLFLOWGRAPH
+#define CONTROLFLOWGRAPH
+
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ast.hpp"
+
+using namespace std;
+
+// A straight-line run of statements. A block either ends in a two-way branch
+// on cond (succs[0] when true, succs[1] when false), in the multi-way branch
+// of a switch (succs[i] is the label sw->cases[i], followed by the end of the
+// switch if it has no default) or falls through to its single successor.
+struct CFGBlock {
+    vector<ast::Statement*> stmts;      // expression, declaration and return statements
+    ast::Expression** cond = nullptr;   // slot of the branch condition in its If/While/DoWhile/Switch
+    ast::SwitchStatement* sw = nullptr; // set for the multi-way branch of a switch
+    vector<int> succs;
+    vector<int> preds;
+    bool executable = false;            // filled in by the constant propagation solver
+};
+
+// Control flow graph of one function body. Blocks point back into the AST,
+// so passes that rewrite a block rewrite the function itself. Built by
+// calling lower() on the statements, see cfg.cpp.
+class CFG {
+private:
+    vector<CFGBlock> blocks;
+    unordered_map<ast::Statement*, int> stmt_block;     // block each statement starts in
+    vector<pair<int, int>> targets;                     // continue and break targets, continue is -1 for a switch
+    unordered_map<ast::CaseStatement*, int> case_blocks;
+    int current;
+    int exit;
+    bool supported;
+
+public:
+    static constexpr int ENTRY = 0;
+
+    CFG(ast::Function* func);
+
+    // lowering interface, used by Statement::lower
+    void lower(ast::Statement* stmt);
+    int new_block();
+    int get_current() const { return current; }
+    void set_current(int block) { current = block; }
+    void add_edge(int from, int to);
+    void append(ast::Statement* stmt);
+    void branch(ast::Expression** cond, int if_true, int if_false);
+    void jump_to_exit();
+    void begin_switch(ast::SwitchStatement* sw, int after_block);
+    void end_switch(int after_block);
+    void start_case(ast::CaseStatement* label);
+    void push_loop(int continue_target, int break_target);
+    void pop_loop();
+    int break_target() const;           // -1 outside loops and switches
+    int continue_target() const;        // -1 outside loops
+    void unsupported() { supported = false; }
+
+    // false if the body uses control flow that is not lowered (goto, labels,
+    // case labels nested in other statements)
+    bool is_supported() const { return supported; }
+    int size() const { return blocks.size(); }
+    int get_exit() const { return exit; }
+    CFGBlock& operator[](int block) { return blocks[block]; }
+    const CFGBlock& operator[](int block) const { return blocks[block]; }
+
+    // whether control can reach stmt; only valid once the solver has run
+    bool is_executable(ast::Statement* stmt) const;
+
+    void dump(ostream& os) const;
+};
+
+#endif
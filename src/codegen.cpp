@@ -8,9 +8,38 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
 #include "symtab.hpp"
+#include "compiler.hpp"
 #include <map>
+#include <unordered_map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include "ast.hpp"
+#include "visitor.hpp"
 #include "debug.hpp"
 #include <sstream>
 #include "error.hpp"
@@ -45,6 +74,7 @@ std::string stype2str(SymbolType stype) {
     case U64: return "U64";
     case PTR: return "PTR";
     case FUNC: return "FUNC";
+    case REC: return "REC";
     case UNK: return "UNK";
   }
 }
@@ -53,13 +83,150 @@ using namespace llvm;
 
 namespace ast {
 
-static std::unique_ptr<llvm::LLVMContext> llvm_ctx;
-static std::unique_ptr<llvm::Module> llvm_mod;
-static std::unique_ptr<llvm::IRBuilder<>> llvm_builder;
-static std::map<std::string, AllocaInst*> llvm_st;
-static std::map<std::string, GlobalVariable*> global_st;
-static std::map<std::string, llvm::Function*> func_st;
-static SymbolInfo func_ret_st;
+// state of the unit being compiled on this thread, owned by its
+// CompilerInstance and bound when a TranslationUnit entry point is called
+static thread_local CodegenState* cg;
+
+////////////////////////////////////////////////////////////////////////////////
+// SSA construction
+////////////////////////////////////////////////////////////////////////////////
+
+// In SSA mode, locals and parameters whose address is never taken are kept in
+// SSA values instead of allocas. The latest definition of every variable is
+// tracked per basic block and phis are only placed when a use reaches a join,
+// following Braun et al., "Simple and Efficient Construction of Static Single
+// Assignment Form" (CC 2013). A block is sealed once all its predecessors are
+// known; reads in unsealed blocks get an operandless phi that is completed on
+// sealing.
+
+bool is_ssa_var(int idx) {
+  return cg->ssa_mode && idx >= 0 && cg->ssa_vars.find(idx) != cg->ssa_vars.end();
+}
+
+void write_variable(int idx, BasicBlock* block, Value* val) {
+  cg->current_def[block][idx] = val;
+}
+
+Value* read_variable(int idx, BasicBlock* block);
+
+PHINode* create_phi(int idx, BasicBlock* block) {
+  PHINode* phi = PHINode::Create(cg->ssa_vars[idx], 0, "l" + to_string(idx));
+  block->getInstList().push_front(phi);
+  return phi;
+}
+
+Value* try_remove_trivial_phi(PHINode* phi) {
+  Value* same = nullptr;
+  for (Value* op : phi->incoming_values()) {
+    if (op == same || op == phi) continue;
+    if (same) return phi;           // merges at least two values
+    same = op;
+  }
+  if (!same) same = UndefValue::get(phi->getType());
+
+  std::vector<WeakTrackingVH> users;
+  for (User* u : phi->users()) {
+    if (u != phi && isa<PHINode>(u)) users.push_back(u);
+  }
+  phi->replaceAllUsesWith(same);    // also redirects current_def entries
+  phi->eraseFromParent();
+
+  // phis that used this one may have become trivial; only look at complete
+  // ones, an incomplete phi would wrongly look trivial
+  for (auto& u : users) {
+    PHINode* user = dyn_cast_or_null<PHINode>(u);
+    if (user && cg->sealed_blocks.count(user->getParent()) &&
+        user->getNumIncomingValues() == pred_size(user->getParent())) {
+      try_remove_trivial_phi(user);
+    }
+  }
+  return same;
+}
+
+Value* add_phi_operands(int idx, PHINode* phi) {
+  for (BasicBlock* pred : predecessors(phi->getParent())) {
+    phi->addIncoming(read_variable(idx, pred), pred);
+  }
+  return try_remove_trivial_phi(phi);
+}
+
+Value* read_variable_recursive(int idx, BasicBlock* block) {
+  Value* val;
+  if (!cg->sealed_blocks.count(block)) {
+    PHINode* phi = create_phi(idx, block);
+    cg->incomplete_phis[block].push_back({idx, phi});
+    val = phi;
+  }
+  else if (BasicBlock* pred = block->getSinglePredecessor()) {
+    val = read_variable(idx, pred);
+  }
+  else if (pred_empty(block)) {
+    val = UndefValue::get(cg->ssa_vars[idx]);
+  }
+  else {
+    PHINode* phi = create_phi(idx, block);
+    write_variable(idx, block, phi);      // breaks cycles through loops
+    val = add_phi_operands(idx, phi);
+  }
+  write_variable(idx, block, val);
+  return val;
+}
+
+Value* read_variable(int idx, BasicBlock* block) {
+  auto bdefs = cg->current_def.find(block);
+  if (bdefs != cg->current_def.end()) {
+    auto def = bdefs->second.find(idx);
+    if (def != bdefs->second.end() && def->second) return def->second;
+  }
+  return read_variable_recursive(idx, block);
+}
+
+void seal_block(BasicBlock* block) {
+  if (!cg->ssa_mode) return;
+  auto phis = cg->incomplete_phis.find(block);
+  if (phis != cg->incomplete_phis.end()) {
+    for (auto& entry : phis->second) {
+      add_phi_operands(entry.first, entry.second);
+    }
+    cg->incomplete_phis.erase(phis);
+  }
+  cg->sealed_blocks.insert(block);
+}
+
+void reset_ssa_state() {
+  cg->ssa_vars.clear();
+  cg->address_taken.clear();
+  cg->current_def.clear();
+  cg->incomplete_phis.clear();
+  cg->sealed_blocks.clear();
+}
+
+// stores to an lvalue, or records a new definition for SSA variables
+void assign_value(Expression* lhs, Value* addr, Value* val) {
+  Identifier* ident = dyn_cast<Identifier>(lhs);
+  if (ident && is_ssa_var(ident->ident_info.idx)) {
+    write_variable(ident->ident_info.idx, cg->llvm_builder->GetInsertBlock(), val);
+  }
+  else {
+    cg->llvm_builder->CreateStore(val, addr);
+  }
+}
+
+// a return or an earlier branch may already have closed the current block
+void branch_if_open(BasicBlock* dest) {
+  if (!cg->llvm_builder->GetInsertBlock()->getTerminator()) {
+    cg->llvm_builder->CreateBr(dest);
+  }
+}
+
+// continues after a return or break in a block without predecessors; such
+// code is only reachable through a case label
+void start_unreachable_block() {
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  BasicBlock *deadb = BasicBlock::Create(*cg->llvm_ctx, "unreachable", func);
+  seal_block(deadb);
+  cg->llvm_builder->SetInsertPoint(deadb);
+}
 
 bool is_signed_int_type(SymbolType ty) {
   return ty == I8 || ty == I16 || ty == I32 || ty == I64;
@@ -84,118 +251,108 @@ bool is_fp_type(SymbolType ty) {
 Value* handleAdd(Value* L, Value* R, SymbolType ty){
   if (is_int_type(ty)) {
     // cout << "INT TYPE" << endl;
-    return llvm_builder->CreateAdd(L, R, "temp");
+    return cg->llvm_builder->CreateAdd(L, R, "temp");
   }
-  else if (is_fp_type(ty)) return llvm_builder->CreateFAdd(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFAdd(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleSub(Value* L, Value* R, SymbolType ty){
-  if (is_int_type(ty)) return llvm_builder->CreateSub(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFSub(L, R, "temp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateSub(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFSub(L, R, "temp");
   else return nullptr;
 }
 
 
 Value* handleMul(Value* L, Value* R, SymbolType ty) {
-  if (is_int_type(ty)) return llvm_builder->CreateMul(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFMul(L, R, "temp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateMul(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFMul(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleDiv(Value* L, Value* R, SymbolType ty) {
-  if (is_signed_int_type(ty)) return llvm_builder->CreateSDiv(L, R, "temp");
-  else if (is_unsigned_int_type(ty)) return llvm_builder->CreateUDiv(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFDiv(L, R, "temp");
+  if (is_signed_int_type(ty)) return cg->llvm_builder->CreateSDiv(L, R, "temp");
+  else if (is_unsigned_int_type(ty)) return cg->llvm_builder->CreateUDiv(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFDiv(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleModulo(Value* L, Value* R, SymbolType ty) {
-  if (is_signed_int_type(ty)) return llvm_builder->CreateSRem(L, R, "temp");
-  else if (is_unsigned_int_type(ty)) return llvm_builder->CreateURem(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFRem(L, R, "temp");
+  if (is_signed_int_type(ty)) return cg->llvm_builder->CreateSRem(L, R, "temp");
+  else if (is_unsigned_int_type(ty)) return cg->llvm_builder->CreateURem(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFRem(L, R, "temp");
   else return nullptr;
 }
 
 
 Value* handleGE(Value* L, Value* R, SymbolType ty) {
-  if (is_signed_int_type(ty)) return llvm_builder->CreateICmpSGE(L, R, "temp");
-  else if (is_unsigned_int_type(ty)) return llvm_builder->CreateICmpUGE(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFCmpOGE(L, R, "temp");
+  if (is_signed_int_type(ty)) return cg->llvm_builder->CreateICmpSGE(L, R, "temp");
+  else if (is_unsigned_int_type(ty)) return cg->llvm_builder->CreateICmpUGE(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFCmpOGE(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleGT(Value* L, Value* R, SymbolType ty) {
-  if (is_signed_int_type(ty)) return llvm_builder->CreateICmpSGT(L, R, "temp");
-  else if (is_unsigned_int_type(ty)) return llvm_builder->CreateICmpUGT(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFCmpOGT(L, R, "temp");
+  if (is_signed_int_type(ty)) return cg->llvm_builder->CreateICmpSGT(L, R, "temp");
+  else if (is_unsigned_int_type(ty)) return cg->llvm_builder->CreateICmpUGT(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFCmpOGT(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleLE(Value* L, Value* R, SymbolType ty) {
-  if (is_signed_int_type(ty)) return llvm_builder->CreateICmpSLE(L, R, "temp");
-  else if (is_unsigned_int_type(ty)) return llvm_builder->CreateICmpULE(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFCmpOLE(L, R, "temp");
+  if (is_signed_int_type(ty)) return cg->llvm_builder->CreateICmpSLE(L, R, "temp");
+  else if (is_unsigned_int_type(ty)) return cg->llvm_builder->CreateICmpULE(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFCmpOLE(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleLT(Value* L, Value* R, SymbolType ty) {
-  if (is_signed_int_type(ty)) return llvm_builder->CreateICmpSLT(L, R, "temp");
-  else if (is_unsigned_int_type(ty)) return llvm_builder->CreateICmpULT(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFCmpOLT(L, R, "temp");
+  if (is_signed_int_type(ty)) return cg->llvm_builder->CreateICmpSLT(L, R, "temp");
+  else if (is_unsigned_int_type(ty)) return cg->llvm_builder->CreateICmpULT(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFCmpOLT(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleEQ(Value* L, Value* R, SymbolType ty) {
-  if (is_int_type(ty)) return llvm_builder->CreateICmpEQ(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFCmpOEQ(L, R, "temp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateICmpEQ(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFCmpOEQ(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleNE(Value* L, Value* R, SymbolType ty) {
-  if (is_int_type(ty)) return llvm_builder->CreateICmpNE(L, R, "temp");
-  else if (is_fp_type(ty)) return llvm_builder->CreateFCmpONE(L, R, "temp");
-  else return nullptr;
-}
-
-Value* handleBAnd(Value* L, Value* R, SymbolType ty) {
-  if (is_bool_type(ty)) return llvm_builder->CreateAnd(L, R, "temp");
-  else return nullptr;
-}
-
-Value* handleBOr(Value* L, Value* R, SymbolType ty) {
-  if (is_bool_type(ty)) return llvm_builder->CreateOr(L, R, "temp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateICmpNE(L, R, "temp");
+  else if (is_fp_type(ty)) return cg->llvm_builder->CreateFCmpONE(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleBNot(Value* L, SymbolType ty){
-  if (is_bool_type(ty)) return llvm_builder->CreateNot(L);
+  if (is_bool_type(ty)) return cg->llvm_builder->CreateNot(L);
   else return nullptr;
 }
 
 Value* handleAnd(Value* L, Value* R, SymbolType ty) {
-  if (is_int_type(ty)) return llvm_builder->CreateAnd(L, R, "temp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateAnd(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleOr(Value* L, Value* R, SymbolType ty) {
-  if (is_int_type(ty)) return llvm_builder->CreateOr(L, R, "temp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateOr(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleXor(Value* L, Value* R, SymbolType ty) {
-  if (is_int_type(ty)) return llvm_builder->CreateXor(L, R, "temp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateXor(L, R, "temp");
   else return nullptr;
 }
 
 Value* handleLshift(Value* L, Value* R, SymbolType ty){
-  if (is_int_type(ty)) return llvm_builder->CreateShl(L, R, "lshifttemp");
+  if (is_int_type(ty)) return cg->llvm_builder->CreateShl(L, R, "lshifttemp");
   else return nullptr;
 }
 
 Value* handleRshift(Value* L, Value* R, SymbolType ty) {
-  if (is_signed_int_type(ty)) return llvm_builder->CreateAShr(L, R, "srshifttemp");
-  else if (is_unsigned_int_type(ty)) return llvm_builder->CreateLShr(L, R, "urshifttemp");
+  if (is_signed_int_type(ty)) return cg->llvm_builder->CreateAShr(L, R, "srshifttemp");
+  else if (is_unsigned_int_type(ty)) return cg->llvm_builder->CreateLShr(L, R, "urshifttemp");
   else return nullptr;
 }
 
@@ -224,21 +381,58 @@ std::string getVarName(ast::Identifier *ident, std::string prefix){
   return prefix + to_string(abs(idx));
 }
 
-llvm::Type* getType(SymbolType ts, int ptr_depth){
+llvm::Type* getType(SymbolType ts, int ptr_depth, int record = -1);
+llvm::Type* getObjectType(const SymbolInfo& info);
+
+// Named struct type of a record, created on first use. The type is cached
+// before its body is set so that a field pointing back at the record finds
+// it. A union is its most aligned field padded out to the union's size.
+llvm::StructType* getRecordType(int record) {
+  auto it = cg->record_types.find(record);
+  if (it != cg->record_types.end()) return it->second;
+
+  const RecordLayout& layout = (*cg->records)[record];
+  string name = string(layout.is_union ? "union." : "struct.") + (layout.tag ? *layout.tag : "anon");
+  llvm::StructType* t = llvm::StructType::create(*cg->llvm_ctx, name);
+  cg->record_types[record] = t;
+  if (!layout.complete) return t;          // opaque, only used behind pointers
+
+  vector<Type*> body;
+  if (layout.is_union) {
+    const RecordField* widest = nullptr;
+    for (auto& field : layout.fields) {
+      if (!widest || cg->records->align_of(field.type) > cg->records->align_of(widest->type)) widest = &field;
+    }
+    long size = 0;
+    if (widest) {
+      body.push_back(getObjectType(widest->type));
+      size = cg->records->size_of(widest->type);
+    }
+    if (size < layout.size) body.push_back(ArrayType::get(Type::getInt8Ty(*cg->llvm_ctx), layout.size - size));
+  }
+  else {
+    for (auto& field : layout.fields) body.push_back(getObjectType(field.type));
+  }
+  t->setBody(body);
+  return t;
+}
+
+llvm::Type* getType(SymbolType ts, int ptr_depth, int record){
   llvm::Type* t;
   switch (ts) {
-    case FP32: t = Type::getFloatTy(*llvm_ctx); break;
-    case FP64: t = Type::getDoubleTy(*llvm_ctx); break;
-    case I1:   t = Type::getInt1Ty(*llvm_ctx); break;
+    case FP32: t = Type::getFloatTy(*cg->llvm_ctx); break;
+    case FP64: t = Type::getDoubleTy(*cg->llvm_ctx); break;
+    case I1:   t = Type::getInt1Ty(*cg->llvm_ctx); break;
     case I8:   
-    case U8:   t = Type::getInt8Ty(*llvm_ctx); break;
+    case U8:   t = Type::getInt8Ty(*cg->llvm_ctx); break;
     case I16:  
-    case U16:  t = Type::getInt16Ty(*llvm_ctx); break;
+    case U16:  t = Type::getInt16Ty(*cg->llvm_ctx); break;
     case I32:  
-    case U32:  t = Type::getInt32Ty(*llvm_ctx); break;
+    case U32:  t = Type::getInt32Ty(*cg->llvm_ctx); break;
     case I64:  
-    case U64:  t = Type::getInt64Ty(*llvm_ctx); break;
-    case VD: t = Type::getVoidTy(*llvm_ctx); break;
+    case U64:  t = Type::getInt64Ty(*cg->llvm_ctx); break;
+    case VD: t = Type::getVoidTy(*cg->llvm_ctx); break;
+    case REC: t = getRecordType(record); break;
     default: break;
   }
 
@@ -263,85 +457,85 @@ int get_rank(SymbolType st) {
 
 
 Value* widenToFloat(Value* v, SymbolType st, llvm::Type* ty){
-  if (st == I1) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I8) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U8) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I32) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U16) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I16) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U32) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I64) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U64) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == FP32) return llvm_builder->CreateFPExt(v, ty, "widen");
-  if (st == FP64) return llvm_builder->CreateFPExt(v, ty, "widen");
+  if (st == I1) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I8) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U8) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I32) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U16) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I16) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U32) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I64) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U64) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == FP32) return cg->llvm_builder->CreateFPExt(v, ty, "widen");
+  if (st == FP64) return cg->llvm_builder->CreateFPExt(v, ty, "widen");
 }
 
 Value* widenToSInt(Value* v, SymbolType st, llvm::Type* ty){
-  if (st == I1)  return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == I8) return llvm_builder->CreateSExt(v, ty, "widen");
-  if (st == U8) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == U16) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == I16) return llvm_builder->CreateSExt(v, ty, "widen");
-  if (st == I32) return llvm_builder->CreateSExt(v, ty, "widen");
-  if (st == U32) return llvm_builder->CreateZExt(v, ty, "widen");
-  // if (st == I64) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  // if (st == U64) return llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I1)  return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == I8) return cg->llvm_builder->CreateSExt(v, ty, "widen");
+  if (st == U8) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == U16) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == I16) return cg->llvm_builder->CreateSExt(v, ty, "widen");
+  if (st == I32) return cg->llvm_builder->CreateSExt(v, ty, "widen");
+  if (st == U32) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  // if (st == I64) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  // if (st == U64) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
 }
 
 
 
 Value* widenToUInt(Value* v, SymbolType st, llvm::Type* ty){
-  if (st == I1) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == I8) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == U8) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == U16) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == I16) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == I32) return llvm_builder->CreateZExt(v, ty, "widen");
-  if (st == U32) return llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == I1) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == I8) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == U8) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == U16) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == I16) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == I32) return cg->llvm_builder->CreateZExt(v, ty, "widen");
+  if (st == U32) return cg->llvm_builder->CreateZExt(v, ty, "widen");
 }
 
 
 Value* widenOrNarrowToUInt(Value* v, SymbolType st, llvm::Type* ty){
-  if (st == I1) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == I8) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == U8) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == U16) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == I16) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == I32) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == U32) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == I64) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == U64) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == FP32) return llvm_builder->CreateFPToUI(v, ty, "fptoint");
-  if (st == FP64) return llvm_builder->CreateFPToUI(v, ty, "fptoint");
+  if (st == I1) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == I8) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == U8) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == U16) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == I16) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == I32) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == U32) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == I64) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == U64) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == FP32) return cg->llvm_builder->CreateFPToUI(v, ty, "fptoint");
+  if (st == FP64) return cg->llvm_builder->CreateFPToUI(v, ty, "fptoint");
 }
 
 Value* widenOrNarrowToSInt(Value* v, SymbolType st, llvm::Type* ty){
-  if (st == I1) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == I8) return llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
-  if (st == U8) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == U16) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == I16) return llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
-  if (st == I32) return llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
-  if (st == U32) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == I64) return llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
-  if (st == U64) return llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
-  if (st == FP32) return llvm_builder->CreateFPToSI(v, ty, "widen");
-  if (st == FP64) return llvm_builder->CreateFPToSI(v, ty, "widen");
+  if (st == I1) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == I8) return cg->llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
+  if (st == U8) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == U16) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == I16) return cg->llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
+  if (st == I32) return cg->llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
+  if (st == U32) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == I64) return cg->llvm_builder->CreateSExtOrTrunc(v, ty, "widen");
+  if (st == U64) return cg->llvm_builder->CreateZExtOrTrunc(v, ty, "widen");
+  if (st == FP32) return cg->llvm_builder->CreateFPToSI(v, ty, "widen");
+  if (st == FP64) return cg->llvm_builder->CreateFPToSI(v, ty, "widen");
 }
 
 
 Value* widenOrNarrowToFloat(Value* v, SymbolType st, llvm::Type* ty){
-  if (st == I1) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I8) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U8) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I16) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U16) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I32) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U32) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == I64) return llvm_builder->CreateSIToFP(v, ty, "widen");
-  if (st == U64) return llvm_builder->CreateUIToFP(v, ty, "widen");
-  if (st == FP32) return llvm_builder->CreateFPExt(v, ty, "widen");
-  if (st == FP64) return llvm_builder->CreateFPTrunc(v, ty, "widen");
+  if (st == I1) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I8) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U8) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I16) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U16) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I32) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U32) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == I64) return cg->llvm_builder->CreateSIToFP(v, ty, "widen");
+  if (st == U64) return cg->llvm_builder->CreateUIToFP(v, ty, "widen");
+  if (st == FP32) return cg->llvm_builder->CreateFPExt(v, ty, "widen");
+  if (st == FP64) return cg->llvm_builder->CreateFPTrunc(v, ty, "widen");
 }
 
 // widen if not an assignment
@@ -350,10 +544,10 @@ void widen_expression(Expression* lhsexp, Expression* rhsexp, Value* lhsval, Val
   if (get_rank(rhsexp->type_info.st.stype) > get_rank(lhsexp->type_info.st.stype)) {
     switch (rhsexp->type_info.st.stype) {
       case FP64:  
-        *newlhs = widenToFloat(lhsval, lhsexp->type_info.st.stype, Type::getDoubleTy(*llvm_ctx));
+        *newlhs = widenToFloat(lhsval, lhsexp->type_info.st.stype, Type::getDoubleTy(*cg->llvm_ctx));
         break;
       case FP32:
-        *newlhs = widenToFloat(lhsval, lhsexp->type_info.st.stype, Type::getFloatTy(*llvm_ctx));
+        *newlhs = widenToFloat(lhsval, lhsexp->type_info.st.stype, Type::getFloatTy(*cg->llvm_ctx));
         break;
       default:
         if(is_signed_int_type(rhsexp->type_info.st.stype)){
@@ -369,10 +563,10 @@ void widen_expression(Expression* lhsexp, Expression* rhsexp, Value* lhsval, Val
   else if (get_rank(lhsexp->type_info.st.stype) > get_rank(rhsexp->type_info.st.stype)) {
     switch (lhsexp->type_info.st.stype) {
       case FP64:  
-        *newrhs = widenToFloat(rhsval, rhsexp->type_info.st.stype, Type::getDoubleTy(*llvm_ctx));
+        *newrhs = widenToFloat(rhsval, rhsexp->type_info.st.stype, Type::getDoubleTy(*cg->llvm_ctx));
         break;
       case FP32:
-        *newrhs = widenToFloat(rhsval, rhsexp->type_info.st.stype, Type::getFloatTy(*llvm_ctx));
+        *newrhs = widenToFloat(rhsval, rhsexp->type_info.st.stype, Type::getFloatTy(*cg->llvm_ctx));
         break;
       default:
         if(is_signed_int_type(lhsexp->type_info.st.stype)){
@@ -391,27 +585,35 @@ void widen_expression(Expression* lhsexp, Expression* rhsexp, Value* lhsval, Val
 
 Value* narrowToBool(Value* rhsval, SymbolType& st, llvm::Type* ty){
   if (st == I1)   { st = I1; return rhsval; }
-  if (st == I8)   { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == U8)   { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == I16)  { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == U16)  { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == I32)  { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == U32)  { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == I64)  { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == U64)  { st = I1; return llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
-  if (st == FP32) { st = I1; return llvm_builder->CreateFCmpONE(rhsval, ConstantFP::get(ty, 0.0)); }
-  if (st == FP64) { st = I1; return llvm_builder->CreateFCmpONE(rhsval, ConstantFP::get(ty, 0.0)); }
-  // if (st == FP64) return llvm_builder->CreateFPTrunc(v, ty, "widen");
+  if (st == I8)   { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == U8)   { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == I16)  { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == U16)  { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == I32)  { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == U32)  { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == I64)  { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == U64)  { st = I1; return cg->llvm_builder->CreateICmpNE(rhsval, ConstantInt::get(ty, 0)); }
+  if (st == FP32) { st = I1; return cg->llvm_builder->CreateFCmpONE(rhsval, ConstantFP::get(ty, 0.0)); }
+  if (st == FP64) { st = I1; return cg->llvm_builder->CreateFCmpONE(rhsval, ConstantFP::get(ty, 0.0)); }
+  // if (st == FP64) return cg->llvm_builder->CreateFPTrunc(v, ty, "widen");
+}
+
+// truth value of exp as a condition; pointers are compared against null
+Value* conditionToBool(Expression* exp, Value* val) {
+  if (exp->type_info.st.ptr_depth != 0) {
+    return cg->llvm_builder->CreateIsNotNull(val, "temp");
+  }
+  return narrowToBool(val, exp->type_info.st.stype, getType(exp->type_info.st.stype, 0));
 }
 
 Value* convertForAssignment(Expression* lhsexp, Expression* rhsexp, Value* rhsval) {
   Value* newrhs;
   switch (lhsexp->type_info.st.stype) {
       case FP64:  
-        newrhs =  widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getDoubleTy(*llvm_ctx));
+        newrhs =  widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getDoubleTy(*cg->llvm_ctx));
         break;
       case FP32:
-        newrhs = widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getFloatTy(*llvm_ctx));
+        newrhs = widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getFloatTy(*cg->llvm_ctx));
         break;
       default:
         if(is_signed_int_type(lhsexp->type_info.st.stype)){
@@ -431,10 +633,10 @@ Value* convertForInit(SymbolType lhstype, Expression* rhsexp, Value* rhsval) {
   Value* newrhs;
   switch (lhstype) {
       case FP64:  
-        newrhs =  widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getDoubleTy(*llvm_ctx));
+        newrhs =  widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getDoubleTy(*cg->llvm_ctx));
         break;
       case FP32:
-        newrhs = widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getFloatTy(*llvm_ctx));
+        newrhs = widenOrNarrowToFloat(rhsval, rhsexp->type_info.st.stype, Type::getFloatTy(*cg->llvm_ctx));
         break;
       default:
         if(is_signed_int_type(lhstype)){
@@ -451,27 +653,6 @@ Value* convertForInit(SymbolType lhstype, Expression* rhsexp, Value* rhsval) {
   return newrhs;
 }
 
-
-
-Constant* getDefaultInitializer(SymbolType ts, int ptr_depth){
-  llvm::Type* t;
-  if (ptr_depth > 0) return ConstantPointerNull::get(PointerType::get(*llvm_ctx, 0));
-  switch (ts) {
-    case FP32: return ConstantFP::get(llvm::Type::getFloatTy(*llvm_ctx), APFloat(0.0));
-    case FP64: return ConstantFP::get(llvm::Type::getDoubleTy(*llvm_ctx), APFloat(0.0));
-    case I1:   return ConstantInt::get(*llvm_ctx, APInt(1, 0));
-    case I8:   
-    case U8:   return ConstantInt::get(*llvm_ctx, APInt(8, 0));
-    case I16:  
-    case U16:  return ConstantInt::get(*llvm_ctx, APInt(16, 0));
-    case I32:  
-    case U32:  return ConstantInt::get(*llvm_ctx, APInt(32, 0));
-    case I64:  
-    case U64:  return ConstantInt::get(*llvm_ctx, APInt(64, 0));
-    default: return nullptr;
-  }
-}
-
 int getTypeSize(SymbolType ts, int ptr_depth) {
   if (ptr_depth > 0) return 8;
   switch (ts) {
@@ -490,9 +671,64 @@ int getTypeSize(SymbolType ts, int ptr_depth) {
 }
 
 
-AllocaInst *CreateEntryBlockAlloca(llvm::Function *func, DeclarationSpecifiers* decl_specs, int ptr_depth, Identifier* ident) {
+// type of the storage of a variable; arrays are llvm arrays of their elements
+llvm::Type* getObjectType(const SymbolInfo& info) {
+  llvm::Type* t = getType(info.stype, info.ptr_depth, info.record);
+  if (info.array_size) return ArrayType::get(t, info.array_size);
+  return t;
+}
+
+// arrays of 16 bytes or more get 16 byte alignment like the x86-64 ABI asks
+// for, so vectorized loops over them can use aligned accesses
+int getObjectAlign(const SymbolInfo& info) {
+  if (info.array_size && cg->records->size_of(info) >= 16) return 16;
+  return cg->records->align_of(info);
+}
+
+// zero, the value of a global or static local without an initializer
+Constant* getObjectZero(const SymbolInfo& info) {
+  Type* t = getObjectType(info);
+  if (info.array_size || (info.stype == REC && !info.ptr_depth)) return ConstantAggregateZero::get(t);
+  return Constant::getNullValue(t);
+}
+
+// struct values only convert to the same struct
+static bool mismatched_records(const SymbolInfo& a, const SymbolInfo& b) {
+  if (a.stype != REC && b.stype != REC) return false;
+  if (a.ptr_depth || b.ptr_depth) return false;       // pointers are checked by depth
+  return a.stype != b.stype || a.record != b.record;
+}
+
+AllocaInst *CreateEntryBlockAlloca(llvm::Function *func, Identifier* ident) {
   llvm::IRBuilder<> TmpB(&func->getEntryBlock(), func->getEntryBlock().begin());
-  return TmpB.CreateAlloca(getType(typespecs2stg(decl_specs->type_specs), ptr_depth), nullptr, getVarName(ident, "l"));
+  const SymbolInfo& info = ident->ident_info;
+  AllocaInst* A = TmpB.CreateAlloca(getObjectType(info), nullptr, getVarName(ident, "l"));
+  if (info.array_size || info.stype == REC) A->setAlignment(Align(getObjectAlign(info)));
+  return A;
+}
+
+// A static local is a global private to the module, named after its
+// function as clang does. Its initializer runs once, before the program
+// starts, so it has to be a literal.
+GlobalVariable* CreateStaticLocal(llvm::Function *func, DeclarationSpecifiers* decl_specs, InitDeclarator* init_decl) {
+  const SymbolInfo& info = init_decl->ident->ident_info;
+  SymbolType st = info.stype;
+  Type* t = getObjectType(info);
+  Constant* init = getObjectZero(info);
+  if (init_decl->init_expr) {
+    Literal* l = dyn_cast<Literal>(init_decl->init_expr);
+    if (l && l->ltype != LT_STRING && !init_decl->ptr_depth && st != REC) {
+      assign_literals(st, l);
+      init = l->codegen();
+    }
+    else {
+      ehdl::report(ehdl::E_STATIC_INIT_NOT_CONSTANT, init_decl->pos, {*init_decl->ident->name});
+    }
+  }
+  GlobalVariable* A = new GlobalVariable(*cg->llvm_mod, t, false, GlobalValue::InternalLinkage, init,
+                                         func->getName() + "." + *init_decl->ident->name);
+  A->setAlignment(MaybeAlign(getObjectAlign(info)));
+  return A;
 }
 
 llvm::Value* DeclarationStatement::codegen(){
@@ -501,28 +737,41 @@ llvm::Value* DeclarationStatement::codegen(){
 
 llvm::Value* Declaration::codegen(){
 
-  llvm::Function *func = llvm_builder->GetInsertBlock()->getParent();
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
   for(auto init_decl: *decl_list){
-    AllocaInst* A = CreateEntryBlockAlloca(func, decl_specs, init_decl->ptr_depth, init_decl->ident);
+    int idx = init_decl->ident->ident_info.idx;
+    AllocaInst* A = nullptr;
+    if (decl_specs->storage_specs.count(SS_STATIC)) {
+      cg->llvm_st[idx] = CreateStaticLocal(func, decl_specs, init_decl);
+      continue;
+    }
+    const SymbolInfo& info = init_decl->ident->ident_info;
+    if (cg->ssa_mode && !cg->address_taken.count(idx) && !info.array_size && info.stype != REC) {
+      // not address taken: no memory needed, an uninitialized read yields undef
+      cg->ssa_vars[idx] = getType(info.stype, info.ptr_depth, info.record);
+    }
+    else {
+      A = CreateEntryBlockAlloca(func, init_decl->ident);
+      cg->llvm_st[idx] = A;
+    }
     if(init_decl->init_expr){
       // cout << "START DECL\n";
       Value* init_val = init_decl->init_expr->codegen();
+      if (!init_val) continue;
+      if (mismatched_records(info, init_decl->init_expr->type_info.st)) {
+        ehdl::report(ehdl::E_INIT_INCOMPATIBLE, init_decl->pos, {*init_decl->ident->name});
+        continue;
+      }
       // cout << "EXPR GEN\n";
       if (get_rank(init_decl->init_expr->type_info.st.stype) != get_rank(init_decl->ident->ident_info.stype) 
           && !(init_decl->init_expr->type_info.st.ptr_depth) && !(init_decl->ptr_depth)){
           // cout << "IF" << endl;
 
-          Value* newval = convertForInit(init_decl->ident->ident_info.stype, init_decl->init_expr, init_val);
-          llvm_builder->CreateStore(newval, A);
-      }
-      else{
-        // cout << "ELSE" << endl;
-        llvm_builder->CreateStore(init_val, A);
+          init_val = convertForInit(init_decl->ident->ident_info.stype, init_decl->init_expr, init_val);
       }
+      assign_value(init_decl->ident, A, init_val);
     }
     // cout << "CONVERTED\n";
-    llvm_st[getVarName(init_decl->ident, "l") ] = A;
-    // cout << "DONE DECL" << endl;
   }
 
   return nullptr;
@@ -537,45 +786,293 @@ llvm::Value* Declaration::globalgen(){
   // cout<<"HI"<<endl;
   GlobalVariable* A;
   for(auto init_decl: *decl_list){
-    Type* t = getType(typespecs2stg(decl_specs->type_specs), init_decl->ptr_depth);
-    int tsize = getTypeSize(typespecs2stg(decl_specs->type_specs), init_decl->ptr_depth);
-    A = new llvm::GlobalVariable(*llvm_mod, t, false, llvm::GlobalValue::ExternalLinkage, 0, init_decl->ident->name);
-
-    if(init_decl->init_expr) {
+    const SymbolInfo& info = init_decl->ident->ident_info;
+    Type* t = getObjectType(info);
+    int tsize = getObjectAlign(info);
+    A = new llvm::GlobalVariable(*cg->llvm_mod, t, false, llvm::GlobalValue::ExternalLinkage, 0, *init_decl->ident->name);
+
+    if (info.array_size || info.stype == REC) {
+      if (init_decl->init_expr) ehdl::report(ehdl::E_INIT_LIST_UNSUPPORTED, init_decl->pos, {*init_decl->ident->name});
+      A->setInitializer(getObjectZero(info));
+    }
+    else if(init_decl->init_expr) {
       Literal *l;
-      if (!(l = dynamic_cast<Literal*>(init_decl->init_expr))) {
+      if (!(l = dyn_cast<Literal>(init_decl->init_expr))) {
         cout << "ERROR: globals can only take constant values" << endl;
         return nullptr;
       }
+      // converted to the variable's type, as for static locals
+      if (l->ltype != LT_STRING && !init_decl->ptr_depth) {
+        assign_literals(info.stype, l);
+      }
       Constant* init_val = l->codegen();
       A->setInitializer(init_val);
     }
     else {
-      Constant* init = getDefaultInitializer(typespecs2stg(decl_specs->type_specs), init_decl->ptr_depth);
-      if (init) A->setInitializer(init);
-      else ehdl::err("Could not initialize global value to default value", pos);
+      A->setInitializer(getObjectZero(info));
     }
     A->setAlignment(MaybeAlign(tsize));
-    global_st[init_decl->ident->name ] = A;
+    cg->global_st[init_decl->ident->name ] = A;
   }
 
   return A;
 }
 
-std::string TranslationUnit::codegen() {
-  llvm_ctx = std::make_unique<llvm::LLVMContext>();
-  llvm_mod = std::make_unique<llvm::Module>("Code Generator", *llvm_ctx);
+void DeclarationStatement::globaldecl(){
+  decl->globaldecl();
+}
+
+// Shards only need to refer to globals, the main module defines them. Unlike
+// globalgen this leaves the AST untouched, so shards can run concurrently.
+void Declaration::globaldecl(){
+  for(auto init_decl: *decl_list){
+    Type* t = getObjectType(init_decl->ident->ident_info);
+    GlobalVariable* A = new llvm::GlobalVariable(*cg->llvm_mod, t, false, llvm::GlobalValue::ExternalLinkage, nullptr, *init_decl->ident->name);
+    cg->global_st[init_decl->ident->name] = A;
+  }
+}
+
+// Reports the first problem the IR verifier finds in mod. Codegen does not
+// catch every type error, and neither the pass pipeline nor the backends
+// expect invalid IR.
+bool verify_module(const Module& mod) {
+  std::string err;
+  raw_string_ostream os(err);
+  if (!verifyModule(mod, &os)) return true;
+  os.flush();
+  ehdl::report(ehdl::E_INVALID_IR, ehdl::NO_POS, {err.substr(0, err.find('\n'))});
+  return false;
+}
+
+// Runs the new pass manager over llvm_mod in-process: either one of the
+// PassBuilder default pipelines or a textual pipeline given with --passes.
+bool optimize_module(const CodegenOptions& opts) {
+  if (opts.opt_level == 0 && opts.passes.empty()) return true;
+
+  LoopAnalysisManager lam;
+  FunctionAnalysisManager fam;
+  CGSCCAnalysisManager cgam;
+  ModuleAnalysisManager mam;
+
+  PassBuilder pb(cg->llvm_tm.get());       // target cost model, without it nothing is vectorized
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  ModulePassManager mpm;
+  if (!opts.passes.empty()) {
+    if (auto err = pb.parsePassPipeline(mpm, opts.passes)) {
+      ehdl::report(ehdl::E_INVALID_PIPELINE, ehdl::NO_POS, {toString(std::move(err))});
+      return false;
+    }
+  }
+  else {
+    static const OptimizationLevel levels[] = {
+      OptimizationLevel::O0, OptimizationLevel::O1, OptimizationLevel::O2, OptimizationLevel::O3
+    };
+    mpm = pb.buildPerModuleDefaultPipeline(levels[opts.opt_level]);
+  }
+  cdebug << "running pass pipeline" << endl;
+  mpm.run(*cg->llvm_mod, mam);
+  return true;
+}
+
+// the target registry is process wide, units on other threads share it
+void init_targets() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    InitializeAllTargetInfos();
+    InitializeAllTargets();
+    InitializeAllTargetMCs();
+    InitializeAllAsmPrinters();
+  });
+}
+
+// The target machine is created up front so that the optimizer sees the real
+// data layout. -mcpu=native picks up the host cpu and its features (SSE/AVX..).
+std::unique_ptr<TargetMachine> create_target_machine(const CodegenOptions& opts) {
+  init_targets();
+
+  Triple triple(sys::getDefaultTargetTriple());
+  std::string err;
+  const Target* target = TargetRegistry::lookupTarget(opts.march, triple, err);
+  if (!target) {
+    ehdl::report(ehdl::E_INVALID_TARGET, ehdl::NO_POS, {opts.march});
+    return nullptr;
+  }
+
+  std::string cpu = opts.mcpu.empty() ? "generic" : opts.mcpu;
+  std::string features;
+  if (cpu == "native") {
+    cpu = sys::getHostCPUName().str();
+    StringMap<bool> host_features;
+    if (sys::getHostCPUFeatures(host_features)) {
+      SubtargetFeatures f;
+      for (auto& feature : host_features) f.AddFeature(feature.first(), feature.second);
+      features = f.getString();
+    }
+  }
+
+  static const CodeGenOpt::Level levels[] = {
+    CodeGenOpt::None, CodeGenOpt::Less, CodeGenOpt::Default, CodeGenOpt::Aggressive
+  };
+  TargetOptions topts;
+  return std::unique_ptr<TargetMachine>(target->createTargetMachine(
+      triple.str(), cpu, features, topts, Reloc::PIC_, None, levels[opts.opt_level]));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Parallel codegen
+////////////////////////////////////////////////////////////////////////////////
+
+// Function bodies are split into at most MAX_SHARDS contiguous shards. The
+// split depends only on the number of functions, never on the number of
+// threads, and shards are linked back in order, so the output is the same for
+// any -codegen-threads. Each worker has its own LLVMContext. A shard module
+// holds its bodies plus declarations of all globals and earlier functions,
+// and travels to the main context as bitcode.
+
+static const size_t MAX_SHARDS = 64;
+
+struct CodegenShard {
+  size_t begin, end;                      // [begin, end) into the bodies
+  SmallVector<char, 0> bitcode;           // empty if the shard has errors
+  ehdl::DiagnosticSink diags;
+};
+
+void codegen_worker(vector<Node*>& nodes, vector<CodegenShard>& shards, std::atomic<size_t>& next,
+                    const CodegenOptions& opts, const Module& main_mod,
+                    const RecordTable& records, bool trace) {
+  if (trace) timeTraceProfilerInitialize(0, "cc");
+  CodegenState state;
+  state.records = &records;
+  state.ssa_mode = opts.ssa;
+  state.jump_tables = (opts.opt_level == 0);
+  state.llvm_ctx = std::make_unique<llvm::LLVMContext>();
+  state.llvm_builder = std::make_unique<llvm::IRBuilder<>>(*state.llvm_ctx);
+  cg = &state;
+
+  size_t i;
+  while ((i = next++) < shards.size()) {
+    CodegenShard& shard = shards[i];
+    ehdl::DiagnosticSink::set_active(&shard.diags);
+    state.llvm_mod = std::make_unique<llvm::Module>("Code Generator", *state.llvm_ctx);
+    state.llvm_mod->setTargetTriple(main_mod.getTargetTriple());
+    state.llvm_mod->setDataLayout(main_mod.getDataLayout());
+    state.global_st.clear();
+    state.func_st.clear();
+
+    size_t body = 0;
+    for (auto node_ptr : nodes) {
+      if (auto decl_ptr = dyn_cast<DeclarationStatement>(node_ptr)) {
+        decl_ptr->globaldecl();
+      }
+      else if (auto func_ptr = dyn_cast<Function>(node_ptr)) {
+        if (!func_ptr->stmts) {
+          func_ptr->prototype();
+          continue;
+        }
+        if (body >= shard.end) break;
+        if (body >= shard.begin) func_ptr->codegen();
+        else func_ptr->prototype();
+        body++;
+      }
+    }
+
+    if (shard.diags.n_errs() > 0 || !verify_module(*state.llvm_mod)) continue;
+    raw_svector_ostream os(shard.bitcode);
+    WriteBitcodeToFile(*state.llvm_mod, os);
+  }
+  ehdl::DiagnosticSink::set_active(nullptr);
+  state.llvm_mod.reset();
+  cg = nullptr;
+  if (trace) timeTraceProfilerFinishThread();
+}
+
+// Generates all function bodies on opts.codegen_threads threads and links
+// them into the main module, which already holds globals and prototypes.
+bool parallel_codegen(vector<Node*>& nodes, const CodegenOptions& opts) {
+  if (opts.codegen_threads <= 1) return true;
+
+  size_t n_bodies = 0;
+  for (auto node_ptr : nodes) {
+    Function* func_ptr = dyn_cast<Function>(node_ptr);
+    if (func_ptr && func_ptr->stmts) n_bodies++;
+  }
+  if (n_bodies == 0) return true;
+
+  size_t per_shard = (n_bodies + MAX_SHARDS - 1) / MAX_SHARDS;
+  vector<CodegenShard> shards((n_bodies + per_shard - 1) / per_shard);
+  for (size_t i = 0; i < shards.size(); i++) {
+    shards[i].begin = i * per_shard;
+    shards[i].end = std::min(n_bodies, (i + 1) * per_shard);
+  }
+
+  CodegenState* main_state = cg;
+  std::atomic<size_t> next{0};
+  size_t n_threads = std::min(shards.size(), (size_t)opts.codegen_threads);
+  vector<std::thread> pool;
+  for (size_t t = 0; t < n_threads; t++) {
+    pool.emplace_back(codegen_worker, std::ref(nodes), std::ref(shards), std::ref(next),
+                      std::cref(opts), std::cref(*main_state->llvm_mod),
+                      std::cref(*main_state->records), timeTraceProfilerEnabled());
+  }
+  for (auto& t : pool) {
+    t.join();
+  }
+
+  cg = main_state;
+  bool ok = true;
+  for (auto& shard : shards) {
+    ok &= (shard.diags.n_errs() == 0);
+    CompilerInstance::active()->diags.append(shard.diags);
+  }
+  if (!ok) return false;
+
+  for (size_t i = 0; i < shards.size(); i++) {
+    CodegenShard& shard = shards[i];
+    auto mod = parseBitcodeFile(MemoryBufferRef(StringRef(shard.bitcode.data(), shard.bitcode.size()), "shard"), *cg->llvm_ctx);
+    if (!mod) {
+      ehdl::report(ehdl::E_CODEGEN_SHARD, ehdl::NO_POS, {toString(mod.takeError())});
+      return false;
+    }
+    if (Linker::linkModules(*cg->llvm_mod, std::move(*mod))) {
+      ehdl::report(ehdl::E_CODEGEN_SHARD, ehdl::NO_POS, {"the linker rejected shard " + std::to_string(i)});
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TranslationUnit::codegen(const CodegenOptions& opts) {
+  cg = &CompilerInstance::active()->codegen;
+  cg->records = &CompilerInstance::active()->records;
+  cg->record_types.clear();
+  cg->ssa_mode = opts.ssa;
+  cg->jump_tables = (opts.opt_level == 0);
+  cg->llvm_ctx = std::make_unique<llvm::LLVMContext>();
+  cg->llvm_mod = std::make_unique<llvm::Module>("Code Generator", *cg->llvm_ctx);
+
+  TimeReport& time_report = CompilerInstance::active()->time_report;
+  std::unique_ptr<TimeReport::Scope> phase = std::make_unique<TimeReport::Scope>(time_report, "codegen");
+
+  cg->llvm_tm = create_target_machine(opts);
+  if (!cg->llvm_tm) return false;
+  cg->llvm_mod->setTargetTriple(cg->llvm_tm->getTargetTriple().str());
+  cg->llvm_mod->setDataLayout(cg->llvm_tm->createDataLayout());
 
   // Create a new builder for the module.
-  llvm_builder = std::make_unique<llvm::IRBuilder<>>(*llvm_ctx);
+  cg->llvm_builder = std::make_unique<llvm::IRBuilder<>>(*cg->llvm_ctx);
 
   DeclarationStatement* decl_ptr;
   for (auto node_ptr: *nodes){
     // cdebug<<"HI1"<<endl;
-    if ((decl_ptr = dynamic_cast<DeclarationStatement*>(node_ptr))) {
+    if ((decl_ptr = dyn_cast<DeclarationStatement>(node_ptr))) {
       // cout<<"READ FUNC DEF"<<endl;
       Value* v = decl_ptr->globalgen();
-      // llvm_mod->print(errs(), nullptr); // print decls
+      // cg->llvm_mod->print(errs(), nullptr); // print decls
       // v->print(errs());
       // func_ir->print(errs());
     }
@@ -583,27 +1080,160 @@ std::string TranslationUnit::codegen() {
 
   Function* func_ptr;
   for (auto node_ptr: *nodes){
-    if ((func_ptr = dynamic_cast<Function*>(node_ptr))) {
+    if ((func_ptr = dyn_cast<Function>(node_ptr))) {
       // cout<<"READ FUNC DEF"<<endl;
-      llvm::Function* func_ir = func_ptr->codegen();
+      llvm::Function* func_ir = opts.codegen_threads > 1 ? func_ptr->prototype() : func_ptr->codegen();
       // func_ir->print(errs(), nullptr);
     }
   }
 
-  std::string str;
-  raw_string_ostream os(str);
-  os << *llvm_mod;
+  if (!parallel_codegen(*nodes, opts)) return false;
+  // bodies with errors are left half built
+  if (CompilerInstance::active()->diags.n_errs() > 0 || !verify_module(*cg->llvm_mod)) return false;
+
+  phase.reset();
+  phase = std::make_unique<TimeReport::Scope>(time_report, "optimize");
+  return optimize_module(opts);
+}
+
+// Writes the module straight to the output file in the requested format,
+// without going through an in-memory copy of the IR text.
+bool TranslationUnit::emit(const string& filename, const CodegenOptions& opts) {
+  cg = &CompilerInstance::active()->codegen;
+  std::error_code ec;
+  sys::fs::OpenFlags flags = (opts.emit == EMIT_LL || opts.emit == EMIT_ASM) ? sys::fs::OF_Text : sys::fs::OF_None;
+  raw_fd_ostream os(filename, ec, flags);
+  if (ec) {
+    cerr << "Error: could not open " << filename << ": " << ec.message() << endl;
+    return false;
+  }
+
+  switch (opts.emit) {
+    case EMIT_LL: cg->llvm_mod->print(os, nullptr); break;
+    case EMIT_BC: WriteBitcodeToFile(*cg->llvm_mod, os); break;
+    case EMIT_ASM:
+    case EMIT_OBJ: {
+      legacy::PassManager pm;
+      CodeGenFileType ft = (opts.emit == EMIT_OBJ) ? CGFT_ObjectFile : CGFT_AssemblyFile;
+      if (cg->llvm_tm->addPassesToEmitFile(pm, os, nullptr, ft)) {
+        cerr << "Error: target " << cg->llvm_tm->getTargetTriple().str() << " cannot emit this file type" << endl;
+        return false;
+      }
+      pm.run(*cg->llvm_mod);
+      break;
+    }
+  }
   os.flush();
-  return os.str();
+  return true;
+}
+
+// Object cache for --run. Objects are keyed by the MD5 of the module's
+// bitcode (set as the module identifier in run()), so a source change or a
+// different -O level gives a different file.
+class DiskObjectCache : public ObjectCache {
+  std::string dir;
+
+  std::string path_for(const Module* m) {
+    SmallString<128> path(dir);
+    sys::path::append(path, m->getModuleIdentifier() + ".o");
+    return path.str().str();
+  }
+
+public:
+  DiskObjectCache(const std::string& dir) : dir(dir) {
+    sys::fs::create_directories(dir);
+  }
+
+  void notifyObjectCompiled(const Module* m, MemoryBufferRef obj) override {
+    std::error_code ec;
+    raw_fd_ostream os(path_for(m), ec, sys::fs::OF_None);
+    if (!ec) os << obj.getBuffer();
+  }
+
+  std::unique_ptr<MemoryBuffer> getObject(const Module* m) override {
+    auto buf = MemoryBuffer::getFile(path_for(m));
+    if (!buf) return nullptr;
+    cdebug << "jit cache hit for " << m->getModuleIdentifier() << endl;
+    return std::move(*buf);
+  }
+};
+
+// Compiles the module in-process with LLJIT and calls main. Undefined
+// symbols (printf, malloc, ..) resolve against the host process. Returns
+// main's exit code, or -1 if the module could not be jitted.
+int TranslationUnit::run(const vector<string>& args, const CodegenOptions& opts) {
+  cg = &CompilerInstance::active()->codegen;
+  init_targets();
+
+  auto report = [](Error err) {
+    cerr << "Error: jit: " << toString(std::move(err)) << endl;
+    return -1;
+  };
+
+  auto jtmb = orc::JITTargetMachineBuilder::detectHost();
+  if (!jtmb) return report(jtmb.takeError());
+  static const CodeGenOpt::Level levels[] = {
+    CodeGenOpt::None, CodeGenOpt::Less, CodeGenOpt::Default, CodeGenOpt::Aggressive
+  };
+  jtmb->setCodeGenOptLevel(levels[opts.opt_level]);
+  if (opts.mcpu == "native") {
+    jtmb->setCPU(sys::getHostCPUName().str());
+  }
+
+  std::unique_ptr<DiskObjectCache> cache;
+  if (!opts.jit_cache_dir.empty()) {
+    SmallString<0> bc;
+    raw_svector_ostream bcos(bc);
+    WriteBitcodeToFile(*cg->llvm_mod, bcos);
+    MD5 md5;
+    md5.update(bc);
+    md5.update(jtmb->getCPU());
+    md5.update(StringRef(std::to_string(opts.opt_level)));
+    MD5::MD5Result hash;
+    md5.final(hash);
+    cg->llvm_mod->setModuleIdentifier(hash.digest().str());
+    cache = std::make_unique<DiskObjectCache>(opts.jit_cache_dir);
+  }
+
+  orc::LLJITBuilder builder;
+  builder.setJITTargetMachineBuilder(*jtmb);
+  if (cache) {
+    DiskObjectCache* c = cache.get();
+    builder.setCompileFunctionCreator([c](orc::JITTargetMachineBuilder jtmb)
+        -> Expected<std::unique_ptr<orc::IRCompileLayer::IRCompiler>> {
+      auto tm = jtmb.createTargetMachine();
+      if (!tm) return tm.takeError();
+      return std::make_unique<orc::TMOwningSimpleCompiler>(std::move(*tm), c);
+    });
+  }
+  auto jit = builder.create();
+  if (!jit) return report(jit.takeError());
+
+  auto host = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+  if (!host) return report(host.takeError());
+  (*jit)->getMainJITDylib().addGenerator(std::move(*host));
+
+  // the jit takes the context along with the module
+  cg->llvm_mod->setDataLayout((*jit)->getDataLayout());
+  orc::ThreadSafeModule tsm(std::move(cg->llvm_mod), std::move(cg->llvm_ctx));
+  if (auto err = (*jit)->addIRModule(std::move(tsm))) return report(std::move(err));
+
+  auto main_sym = (*jit)->lookup("main");
+  if (!main_sym) return report(main_sym.takeError());
+
+  auto main_fn = (int (*)(int, char*[]))main_sym->getAddress();
+  int ret = orc::runAsMain(main_fn, ArrayRef<std::string>(args).drop_front(), StringRef(args[0]));
+  fflush(stdout);
+  return ret;
 }
 
 Value* Expression::codegen(){
-  ConstantInt::get(*llvm_ctx, APInt(32, 0));
+  ConstantInt::get(*cg->llvm_ctx, APInt(32, 0));
 }
 
 Value* Statement::codegen(){
   cout<<"virtual"<<endl;
-  return ConstantInt::get(*llvm_ctx, APInt(32, 0));
+  return ConstantInt::get(*cg->llvm_ctx, APInt(32, 0));
 }
 
 Value* ExpressionStatement::codegen(){
@@ -611,76 +1241,96 @@ Value* ExpressionStatement::codegen(){
   return expr->codegen();
 }
 
+// type of the value of a literal of type lt
+static ExprTypeInfo literal_type_info(LiteralType lt) {
+  ExprTypeInfo info;
+  info.is_ref = false;
+  info.st.ptr_depth = 0;
+  switch(lt) {
+    case LT_BOOL: info.st.stype = I1; break;
+    case LT_INT32: info.st.stype = I32; break;
+    case LT_UINT32: info.st.stype = U32; break;
+    case LT_INT64: info.st.stype = I64; break;
+    case LT_UINT64: info.st.stype = U64; break;
+    case LT_SHORT: info.st.stype = I16; break;
+    case LT_CHAR: info.st.stype = I8; break;
+    case LT_FLOAT: info.st.stype = FP32; break;
+    case LT_DOUBLE: info.st.stype = FP64; break;
+    case LT_STRING: info.st.stype = U8; info.st.ptr_depth = 1; break;
+    default: break;
+  }
+  return info;
+}
+
 Constant* Literal::codegen() {
-  int v;
-  float f;
-  type_info.is_ref = false;
-  type_info.st.ptr_depth = 0;
-  llvm::ArrayType* stringType;
-  llvm::Constant* stringLiteral;
-  llvm::GlobalVariable* stringVar;
-  std::vector<llvm::Value *> values;
-  llvm::APInt zero(32, 0);
-  llvm::APInt one(32, 0);
+  // parents convert their operands by rewriting type_info
+  type_info = literal_type_info(ltype);
+
+  Constant* c;
   switch(ltype) {
     case LT_BOOL:
-      type_info.st.stype = I1;
-      return ConstantInt::get(*llvm_ctx, APInt(1, data.i));
+      c = ConstantInt::get(*cg->llvm_ctx, APInt(1, data.i));
+      break;
     case LT_INT32:
-      type_info.st.stype = I32;
-      return ConstantInt::get(*llvm_ctx, APInt(32, data.i));
     case LT_UINT32:
-      type_info.st.stype = U32;
-      return ConstantInt::get(*llvm_ctx, APInt(32, data.i));
+      c = ConstantInt::get(*cg->llvm_ctx, APInt(32, data.i));
+      break;
     case LT_INT64:
-      type_info.st.stype = I64;
-      return ConstantInt::get(*llvm_ctx, APInt(64, data.l));
     case LT_UINT64:
-      type_info.st.stype = U64;
-      return ConstantInt::get(*llvm_ctx, APInt(64, data.l));
+      c = ConstantInt::get(*cg->llvm_ctx, APInt(64, data.l));
+      break;
     case LT_SHORT:
-      type_info.st.stype = I16;
-      return ConstantInt::get(*llvm_ctx, APInt(16, data.i));
+      c = ConstantInt::get(*cg->llvm_ctx, APInt(16, data.i));
+      break;
     case LT_CHAR:
-      type_info.st.stype = I8;
-      return ConstantInt::get(*llvm_ctx, APInt(8, data.c));
+      c = ConstantInt::get(*cg->llvm_ctx, APInt(8, data.c));
+      break;
     case LT_FLOAT:
-      type_info.st.stype = FP32;
-      return ConstantFP::get(llvm::Type::getFloatTy(*llvm_ctx), APFloat(data.f));
+      c = ConstantFP::get(llvm::Type::getFloatTy(*cg->llvm_ctx), APFloat(data.f));
+      break;
     case LT_DOUBLE:
-      type_info.st.stype = FP64;
-      return ConstantFP::get(llvm::Type::getDoubleTy(*llvm_ctx), APFloat(data.d));
+      c = ConstantFP::get(llvm::Type::getDoubleTy(*cg->llvm_ctx), APFloat(data.d));
+      break;
     case LT_INT_LIKE:
       cout << "ERROR: should have parsed int_like by now" << endl;
     case LT_FLOAT_LIKE:
       cout << "ERROR: should have parsed float_like by now" << endl;
     case LT_STRING:
-      type_info.st.stype = U8;
-      type_info.st.ptr_depth = 1;
-      return llvm_builder->CreateGlobalStringPtr(value, ".str");
+      return cg->llvm_builder->CreateGlobalStringPtr(*value, ".str");
     default:
       cout<<"invalid literal"<<endl;
       return nullptr;
   }
+  return c;
 }
 
 
 
+// the alloca or global holding a variable
+static Value* variable_storage(Identifier* ident) {
+  int idx = ident->ident_info.idx;
+  if(idx < 0){
+    // cout<<idx<<"GLOBAL"<<endl;
+    return cg->global_st[ ident->name/*getVarName(this, "g")*/];
+  }
+  else if(is_ssa_var(idx)){
+    return nullptr;          // lives in a register, see assign_value
+  }
+  return cg->llvm_st[idx];
+}
+
 Value* Identifier::get_address(){
   type_info.st = ident_info;
   type_info.is_ref = true;
 
-  AllocaInst* A;
-  int idx = ident_info.idx;
-  if(idx < 0){
-    // cout<<idx<<"GLOBAL"<<endl;
-    GlobalVariable* A = global_st[ name/*getVarName(this, "g")*/];
-    type_info.st= ident_info;
-    type_info.is_ref = true;
-    return A;
-  }
-  else{
-    A = llvm_st["l" + to_string(idx)];
+  Value* A = variable_storage(this);
+  if (ident_info.array_size) {
+    // arrays can't be assigned to, and &a is the address of the first element
+    Value* zero = ConstantInt::get(Type::getInt64Ty(*cg->llvm_ctx), 0);
+    Type* t = getObjectType(ident_info);
+    type_info.st.array_size = 0;
+    type_info.is_ref = false;
+    return cg->llvm_builder->CreateInBoundsGEP(t, A, {zero, zero}, "arraydecay");
   }
  
   type_info.st = ident_info;
@@ -689,6 +1339,157 @@ Value* Identifier::get_address(){
 
 }
 
+// records declared but never defined have no layout to index or load
+static bool incomplete_record(const SymbolInfo& info, sympos pos) {
+  if (info.stype != REC || info.ptr_depth || (*cg->records)[info.record].complete) return false;
+  ehdl::report(ehdl::E_RECORD_INCOMPLETE, pos, {(*cg->records)[info.record].name()});
+  return true;
+}
+
+// converts an array index to the 64 bit offset getelementptr takes
+static Value* index_to_offset(Expression* index, Value* I) {
+  SymbolType st = index->type_info.st.stype;
+  if (index->type_info.st.ptr_depth || !(is_int_type(st) || is_bool_type(st))) {
+    ehdl::report(ehdl::E_SUBSCRIPT_NOT_INTEGER, index->pos);
+    return nullptr;
+  }
+  if (st == I64 || st == U64) return I;
+  if (is_unsigned_int_type(st)) return widenToUInt(I, st, Type::getInt64Ty(*cg->llvm_ctx));
+  return widenToSInt(I, st, Type::getInt64Ty(*cg->llvm_ctx));
+}
+
+Value* SubscriptExpression::get_address(){
+  Identifier* array = dyn_cast<Identifier>(base);
+  Value* B = nullptr;
+  if (!array || !array->ident_info.array_size) {
+    B = base->codegen();
+    if (!B) return nullptr;
+    if (base->type_info.st.ptr_depth == 0) {
+      ehdl::report(ehdl::E_SUBSCRIPT_BASE, pos);
+      return nullptr;
+    }
+  }
+  Value* I = index->codegen();
+  if (!I || !(I = index_to_offset(index, I))) return nullptr;
+
+  type_info.is_ref = true;
+  if (!B) {
+    // index the array itself, so the access stays within one object
+    const SymbolInfo& info = array->ident_info;
+    Value* A = variable_storage(array);
+    Value* zero = ConstantInt::get(Type::getInt64Ty(*cg->llvm_ctx), 0);
+    type_info.st = info;
+    type_info.st.array_size = 0;
+    return cg->llvm_builder->CreateInBoundsGEP(getObjectType(info), A, {zero, I}, "arrayidx");
+  }
+  type_info.st = base->type_info.st;
+  type_info.st.ptr_depth--;
+  if (incomplete_record(type_info.st, pos)) return nullptr;
+  return cg->llvm_builder->CreateInBoundsGEP(getType(type_info.st.stype, type_info.st.ptr_depth, type_info.st.record), B, I, "arrayidx");
+}
+
+Value* SubscriptExpression::codegen(){
+  Value* A = get_address();
+  if (!A) return nullptr;
+  return cg->llvm_builder->CreateLoad(getType(type_info.st.stype, type_info.st.ptr_depth, type_info.st.record), A, "arrayval");
+}
+
+Value* MemberExpression::get_address(){
+  Value* B = arrow ? base->codegen() : base->get_address();
+  if (!B) return nullptr;
+  const SymbolInfo& info = base->type_info.st;
+  if (info.stype != REC || info.ptr_depth != (arrow ? 1 : 0)) {
+    ehdl::report(ehdl::E_MEMBER_BASE, pos, {arrow ? "->" : ".", arrow ? "pointer to a " : ""});
+    return nullptr;
+  }
+  const RecordLayout& layout = (*cg->records)[info.record];
+  if (!layout.complete) {
+    ehdl::report(ehdl::E_RECORD_INCOMPLETE, pos, {layout.name()});
+    return nullptr;
+  }
+  int i = layout.find_field(field);
+  if (i < 0) {
+    ehdl::report(ehdl::E_NO_MEMBER, pos, {*field, layout.name()});
+    return nullptr;
+  }
+
+  type_info.st = layout.fields[i].type;
+  type_info.is_ref = true;
+  Value* A;
+  if (layout.is_union) {
+    // every member of a union starts at its first byte
+    A = cg->llvm_builder->CreateBitCast(B, PointerType::get(getObjectType(type_info.st), 0), *field);
+  }
+  else {
+    A = cg->llvm_builder->CreateStructGEP(getRecordType(info.record), B, i, *field);
+  }
+  if (type_info.st.array_size) {
+    Value* zero = ConstantInt::get(Type::getInt64Ty(*cg->llvm_ctx), 0);
+    A = cg->llvm_builder->CreateInBoundsGEP(getObjectType(type_info.st), A, {zero, zero}, "arraydecay");
+    type_info.st.array_size = 0;
+    type_info.is_ref = false;
+  }
+  return A;
+}
+
+Value* MemberExpression::codegen(){
+  Value* A = get_address();
+  if (!A) return nullptr;
+  if (!type_info.is_ref) {
+    // an array field used as a value decays to a pointer to its first element
+    type_info.st.ptr_depth++;
+    return A;
+  }
+  return cg->llvm_builder->CreateLoad(getType(type_info.st.stype, type_info.st.ptr_depth, type_info.st.record), A, *field);
+}
+
+// Type of the operand of sizeof or _Alignof, which is never evaluated. Only
+// operands whose type follows from declarations alone are accepted.
+static bool operand_type(Expression* expr, SymbolInfo& info) {
+  if (isa<TypeName>(expr)) {
+    info = expr->type_info.st;
+    return true;
+  }
+  if (Identifier* ident = dyn_cast<Identifier>(expr)) {
+    info = ident->ident_info;
+    return true;
+  }
+  if (Literal* lit = dyn_cast<Literal>(expr)) {
+    if (lit->ltype == LT_STRING) return false;
+    lit->codegen();
+    info = lit->type_info.st;
+    return true;
+  }
+  if (SubscriptExpression* sub = dyn_cast<SubscriptExpression>(expr)) {
+    if (!operand_type(sub->base, info)) return false;
+    if (info.array_size) info.array_size = 0;
+    else if (info.ptr_depth) info.ptr_depth--;
+    else return false;
+    return true;
+  }
+  if (MemberExpression* member = dyn_cast<MemberExpression>(expr)) {
+    if (!operand_type(member->base, info) || info.stype != REC || info.array_size) return false;
+    if (info.ptr_depth != (member->arrow ? 1 : 0)) return false;
+    const RecordLayout& layout = (*cg->records)[info.record];
+    int i = layout.find_field(member->field);
+    if (i < 0) return false;
+    info = layout.fields[i].type;
+    return true;
+  }
+  if (UnaryExpression* un_exp = dyn_cast<UnaryExpression>(expr)) {
+    if (un_exp->op != OP_DEREF && un_exp->op != OP_AND) return false;
+    if (!operand_type(un_exp->expr, info)) return false;
+    if (un_exp->op == OP_AND) {
+      info.ptr_depth++;
+      info.array_size = 0;
+    }
+    else if (info.array_size) info.array_size = 0;
+    else if (info.ptr_depth) info.ptr_depth--;
+    else return false;
+    return true;
+  }
+  return false;
+}
 
 Value *BinaryExpression::codegen() {
   if (op == OP_ASSIGN){
@@ -697,22 +1498,30 @@ Value *BinaryExpression::codegen() {
     Value* A = V;
     type_info.st = lhs->type_info.st;
     type_info.is_ref = false;                       
+    if (mismatched_records(lhs->type_info.st, rhs->type_info.st)) {
+      ehdl::report(ehdl::E_ASSIGN_TYPE_MISMATCH, pos);
+      return nullptr;
+    }
     if(( get_rank(lhs->type_info.st.stype) == get_rank(rhs->type_info.st.stype)) && (lhs->type_info.st.ptr_depth == rhs->type_info.st.ptr_depth) && (lhs->type_info.is_ref)){   // comparing rank as they are internally the same type
-      llvm_builder->CreateStore(R, A);
+      assign_value(lhs, A, R);
       return R;
     }
     else if ((rhs->type_info.st.ptr_depth == 0) && (lhs->type_info.st.ptr_depth == 0) && lhs->type_info.is_ref){       // widening/narrowing only if rhs is not a pointer
       Value* newrhs = convertForAssignment(lhs, rhs, R);
       rhs->type_info.st = lhs->type_info.st;
-      llvm_builder->CreateStore(newrhs, A);
+      assign_value(lhs, A, newrhs);
       return newrhs;    // should i return newrhs or R. if R then don't update type info of expression ig.
     }
     else{      
-      ehdl::err("Assignment type mismatch", pos);
+      ehdl::report(ehdl::E_ASSIGN_TYPE_MISMATCH, pos);
       return nullptr;
     }
   }
 
+  if (op == OP_BOOL_AND || op == OP_BOOL_OR){
+    return logicalgen();
+  }
+
   Value *oldL = lhs->codegen();
   // cout<<"lhs gened" << endl;
   Value *oldR = rhs->codegen();
@@ -733,7 +1542,7 @@ Value *BinaryExpression::codegen() {
       widen_expression(lhs, rhs, oldL, oldR, &L, &R);
     }
     else{
-      ehdl::err("type mismatch", pos);
+      ehdl::report(ehdl::E_TYPE_MISMATCH, pos);
       return nullptr;
     }
   }
@@ -792,16 +1601,6 @@ Value *BinaryExpression::codegen() {
     case OP_NE:
       type_info.st.stype = I1;
       return handleNE(L, R, lhs->type_info.st.stype);
-    case OP_BOOL_AND:
-      type_info.st.stype = I1;
-      return handleBAnd(narrowToBool(L, lhs->type_info.st.stype, getType(lhs->type_info.st.stype, 0)), 
-                        narrowToBool(R, rhs->type_info.st.stype, getType(rhs->type_info.st.stype, 0)), 
-                        I1);
-    case OP_BOOL_OR:
-      type_info.st.stype = I1;
-      return handleBOr(narrowToBool(L, lhs->type_info.st.stype, getType(lhs->type_info.st.stype, 0)), 
-                       narrowToBool(R, rhs->type_info.st.stype, getType(rhs->type_info.st.stype, 0)), 
-                       I1);
     case OP_AND:
       type_info.st.stype = lhs->type_info.st.stype;
       return handleAnd(L, R, lhs->type_info.st.stype);
@@ -818,6 +1617,87 @@ Value *BinaryExpression::codegen() {
   // TODO code calling this should also do error checking!
 }
 
+// a && b and a || b as values: b is only evaluated when a does not decide
+// the result, the result is a phi of the constant a decided and the truth
+// value of b
+Value* BinaryExpression::logicalgen() {
+  bool is_and = (op == OP_BOOL_AND);
+  Value* L = lhs->codegen();
+  if (!L) return nullptr;
+  L = conditionToBool(lhs, L);
+
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  BasicBlock *lhsb = cg->llvm_builder->GetInsertBlock();
+  BasicBlock *rhsb = BasicBlock::Create(*cg->llvm_ctx, is_and ? "land_rhs" : "lor_rhs", func);
+  BasicBlock *endb = BasicBlock::Create(*cg->llvm_ctx, is_and ? "land_end" : "lor_end");
+  if (is_and) cg->llvm_builder->CreateCondBr(L, rhsb, endb);
+  else cg->llvm_builder->CreateCondBr(L, endb, rhsb);
+  seal_block(rhsb);
+
+  cg->llvm_builder->SetInsertPoint(rhsb);
+  Value* R = rhs->codegen();
+  if (!R) return nullptr;
+  R = conditionToBool(rhs, R);
+  rhsb = cg->llvm_builder->GetInsertBlock();
+  cg->llvm_builder->CreateBr(endb);
+
+  func->getBasicBlockList().push_back(endb);
+  seal_block(endb);
+  cg->llvm_builder->SetInsertPoint(endb);
+  Type* boolty = Type::getInt1Ty(*cg->llvm_ctx);
+  PHINode* phi = cg->llvm_builder->CreatePHI(boolty, 2, "temp");
+  phi->addIncoming(ConstantInt::get(boolty, is_and ? 0 : 1), lhsb);
+  phi->addIncoming(R, rhsb);
+
+  type_info.st.stype = I1;
+  type_info.st.ptr_depth = 0;
+  type_info.is_ref = false;
+  return phi;
+}
+
+
+// codegen as the condition of a branch: jumps to if_true or if_false and
+// leaves the builder in a terminated block
+
+void Expression::branchgen(BasicBlock* if_true, BasicBlock* if_false) {
+  Value* condval = codegen();
+  if (!condval) return;
+  condval = conditionToBool(this, condval);
+  cg->llvm_builder->CreateCondBr(condval, if_true, if_false);
+}
+
+// && and || jump straight to the targets, no i1 is materialized
+void BinaryExpression::branchgen(BasicBlock* if_true, BasicBlock* if_false) {
+  if (op != OP_BOOL_AND && op != OP_BOOL_OR) {
+    Expression::branchgen(if_true, if_false);
+    return;
+  }
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  BasicBlock *rhsb = BasicBlock::Create(*cg->llvm_ctx, op == OP_BOOL_AND ? "land_rhs" : "lor_rhs");
+  if (op == OP_BOOL_AND) lhs->branchgen(rhsb, if_false);
+  else lhs->branchgen(if_true, rhsb);
+  seal_block(rhsb);
+
+  func->getBasicBlockList().push_back(rhsb);
+  cg->llvm_builder->SetInsertPoint(rhsb);
+  rhs->branchgen(if_true, if_false);
+
+  type_info.st.stype = I1;
+  type_info.st.ptr_depth = 0;
+  type_info.is_ref = false;
+}
+
+void UnaryExpression::branchgen(BasicBlock* if_true, BasicBlock* if_false) {
+  if (op != OP_BOOL_NOT) {
+    Expression::branchgen(if_true, if_false);
+    return;
+  }
+  expr->branchgen(if_false, if_true);
+  type_info.st.stype = I1;
+  type_info.st.ptr_depth = 0;
+  type_info.is_ref = false;
+}
+
 Value* UnaryExpression::codegen(){
   Value* R;
   switch (op){
@@ -830,7 +1710,7 @@ Value* UnaryExpression::codegen(){
       // removed the getElementType, segfaults now though
       // also changed loc to idx (more descriptive) 
       // llvm::cast<llvm::PointerType>(R->getType()))->getElementType()
-      return llvm_builder->CreateLoad(getType(type_info.st.stype, type_info.st.ptr_depth), R, "dereftemp");
+      return cg->llvm_builder->CreateLoad(getType(type_info.st.stype, type_info.st.ptr_depth, type_info.st.record), R, "dereftemp");
     case OP_AND:
       R = expr->get_address();
       type_info= expr->type_info;
@@ -842,40 +1722,57 @@ Value* UnaryExpression::codegen(){
       R = expr->codegen();
       type_info = expr->type_info;
       if (expr->type_info.st.ptr_depth != 0) { 
-        ehdl::err("Pointer depth of unary expression should be zero", pos); 
+        ehdl::report(ehdl::E_UNARY_POINTER, pos); 
         return nullptr; 
       }
       type_info.st.ptr_depth = 0;
       type_info.is_ref = false;
-      if (is_int_type(type_info.st.stype)) return llvm_builder->CreateNeg(R, "uminus");
-      else if (is_fp_type(type_info.st.stype)) return llvm_builder->CreateFNeg(R, "uminus");
+      if (is_int_type(type_info.st.stype)) return cg->llvm_builder->CreateNeg(R, "uminus");
+      else if (is_fp_type(type_info.st.stype)) return cg->llvm_builder->CreateFNeg(R, "uminus");
       else {
-        ehdl::err("Can't negate this type", pos);
+        ehdl::report(ehdl::E_NEGATE_TYPE, pos);
         return nullptr;
       }
     case OP_BOOL_NOT:
       R = expr->codegen();
       if (expr->type_info.st.ptr_depth != 0) {
-        ehdl::err("Pointer depth of unary expression should be zero", pos); 
+        ehdl::report(ehdl::E_UNARY_POINTER, pos); 
         return nullptr;
       }
       R = narrowToBool(R, expr->type_info.st.stype, getType(expr->type_info.st.stype, 0));
       type_info.st.stype = I1;
       type_info.st.ptr_depth = 0;
       type_info.is_ref = false;
-      return llvm_builder->CreateNot(R, "not");
+      return cg->llvm_builder->CreateNot(R, "not");
+    case OP_SIZEOF:
+    case OP_ALIGNOF: {
+      SymbolInfo info;
+      if (!operand_type(expr, info)) {
+        ehdl::report(ehdl::E_SIZEOF_EXPRESSION, pos, {op == OP_SIZEOF ? "sizeof" : "_Alignof"});
+        return nullptr;
+      }
+      if (info.stype == VD && !info.ptr_depth) {
+        ehdl::report(ehdl::E_SIZEOF_VOID, pos, {op == OP_SIZEOF ? "sizeof" : "_Alignof"});
+        return nullptr;
+      }
+      if (incomplete_record(info, pos)) return nullptr;
+      type_info.st = {-1, 0, U64};
+      type_info.is_ref = false;
+      long n = op == OP_SIZEOF ? cg->records->size_of(info) : cg->records->align_of(info);
+      return ConstantInt::get(Type::getInt64Ty(*cg->llvm_ctx), n);
+    }
     case OP_NOT:
       R = expr->codegen();
       type_info = expr->type_info;
       if (expr->type_info.st.ptr_depth != 0) {
-        ehdl::err("Pointer depth of unary expression should be zero", pos); 
+        ehdl::report(ehdl::E_UNARY_POINTER, pos); 
         return nullptr;
       }
       type_info.st.ptr_depth = 0;
       type_info.is_ref = false;
-      if (is_int_type(type_info.st.stype)) return llvm_builder->CreateNot(R, "not");
+      if (is_int_type(type_info.st.stype)) return cg->llvm_builder->CreateNot(R, "not");
       else if (is_fp_type(type_info.st.stype)) {
-        ehdl::err("Can't take binary NOT of a floating point", pos); 
+        ehdl::report(ehdl::E_NOT_FLOAT, pos); 
         return nullptr;
       }
     default:
@@ -907,14 +1804,14 @@ Value* UnaryExpression::get_address(){
 
 Value* ReturnStatement::codegen(){
   Value* ret_val = ret_expr->codegen();
-  if (get_rank(ret_expr->type_info.st.stype) == get_rank(func_ret_st.stype) && 
-      ret_expr->type_info.st.ptr_depth == func_ret_st.ptr_depth) return llvm_builder->CreateRet(ret_val);
-  else if (func_ret_st.ptr_depth == 0 && ret_expr->type_info.st.ptr_depth == 0) {
+  if (get_rank(ret_expr->type_info.st.stype) == get_rank(cg->func_ret_st.stype) && 
+      ret_expr->type_info.st.ptr_depth == cg->func_ret_st.ptr_depth) return cg->llvm_builder->CreateRet(ret_val);
+  else if (cg->func_ret_st.ptr_depth == 0 && ret_expr->type_info.st.ptr_depth == 0) {
     // convert
-    return llvm_builder->CreateRet(convertForInit(func_ret_st.stype, ret_expr, ret_val));
+    return cg->llvm_builder->CreateRet(convertForInit(cg->func_ret_st.stype, ret_expr, ret_val));
   }
   else {
-    ehdl::err("Return type doesn't match for function", pos);
+    ehdl::report(ehdl::E_RETURN_TYPE, pos);
     return nullptr;
   }
 }
@@ -923,10 +1820,11 @@ Value* ReturnStatement::codegen(){
 Value* BlockStatement::codegen(){
   Value* v;
   for (auto stmt = begin(); stmt != end(); ++stmt) {
-        v = (*stmt)->codegen();
-        if(dynamic_cast<ReturnStatement*> (*stmt)){
-          return nullptr;                                  // if there is a return statement return nullptr else return v. this might create problems when we do error handling.
+        if (cg->llvm_builder->GetInsertBlock()->getTerminator() && !isa<CaseStatement>(*stmt)) {
+          if (cg->switch_depth == 0) return nullptr;       // after a return or break, nothing else can be reached
+          start_unreachable_block();
         }
+        v = (*stmt)->codegen();
     }
   return (Value*) 1;
 }
@@ -940,7 +1838,7 @@ llvm::Value* FunctionInvocationExpression::codegen(){
 
  // Type should be assigned during scopify
   Identifier* ident = (Identifier*) fn;               // is it fine to call codegen func here? nope
-  llvm::Function* func = llvm_mod->getFunction(ident->name);
+  llvm::Function* func = cg->func_st[ident->name];
 
   type_info.is_ref = false;
   type_info.st = ident->ident_info;          
@@ -957,28 +1855,27 @@ llvm::Value* FunctionInvocationExpression::codegen(){
   }
   // cout<<"pushed params"<<endl;
   if(func->getFunctionType()->getReturnType()->isVoidTy()){
-    return llvm_builder->CreateCall(func, argsV);
+    return cg->llvm_builder->CreateCall(func, argsV);
   }
-  return llvm_builder->CreateCall(func, argsV, "calltmp");
+  return cg->llvm_builder->CreateCall(func, argsV, "calltmp");
 }
 
 
-llvm::Function *Function::codegen() {
-  // Uncommenting this causes a segfault !?
-  // cdebug << "Generating function code " << func_decl->ident->name << endl;
-  std::string func_name = func_decl->ident->name;
-  func_ret_st = func_decl->ident->ident_info;
+// declares the function in the module, or returns the existing declaration
+llvm::Function *Function::prototype() {
+  istring func_name = func_decl->ident->name;
   int num_args = 0;
   if(params){
     num_args = params->params->size();
   }
   llvm::Function *func;
-  if(func_st.find(func_name) == func_st.end()){
+  if(cg->func_st.find(func_name) == cg->func_st.end()){
     
     std::vector<llvm::Type*> argtypes(num_args);
     for(int i = 0; i < num_args; i++){
       PureDeclaration* decl = (*(params->params))[i];
-      argtypes[i] = getType(typespecs2stg(decl->decl_specs->type_specs), decl->ptr_depth);
+      const SymbolInfo& info = decl->ident->ident_info;
+      argtypes[i] = getType(info.stype, info.ptr_depth, info.record);
     }
     bool flag = false;
     if(params){
@@ -986,9 +1883,10 @@ llvm::Function *Function::codegen() {
         flag = true;               //varargs
       }
     }
-    FunctionType *func_type = FunctionType::get(getType(typespecs2stg(func_decl->decl_specs->type_specs), func_decl->ptr_depth), argtypes, flag);
+    const SymbolInfo& ret = func_decl->ident->ident_info;
+    FunctionType *func_type = FunctionType::get(getType(ret.stype, ret.ptr_depth, ret.record), argtypes, flag);
     
-    func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, func_name, llvm_mod.get());
+    func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, *func_name, cg->llvm_mod.get());
 
     int i=0;
     for (auto &Arg : func->args()){
@@ -996,40 +1894,71 @@ llvm::Function *Function::codegen() {
       i++;
     }
 
-    func_st[func_name] = func;
+    cg->func_st[func_name] = func;
     
   }
   else{
-    func = func_st[func_name];              // TODO check for redeclaration
+    func = cg->func_st[func_name];              // TODO check for redeclaration
   }
-  
+  return func;
+}
+
+llvm::Function *Function::codegen() {
+  // Uncommenting this causes a segfault !?
+  // cdebug << "Generating function code " << func_decl->ident->name << endl;
+  cg->func_ret_st = func_decl->ident->ident_info;
+  llvm::Function *func = prototype();
+  TimeTraceScope trace("codegen function", *func_decl->ident->name);
 
   if (stmts) {
-    BasicBlock *block = BasicBlock::Create(*llvm_ctx, "entry", func);
-    llvm_builder->SetInsertPoint(block);
-    llvm_st.clear();
+    BasicBlock *block = BasicBlock::Create(*cg->llvm_ctx, "entry", func);
+    cg->llvm_builder->SetInsertPoint(block);
+    cg->llvm_st.clear();
+    reset_ssa_state();
+    seal_block(block);
+    if (cg->ssa_mode) {
+      // everything whose address is never taken can stay in registers
+      find_address_taken(stmts, cg->address_taken);
+      if (params) {
+        for (auto decl : *params->params) {
+          const SymbolInfo& info = decl->ident->ident_info;
+          if (!cg->address_taken.count(info.idx))
+            cg->ssa_vars[info.idx] = getType(info.stype, info.ptr_depth, info.record);
+        }
+      }
+    }
     int i = 0;
     for (auto &Arg : func->args()) {
+      Identifier* ident = (*(params->params))[i]->ident;
 
-      AllocaInst *Alloca = CreateEntryBlockAlloca(func, (*(params->params))[i]->decl_specs,  (*(params->params))[i]->ptr_depth , (*(params->params))[i]->ident);
+      if (is_ssa_var(ident->ident_info.idx)) {
+        write_variable(ident->ident_info.idx, block, &Arg);
+        i++;
+        continue;
+      }
+
+      AllocaInst *Alloca = CreateEntryBlockAlloca(func, ident);
 
-      llvm_builder->CreateStore(&Arg, Alloca);
+      cg->llvm_builder->CreateStore(&Arg, Alloca);
 
     
-      llvm_st[getVarName((*(params->params))[i]->ident, "l")] = Alloca;
+      cg->llvm_st[ident->ident_info.idx] = Alloca;
       i++;
     }
       
-    Value *ret_val = stmts->codegen();
-    if(ret_val){
+    stmts->codegen();
+    if(!cg->llvm_builder->GetInsertBlock()->getTerminator()){
       // add a return statement
       if(typespecs2stg(func_decl->decl_specs->type_specs) == VD){
-        llvm_builder->CreateRetVoid();
+        cg->llvm_builder->CreateRetVoid();
+      }
+      else if(cg->ssa_mode){
+        cg->llvm_builder->CreateRet(UndefValue::get(getType(cg->func_ret_st.stype, cg->func_ret_st.ptr_depth, cg->func_ret_st.record)));
       }
       else{
-        AllocaInst *Alloca = CreateEntryBlockAlloca(func, func_decl->decl_specs, func_decl->ptr_depth , func_decl->ident);
-        Value* v = llvm_builder->CreateLoad(getType(typespecs2stg(func_decl->decl_specs->type_specs), func_decl->ptr_depth), Alloca, "returnval");
-        llvm_builder->CreateRet(v);
+        AllocaInst *Alloca = CreateEntryBlockAlloca(func, func_decl->ident);
+        Value* v = cg->llvm_builder->CreateLoad(getType(cg->func_ret_st.stype, cg->func_ret_st.ptr_depth, cg->func_ret_st.record), Alloca, "returnval");
+        cg->llvm_builder->CreateRet(v);
       }
     }
     if (/* Value *ret_val = stmts->codegen() */true) {           // if and while return nullptr for now. change during error handling maybe
@@ -1047,24 +1976,35 @@ llvm::Function *Function::codegen() {
 
 Value* Identifier::codegen(){
   // assuming undeclared variables handled in scopify
-  AllocaInst* A;
+  Value* A;
   int idx = ident_info.idx;
+  if (ident_info.array_size) {
+    // an array used as a value decays to a pointer to its first element
+    A = get_address();
+    type_info.st.ptr_depth++;
+    return A;
+  }
   if(idx < 0){
     // cout<<idx<<"GLOVAL"<<endl;f
-    GlobalVariable* A = global_st[ name /*getVarName(this, "g")*/];
+    GlobalVariable* A = cg->global_st[ name /*getVarName(this, "g")*/];
     type_info.st= ident_info;
     type_info.is_ref = true;
-    return llvm_builder->CreateLoad(A->getValueType(), A, name);
+    return cg->llvm_builder->CreateLoad(A->getValueType(), A, *name);
+  }
+  else if(is_ssa_var(idx)){
+    type_info.st = ident_info;
+    type_info.is_ref = true;
+    return read_variable(idx, cg->llvm_builder->GetInsertBlock());
   }
   else{
-    A = llvm_st["l" + to_string(idx)];
+    A = cg->llvm_st[idx];
   }
 
 
  
   type_info.st = ident_info;
   type_info.is_ref = true;
-  return llvm_builder->CreateLoad(A->getAllocatedType(), A, name);
+  return cg->llvm_builder->CreateLoad(getType(ident_info.stype, ident_info.ptr_depth, ident_info.record), A, *name);
 } 
 
 
@@ -1072,34 +2012,30 @@ Value* Identifier::codegen(){
 // control flow
 
 Value *IfStatement::codegen() {
-  Value *condval = cond->codegen();
-  condval = narrowToBool(condval, cond->type_info.st.stype, getType(cond->type_info.st.stype, 0));
-  cond->type_info.st.stype = I1;
-  if (!condval || cond->type_info.st.stype != I1) // sus
-    return nullptr;
-
-
-  llvm::Function *func = llvm_builder->GetInsertBlock()->getParent();
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
 
 
 
   if (true_branch) {
-    BasicBlock *trueb = BasicBlock::Create(*llvm_ctx, "then", func);
-    BasicBlock *falseb = BasicBlock::Create(*llvm_ctx, "else");
-    BasicBlock *afterb = BasicBlock::Create(*llvm_ctx, "ifcont");
-    llvm_builder->CreateCondBr(condval, trueb, falseb);
+    BasicBlock *trueb = BasicBlock::Create(*cg->llvm_ctx, "then");
+    BasicBlock *falseb = BasicBlock::Create(*cg->llvm_ctx, "else");
+    BasicBlock *afterb = BasicBlock::Create(*cg->llvm_ctx, "ifcont");
+    cond->branchgen(trueb, falseb);
+    seal_block(trueb);
+    seal_block(falseb);
 
-    llvm_builder->SetInsertPoint(trueb);
+    func->getBasicBlockList().push_back(trueb);
+    cg->llvm_builder->SetInsertPoint(trueb);
 
     if (true_branch) {
       Value *temp = true_branch->codegen();          // useless?
     }
 
-    llvm_builder->CreateBr(afterb);
-    trueb = llvm_builder->GetInsertBlock();
+    branch_if_open(afterb);
+    trueb = cg->llvm_builder->GetInsertBlock();
 
     func->getBasicBlockList().push_back(falseb);
-    llvm_builder->SetInsertPoint(falseb);
+    cg->llvm_builder->SetInsertPoint(falseb);
     Value *falsetemp = nullptr;
     if(false_branch){
       cdebug << "non empty else" << endl;
@@ -1111,13 +2047,16 @@ Value *IfStatement::codegen() {
 
     
 
-    llvm_builder->CreateBr(afterb);
-    falseb = llvm_builder->GetInsertBlock();
+    branch_if_open(afterb);
+    falseb = cg->llvm_builder->GetInsertBlock();
 
     func->getBasicBlockList().push_back(afterb);
-    llvm_builder->SetInsertPoint(afterb);              // continue 
+    seal_block(afterb);
+    cg->llvm_builder->SetInsertPoint(afterb);              // continue 
   }
   else{
+    if (!cond->codegen())
+      return nullptr;
     Value *falsetemp = nullptr;                
     if(false_branch){
       cdebug << "non empty else" << endl;
@@ -1131,37 +2070,327 @@ Value *IfStatement::codegen() {
 }
 
 
+// Loops get llvm.loop metadata on their back edges. A loop whose condition
+// is not a constant expression may be assumed to terminate (C11 6.8.5p6),
+// which is llvm.loop.mustprogress; the rest comes from the loop pragmas.
+static MDNode* loop_metadata(const LoopHints& hints, Expression* cond) {
+  LLVMContext& ctx = *cg->llvm_ctx;
+  Type* i32 = Type::getInt32Ty(ctx);
+  Type* i1 = Type::getInt1Ty(ctx);
+  auto hint = [&](const char* name) -> Metadata* {
+    return MDNode::get(ctx, MDString::get(ctx, name));
+  };
+  auto hint_value = [&](const char* name, Type* ty, uint64_t val) -> Metadata* {
+    return MDNode::get(ctx, {MDString::get(ctx, name), ConstantAsMetadata::get(ConstantInt::get(ty, val))});
+  };
+
+  SmallVector<Metadata*, 4> ops;
+  ops.push_back(nullptr);                   // the loop id refers to itself
+  if (cond && !isa<Literal>(cond)) ops.push_back(hint("llvm.loop.mustprogress"));
+  if (hints.unroll == HINT_DISABLE || hints.unroll_count == 1) {
+    ops.push_back(hint("llvm.loop.unroll.disable"));
+  }
+  else if (hints.unroll == HINT_ENABLE) {
+    if (hints.unroll_count) ops.push_back(hint_value("llvm.loop.unroll.count", i32, hints.unroll_count));
+    else ops.push_back(hint("llvm.loop.unroll.enable"));
+  }
+  if (hints.vectorize == HINT_DISABLE) {
+    ops.push_back(hint_value("llvm.loop.vectorize.enable", i1, 0));
+  }
+  else if (hints.vectorize == HINT_ENABLE) {
+    ops.push_back(hint_value("llvm.loop.vectorize.enable", i1, 1));
+    if (hints.vectorize_width) ops.push_back(hint_value("llvm.loop.vectorize.width", i32, hints.vectorize_width));
+  }
+  if (ops.size() == 1) return nullptr;
+
+  MDNode* loop_id = MDNode::getDistinct(ctx, ops);
+  loop_id->replaceOperandWith(0, loop_id);
+  return loop_id;
+}
+
+// every edge into header except the one from preheader is a back edge
+static void set_loop_metadata(BasicBlock* header, BasicBlock* preheader, MDNode* loop_id) {
+  if (!loop_id) return;
+  for (BasicBlock* pred : predecessors(header)) {
+    if (pred != preheader) pred->getTerminator()->setMetadata(LLVMContext::MD_loop, loop_id);
+  }
+}
+
 Value* WhileStatement::codegen(){
-  llvm::Function *func = llvm_builder->GetInsertBlock()->getParent();
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  BasicBlock *preheader = cg->llvm_builder->GetInsertBlock();
+  BasicBlock *condb = BasicBlock::Create(*cg->llvm_ctx, "loop_cond", func);
+  BasicBlock *loopb = BasicBlock::Create(*cg->llvm_ctx, "loop_body");
+  BasicBlock *afterb = BasicBlock::Create(*cg->llvm_ctx, "afterloop");
+
+  cg->llvm_builder->CreateBr(condb);
+
+  cg->llvm_builder->SetInsertPoint(condb);
+
+  cond->branchgen(loopb, afterb);
+  seal_block(loopb);
+
+  func->getBasicBlockList().push_back(loopb);
+  cg->llvm_builder->SetInsertPoint(loopb);
+
+  cg->break_targets.push_back(afterb);
+  cg->continue_targets.push_back(condb);
+  if (stmt) stmt->codegen();
+  cg->continue_targets.pop_back();
+  cg->break_targets.pop_back();
+  branch_if_open(condb);
+  seal_block(condb);              // back edges are known now
+  set_loop_metadata(condb, preheader, loop_metadata(hints, cond));
+
+  func->getBasicBlockList().push_back(afterb);
+  seal_block(afterb);
+  cg->llvm_builder->SetInsertPoint(afterb);
+  return nullptr;
+}
 
+Value* DoWhileStatement::codegen(){
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  BasicBlock *preheader = cg->llvm_builder->GetInsertBlock();
+  BasicBlock *loopb = BasicBlock::Create(*cg->llvm_ctx, "do_body", func);
+  BasicBlock *condb = BasicBlock::Create(*cg->llvm_ctx, "do_cond");
+  BasicBlock *afterb = BasicBlock::Create(*cg->llvm_ctx, "do_end");
+
+  cg->llvm_builder->CreateBr(loopb);
+  cg->llvm_builder->SetInsertPoint(loopb);
+
+  cg->break_targets.push_back(afterb);
+  cg->continue_targets.push_back(condb);
+  if (stmt) stmt->codegen();
+  cg->continue_targets.pop_back();
+  cg->break_targets.pop_back();
+  branch_if_open(condb);
+
+  func->getBasicBlockList().push_back(condb);
+  seal_block(condb);
+  cg->llvm_builder->SetInsertPoint(condb);
+  cond->branchgen(loopb, afterb);
+  seal_block(loopb);              // back edges are known now
+  set_loop_metadata(loopb, preheader, loop_metadata(hints, cond));
+
+  func->getBasicBlockList().push_back(afterb);
+  seal_block(afterb);
+  cg->llvm_builder->SetInsertPoint(afterb);
+  return nullptr;
+}
 
-  if (stmt) {
-    BasicBlock *condb = BasicBlock::Create(*llvm_ctx, "loop_cond", func);
-    BasicBlock *loopb = BasicBlock::Create(*llvm_ctx, "loop_body", func);
-    BasicBlock *afterb = BasicBlock::Create(*llvm_ctx, "afterloop", func);
+Value* ForStatement::codegen(){
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  init->codegen();
+
+  BasicBlock *preheader = cg->llvm_builder->GetInsertBlock();
+  BasicBlock *condb = BasicBlock::Create(*cg->llvm_ctx, "for_cond", func);
+  BasicBlock *loopb = BasicBlock::Create(*cg->llvm_ctx, "for_body");
+  BasicBlock *stepb = BasicBlock::Create(*cg->llvm_ctx, "for_step");
+  BasicBlock *afterb = BasicBlock::Create(*cg->llvm_ctx, "for_end");
+
+  cg->llvm_builder->CreateBr(condb);
+  cg->llvm_builder->SetInsertPoint(condb);
+  if (cond) cond->branchgen(loopb, afterb);
+  else cg->llvm_builder->CreateBr(loopb);
+  seal_block(loopb);
+
+  func->getBasicBlockList().push_back(loopb);
+  cg->llvm_builder->SetInsertPoint(loopb);
+  cg->break_targets.push_back(afterb);
+  cg->continue_targets.push_back(stepb);
+  if (stmt) stmt->codegen();
+  cg->continue_targets.pop_back();
+  cg->break_targets.pop_back();
+  branch_if_open(stepb);
+
+  func->getBasicBlockList().push_back(stepb);
+  seal_block(stepb);
+  cg->llvm_builder->SetInsertPoint(stepb);
+  if (step) step->codegen();
+  cg->llvm_builder->CreateBr(condb);
+  seal_block(condb);
+  set_loop_metadata(condb, preheader, loop_metadata(hints, cond));
+
+  func->getBasicBlockList().push_back(afterb);
+  seal_block(afterb);
+  cg->llvm_builder->SetInsertPoint(afterb);
+  return nullptr;
+}
+
+Value* ContinueStatement::codegen(){
+  if (cg->continue_targets.empty()) {
+    ehdl::report(ehdl::E_CONTINUE_OUTSIDE_LOOP, pos);
+    return nullptr;
+  }
+  return cg->llvm_builder->CreateBr(cg->continue_targets.back());
+}
 
-    llvm_builder->CreateBr(condb);
 
-    llvm_builder->SetInsertPoint(condb);
 
-    Value *condval = narrowToBool(cond->codegen(), cond->type_info.st.stype, getType(cond->type_info.st.stype, 0));
-    llvm_builder->CreateCondBr(condval, loopb, afterb);
 
-    llvm_builder->SetInsertPoint(loopb);
+// Dense switches are dispatched through a table of block addresses at -O0,
+// where the backend lowers every switch instruction to a chain of compares.
+// When optimizing, the switch instruction is kept and the backend chooses
+// between jump tables, bit tests and a search tree itself.
+static const size_t MIN_TABLE_CASES = 4;
+static const uint64_t MIN_TABLE_DENSITY = 40;    // percent of the slots that hold a case
+static const uint64_t MAX_TABLE_SIZE = 4096;
 
-    stmt->codegen();
-    llvm_builder->CreateBr(condb);
+typedef vector<pair<ConstantInt*, BasicBlock*>> CaseList;
 
-    llvm_builder->SetInsertPoint(afterb);
+// whether cases should be dispatched through a table, and its first value and size
+static bool use_jump_table(const CaseList& cases, bool is_signed, APInt& low, uint64_t& size) {
+  if (!cg->jump_tables || cases.size() < MIN_TABLE_CASES) return false;
+  APInt high = cases[0].first->getValue();
+  low = high;
+  for (auto& c : cases) {
+    const APInt& v = c.first->getValue();
+    if (is_signed ? v.slt(low) : v.ult(low)) low = v;
+    if (is_signed ? v.sgt(high) : v.ugt(high)) high = v;
   }
-  else{
-    cond->codegen();
+  APInt span = high - low;        // unsigned in either case, high is not below low
+  if (span.uge(MAX_TABLE_SIZE)) return false;
+  size = span.getZExtValue() + 1;
+  return cases.size() * 100 >= size * MIN_TABLE_DENSITY;
+}
+
+// indexes a private table of block addresses with val - low, values outside
+// the table and holes in it go to defaultb
+static void jump_table_dispatch(Value* val, const CaseList& cases, BasicBlock* defaultb, const APInt& low, uint64_t size) {
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  Type* ty = val->getType();
+  Value* offset = cg->llvm_builder->CreateSub(val, ConstantInt::get(ty, low), "switch_offset");
+  Value* in_range = cg->llvm_builder->CreateICmpULT(offset, ConstantInt::get(ty, size), "switch_inrange");
+  BasicBlock *tableb = BasicBlock::Create(*cg->llvm_ctx, "switch_table", func);
+  cg->llvm_builder->CreateCondBr(in_range, tableb, defaultb);
+  seal_block(tableb);
+  cg->llvm_builder->SetInsertPoint(tableb);
+
+  PointerType* ptrty = Type::getInt8PtrTy(*cg->llvm_ctx);
+  vector<Constant*> slots(size, BlockAddress::get(func, defaultb));
+  for (auto& c : cases) {
+    slots[(c.first->getValue() - low).getZExtValue()] = BlockAddress::get(func, c.second);
+  }
+  ArrayType* tablety = ArrayType::get(ptrty, size);
+  GlobalVariable* table = new GlobalVariable(*cg->llvm_mod, tablety, true, GlobalValue::PrivateLinkage,
+                                             ConstantArray::get(tablety, slots), "switch.table");
+  table->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+
+  Type* i64 = Type::getInt64Ty(*cg->llvm_ctx);
+  Value* idx = cg->llvm_builder->CreateZExt(offset, i64);
+  Value* slot = cg->llvm_builder->CreateInBoundsGEP(tablety, table, {ConstantInt::get(i64, 0), idx}, "switch_slot");
+  Value* target = cg->llvm_builder->CreateLoad(ptrty, slot, "switch_target");
+  IndirectBrInst* br = cg->llvm_builder->CreateIndirectBr(target, cases.size() + 1);
+  std::set<BasicBlock*> dests;
+  if (size > cases.size()) {
+    br->addDestination(defaultb);
+    dests.insert(defaultb);
   }
+  for (auto& c : cases) {
+    if (dests.insert(c.second).second) br->addDestination(c.second);
+  }
+}
 
- 
+Value* SwitchStatement::codegen(){
+  Value* val = expr->codegen();
+  if (!val) return nullptr;
+  SymbolType st = expr->type_info.st.stype;
+  if (expr->type_info.st.ptr_depth != 0 || !(is_int_type(st) || is_bool_type(st))) {
+    ehdl::report(ehdl::E_SWITCH_NOT_INTEGER, pos);
+    return nullptr;
+  }
+  if (get_rank(st) < get_rank(I32)) {           // integer promotion
+    val = widenToSInt(val, st, getType(I32, 0));
+    st = I32;
+  }
+  IntegerType* ty = cast<IntegerType>(val->getType());
+
+  // every label gets its block up front; they are moved into place as the
+  // body reaches them
+  llvm::Function *func = cg->llvm_builder->GetInsertBlock()->getParent();
+  BasicBlock *afterb = BasicBlock::Create(*cg->llvm_ctx, "switch_end", func);
+  BasicBlock *defaultb = afterb;
+  CaseList case_list;
+  std::set<ConstantInt*> values;
+  for (auto c : cases) {
+    c->block = BasicBlock::Create(*cg->llvm_ctx, c->const_expr ? "case" : "default", func);
+    if (!c->const_expr) {
+      defaultb = c->block;
+      continue;
+    }
+    ConstantInt* cval = ConstantInt::get(ty, ((Literal*) c->const_expr)->data.l, true);    // converted to the promoted type
+    if (!values.insert(cval).second) {
+      ehdl::report(ehdl::E_DUPLICATE_CASE, c->pos);
+      continue;
+    }
+    case_list.push_back({cval, c->block});
+  }
+
+  APInt low;
+  uint64_t size;
+  if (use_jump_table(case_list, is_signed_int_type(st), low, size)) {
+    cdebug << "switch: table of " << size << " for " << case_list.size() << " cases" << endl;
+    jump_table_dispatch(val, case_list, defaultb, low, size);
+  }
+  else {
+    SwitchInst* sw = cg->llvm_builder->CreateSwitch(val, defaultb, case_list.size());
+    for (auto& c : case_list) sw->addCase(c.first, c.second);
+  }
+
+  cg->break_targets.push_back(afterb);
+  cg->switch_depth++;
+  if (!isa<CaseStatement>(stmt) && !isa<BlockStatement>(stmt)) {
+    start_unreachable_block();      // a body without a leading label never runs
+  }
+  stmt->codegen();
+  cg->switch_depth--;
+  cg->break_targets.pop_back();
+
+  branch_if_open(afterb);
+  afterb->moveAfter(cg->llvm_builder->GetInsertBlock());
+  seal_block(afterb);
+  cg->llvm_builder->SetInsertPoint(afterb);
   return nullptr;
 }
 
+Value* CaseStatement::codegen(){
+  branch_if_open(block);            // fallthrough from the previous label
+  block->moveAfter(cg->llvm_builder->GetInsertBlock());
+  seal_block(block);
+  cg->llvm_builder->SetInsertPoint(block);
+  return stmt ? stmt->codegen() : nullptr;
+}
+
+Value* BreakStatement::codegen(){
+  if (cg->break_targets.empty()) {
+    ehdl::report(ehdl::E_BREAK_OUTSIDE_LOOP, pos);
+    return nullptr;
+  }
+  return cg->llvm_builder->CreateBr(cg->break_targets.back());
+}
+
+
 
 
+// address-taken analysis for SSA mode
+
+namespace {
+struct AddressTakenFinder : RecursiveASTVisitor<AddressTakenFinder> {
+  std::set<int>& taken;
+
+  AddressTakenFinder(std::set<int>& _taken) : taken(_taken) {}
+
+  bool visitUnaryExpression(UnaryExpression* un_exp) {
+    if (un_exp->op == OP_AND) {
+      if (Identifier* ident = dyn_cast<Identifier>(un_exp->expr)) taken.insert(ident->ident_info.idx);
+    }
+    return true;
+  }
+};
+}
+
+void find_address_taken(Node* node, std::set<int>& taken) {
+  AddressTakenFinder(taken).traverse(node);
+}
+
 }
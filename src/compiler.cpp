@@ -0,0 +1,55 @@
+#include "compiler.hpp"
+#include "error.hpp"
+#include "debug.hpp"
+#include "c.tab.hpp"
+
+// reentrant scanner interface, generated by flex from c.l
+int yylex_init_extra(SourceReader* reader, yyscan_t* scanner);
+int yylex_destroy(yyscan_t scanner);
+
+thread_local CompilerInstance* CompilerInstance::current = nullptr;
+
+CompilerInstance::CompilerInstance(const string& filename): filename{filename}, pool(), tu{nullptr} {
+  diags.set_name(filename);
+}
+
+CompilerInstance::~CompilerInstance() {
+  delete tu;
+  if (current == this) set_active(nullptr);
+}
+
+bool CompilerInstance::load() {
+  if (!source) source = sources.load(filename);
+  diags.set_source(source);
+  return source != nullptr;
+}
+
+bool CompilerInstance::parse() {
+  cdebug << "CompilerInstance::parse: " << filename << endl;
+  set_active(this);
+
+  if (!load()) {
+    ehdl::report(ehdl::E_CANNOT_OPEN, ehdl::NO_POS, {filename});
+    return false;
+  }
+
+  tu = new ast::TranslationUnit();      // also makes its arena the active one
+
+  SourceReader reader(source);
+  yyscan_t scanner;
+  yylex_init_extra(&reader, &scanner);
+  int ret = yyparse(tu, scanner);
+  yylex_destroy(scanner);
+
+  return ret == 0;
+}
+
+CompilerInstance* CompilerInstance::active() {
+  return current;
+}
+
+void CompilerInstance::set_active(CompilerInstance* instance) {
+  current = instance;
+  InternPool::set_active(instance ? &instance->pool : nullptr);
+  ehdl::DiagnosticSink::set_active(instance ? &instance->diags : nullptr);
+}
@@ -0,0 +1,90 @@
+#ifndef COMPILER
+#define COMPILER
+
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Target/TargetMachine.h"
+#include "ast.hpp"
+#include "symtab.hpp"
+#include "records.hpp"
+#include "intern.hpp"
+#include "error.hpp"
+#include "source.hpp"
+#include "timer.hpp"
+
+using namespace std;
+
+// Everything codegen.cpp needs while lowering one translation unit
+struct CodegenState {
+    std::unique_ptr<llvm::LLVMContext> llvm_ctx;
+    std::unique_ptr<llvm::Module> llvm_mod;
+    std::unique_ptr<llvm::IRBuilder<>> llvm_builder;
+    std::unordered_map<int, llvm::Value*> llvm_st;    // allocas, or globals of static locals
+    std::unordered_map<istring, llvm::GlobalVariable*> global_st;
+    std::unordered_map<istring, llvm::Function*> func_st;
+    const RecordTable* records = nullptr;
+    std::unordered_map<int, llvm::StructType*> record_types;     // created on first use
+    SymbolInfo func_ret_st;
+    std::unique_ptr<llvm::TargetMachine> llvm_tm;
+
+    // SSA construction, reset for every function
+    bool ssa_mode = false;
+    std::unordered_map<int, llvm::Type*> ssa_vars;
+    std::unordered_map<llvm::BasicBlock*, std::unordered_map<int, llvm::WeakTrackingVH>> current_def;
+    std::unordered_map<llvm::BasicBlock*, std::vector<std::pair<int, llvm::PHINode*>>> incomplete_phis;
+    std::set<llvm::BasicBlock*> sealed_blocks;
+    std::set<int> address_taken;
+
+    // control flow, innermost last
+    std::vector<llvm::BasicBlock*> break_targets;
+    std::vector<llvm::BasicBlock*> continue_targets;
+    int switch_depth = 0;
+    bool jump_tables = false;       // dispatch dense switches through a table, see SwitchStatement::codegen
+};
+
+// Owns all state for compiling a single source file, so that several files
+// can be compiled at once on different threads. The instance a thread is
+// working on is made active with set_active(); the passes pick up their
+// tables from active().
+class CompilerInstance {
+private:
+    string filename;
+    SourceManager sources;
+    const SourceFile* source = nullptr;     // set by parse()
+    InternPool pool;                    // must outlive the AST
+    ast::TranslationUnit* tu;
+
+    static thread_local CompilerInstance* current;
+
+public:
+    SymbolTable symbols;                // scopify
+    RecordTable records;                // struct and union layouts, filled in by scopify
+    CodegenState codegen;
+    TimeReport time_report;
+    ehdl::DiagnosticSink diags;         // of every pass, printed by the driver
+
+    CompilerInstance(const string& filename);
+    ~CompilerInstance();
+    CompilerInstance(const CompilerInstance&) = delete;
+    CompilerInstance& operator=(const CompilerInstance&) = delete;
+
+    // maps the file without parsing it, false if it cannot be opened
+    bool load();
+    // runs the reentrant scanner and parser over the file, returns false on
+    // a syntax error or if the file cannot be opened
+    bool parse();
+
+    const string& get_filename() const { return filename; }
+    const SourceFile* get_source() const { return source; }
+    ast::TranslationUnit* get_tu() { return tu; }
+
+    static CompilerInstance* active();
+    static void set_active(CompilerInstance* instance);
+};
+
+#endif
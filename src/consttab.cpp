@@ -1,70 +1,101 @@
-#include <iostream>
+#include <cstring>
 #include "consttab.hpp"
 
 using namespace std;
 
-ast::Literal* ConstTable::get_value(int idx){
-    if(value_map.find(idx) != value_map.end()){
-        if (value_map[idx].pointer_exists){
-            return nullptr;
-        }
-        return value_map[idx].Value;
-    }
-    return nullptr;
+LatticeValue LatticeValue::undef() {
+    return LatticeValue();
 }
 
-void ConstTable::clear_values(){
-    for(auto i: value_map){
-        value_map[i.first].Value = nullptr;
-    }
+LatticeValue LatticeValue::constant(ast::Literal* lit) {
+    LatticeValue val;
+    val.state = LATTICE_CONST;
+    val.lit = lit;
+    return val;
 }
 
-
-void ConstTable::clear_table(){
-    value_map.clear();
+LatticeValue LatticeValue::overdefined() {
+    LatticeValue val;
+    val.state = LATTICE_OVERDEF;
+    return val;
 }
 
-void ConstTable::invalidate_value(int idx){
-    if(value_map.find(idx) != value_map.end()){
-        value_map[idx].Value = nullptr;
+// same type and same bits; 0.0 and -0.0 are different constants
+static bool same_literal(ast::Literal* a, ast::Literal* b) {
+    if (a == b) return true;            // mostly pooled literals
+    if (a->ltype != b->ltype) return false;
+    switch (a->ltype) {
+        case ast::LT_FLOAT: return memcmp(&a->data.f, &b->data.f, sizeof(float)) == 0;
+        case ast::LT_DOUBLE: return memcmp(&a->data.d, &b->data.d, sizeof(double)) == 0;
+        case ast::LT_STRING: return a->value == b->value;
+        default: return a->data.l == b->data.l;
     }
+}
 
+bool LatticeValue::operator==(const LatticeValue& other) const {
+    if (state != other.state) return false;
+    return state != LATTICE_CONST || same_literal(lit, other.lit);
 }
 
+LatticeValue LatticeValue::meet(const LatticeValue& other) const {
+    if (state == LATTICE_UNDEF) return other;
+    if (other.state == LATTICE_UNDEF) return *this;
+    if (state == LATTICE_CONST && other.state == LATTICE_CONST && same_literal(lit, other.lit)) {
+        return *this;
+    }
+    return overdefined();
+}
 
-void ConstTable::pointer_taken(int idx){
-    // cout << "VALUE REMOVED" << endl;
-    if(value_map.find(idx) != value_map.end()){
-        value_map[idx].Value = nullptr;
-        value_map[idx].pointer_exists = 1;
+// bits identifying the value of lit: data.l as normalize_literal leaves it,
+// or the bit pattern of a float
+static long literal_bits(const ast::Literal* lit) {
+    long bits = 0;
+    switch (lit->ltype) {
+        case ast::LT_CHAR: return lit->data.c;
+        case ast::LT_SHORT: return lit->data.s;
+        case ast::LT_INT32: return lit->data.i;
+        case ast::LT_UINT32: return (unsigned int) lit->data.i;
+        case ast::LT_FLOAT: memcpy(&bits, &lit->data.f, sizeof(float)); return bits;
+        case ast::LT_DOUBLE: memcpy(&bits, &lit->data.d, sizeof(double)); return bits;
+        default: return lit->data.l;
     }
 }
 
-bool ConstTable::is_constant(int idx){
-    if(value_map.find(idx) != value_map.end()){
-        // cout<<"FOUND\n";
-        if (value_map[idx].pointer_exists){
-            return false;
-        }
-        if (value_map[idx].Value){
-            // cout<<"FOUND\n";
-            return true;
-        }
+ast::Literal* LiteralPool::get(const ast::Literal* lit) {
+    if (lit->interned) return const_cast<ast::Literal*>(lit);
+    return get(lit->ltype, literal_bits(lit));
+}
+
+ast::Literal* LiteralPool::get(ast::LiteralType ltype, long value) {
+    ast::Literal*& lit = literals[{ltype, value}];
+    if (!lit) {
+        lit = new ast::Literal(0L, ltype);
+        if (ltype == ast::LT_FLOAT) memcpy(&lit->data.f, &value, sizeof(float));
+        else lit->data.l = value;
+        lit->interned = true;
     }
-    return false;
+    return lit;
 }
 
-void ConstTable::update_value(int idx, ast::Literal* value){
-    if(value_map.find(idx) != value_map.end()){
-        if (!value_map[idx].pointer_exists){
-            value_map[idx].Value = value;
-            return;
-        }
-        else{
-            value_map[idx].Value = nullptr;
-            return;
+LatticeValue ConstEnv::get_value(int idx) const {
+    auto it = value_map.find(idx);
+    if (it == value_map.end()) return LatticeValue::undef();
+    return it->second;
+}
+
+void ConstEnv::update_value(int idx, LatticeValue value) {
+    value_map[idx] = value;
+}
+
+bool ConstEnv::meet(const ConstEnv& other) {
+    bool changed = false;
+    for (auto& entry : other.value_map) {
+        LatticeValue old = get_value(entry.first);
+        LatticeValue val = old.meet(entry.second);
+        if (!(val == old)) {
+            value_map[entry.first] = val;
+            changed = true;
         }
     }
-    value_map[idx].Value = value;
-    return;
+    return changed;
 }
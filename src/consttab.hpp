@@ -1,32 +1,58 @@
 #ifndef CONSTTABLE
 #define CONSTTABLE
 
+#include <map>
 #include <unordered_map>
-#include <stack>
-#include <string>
 #include "ast.hpp"
 
 using namespace std;
 
-struct constant_info{
-    bool pointer_exists = false;
-    ast::Literal* Value = nullptr;
+enum LatticeState {
+    LATTICE_UNDEF,          // no definition has reached this point yet
+    LATTICE_CONST,          // every definition that reaches gives the same literal
+    LATTICE_OVERDEF         // not a compile time constant
 };
 
-class ConstTable {
+struct LatticeValue {
+    LatticeState state = LATTICE_UNDEF;
+    ast::Literal* lit = nullptr;        // only for LATTICE_CONST
+
+    static LatticeValue undef();
+    static LatticeValue constant(ast::Literal* lit);
+    static LatticeValue overdefined();
+
+    bool is_const() const { return state == LATTICE_CONST; }
+    bool operator==(const LatticeValue& other) const;
+    LatticeValue meet(const LatticeValue& other) const;
+};
+
+// Immutable literals, one per type and bit pattern, for the constants of a
+// function. Lattice values point at them, so equal constants usually compare
+// by pointer, and constant propagation copies them in place of what it folds.
+// Pooled literals never end up in the tree themselves.
+class LiteralPool {
 private:
-    std::unordered_map<int, constant_info> value_map;
+    std::map<std::pair<ast::LiteralType, long>, ast::Literal*> literals;
 
 public:
-    // ConstTable();
-    void update_value(int idx, ast::Literal* value);
-    void invalidate_value(int idx);
-    void pointer_taken(int idx);
-    ast::Literal* get_value(int idx);
-    bool is_constant(int idx);
-    void clear_values();
-    void clear_table();
+    // pooled literal with the type and value of lit, lit itself if it is pooled
+    ast::Literal* get(const ast::Literal* lit);
+    ast::Literal* get(ast::LiteralType ltype, long value);
+    size_t size() const { return literals.size(); }
 };
 
-#endif 
+// Lattice values of the propagated locals at one point of the CFG. Locals
+// without an entry are undef. Literals held here are pooled or belong to the
+// tree; the folding routines only modify copies.
+class ConstEnv {
+private:
+    std::unordered_map<int, LatticeValue> value_map;
+
+public:
+    LatticeValue get_value(int idx) const;
+    void update_value(int idx, LatticeValue value);
+    // meets other into this environment, returns true if anything changed
+    bool meet(const ConstEnv& other);
+};
 
+#endif
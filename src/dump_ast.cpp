@@ -39,7 +39,7 @@ string listify(std::vector<T*>& nodes, string prefix) {
 
 string Identifier::dump_ast(string prefix) {
   cdebug << "Identifier::dump_ast: " << endl;
-  return name + "[" + to_string(ident_info.idx) + "]";
+  return *name + "[" + to_string(ident_info.idx) + "]";
 }
 
 string TernaryExpression::dump_ast(string prefix) {
@@ -83,15 +83,34 @@ string UnaryExpression::dump_ast(string prefix) {
          "`- expr: " + expr->dump_ast(prefix + "   ");
 }
 
+string SubscriptExpression::dump_ast(string prefix) {
+  cdebug << "SubscriptExpression::dump_ast: " << endl;
+  return "subscript\n" + prefix +
+         "`- base: " + base->dump_ast(prefix + "|  ") + "\n" + prefix +
+         "`- index: " + index->dump_ast(prefix + "   ");
+}
+
+string MemberExpression::dump_ast(string prefix) {
+  cdebug << "MemberExpression::dump_ast: " << endl;
+  return string(arrow ? "->" : ".") + *field + "\n" + prefix +
+         "`- base: " + base->dump_ast(prefix + "   ");
+}
+
+string TypeName::dump_ast(string prefix) {
+  cdebug << "TypeName::dump_ast: " << endl;
+  return starify(ptr_depth, "type") + "\n" + prefix +
+         "`- declspec: " + decl_specs->dump_ast(prefix + "   ");
+}
+
 string Literal::dump_ast(string prefix) {
   cdebug << "Literal::dump_ast: " << endl;
-  if (value == "") {
+  if (!value) {
     string s = to_string(data.l);
     if (ltype == LT_DOUBLE) s = to_string(data.d);
     else if (ltype == LT_FLOAT) s = to_string(data.f);
     return lt2str(ltype) + " (" + s + ")";
   }
-  return "literal (" + value + ")";
+  return "literal (" + *value + ")";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -125,13 +144,26 @@ string DeclarationSpecifiers::dump_ast(string prefix) {
       s << fs2str(fs) << " ";
     }
   }
+  if (record_spec) {
+    s << "\n" << prefix << "`- record: " << record_spec->dump_ast(prefix + "   ");
+  }
+  return s.str();
+}
+
+string RecordSpecifier::dump_ast(string prefix) {
+  cdebug << "RecordSpecifier::dump_ast: " << endl;
+  stringstream s;
+  s << (keyword == TS_UNION ? "union " : "struct ") << (tag ? *tag : "<anonymous>");
+  if (fields) {
+    s << listify(*fields, prefix);
+  }
   return s.str();
 }
 
 string PureDeclaration::dump_ast(string prefix) {
   cdebug << "PureDeclaration::dump_ast: " << endl;
   stringstream s;
-  s << starify(ptr_depth, ident->name) << "\n" << prefix
+  s << starify(ptr_depth, *ident->name) << "\n" << prefix
     << "`- declspec: " << decl_specs->dump_ast(prefix + "   ");
   return s.str();
 }
@@ -149,7 +181,10 @@ string FunctionParameterList::dump_ast(string prefix) {
 string InitDeclarator::dump_ast(string prefix) {
   cdebug << "InitDeclarator::dump_ast: " << endl;
   stringstream s;
-  s << starify(ptr_depth, ident->name);
+  s << starify(ptr_depth, *ident->name);
+  if (array_size) {
+    s << "\n" << prefix << "`- array_size: " << array_size->dump_ast(prefix + "   ");
+  }
   if (init_expr) {
     s << "\n" << prefix << "`- init: " << init_expr->dump_ast(prefix + "   ");
   }
@@ -209,12 +244,23 @@ string IfStatement::dump_ast(string prefix) {
 
 string SwitchStatement::dump_ast(string prefix) {
   cdebug << "SwitchStatement::dump_ast: " << endl;
-  return "dump_ast not implemented for switch";
+  stringstream ss;
+  ss << "switch\n" << prefix << "`- expr: " << expr->dump_ast(prefix + "| ") << "\n"
+     << prefix << "`- stmt: " << stmt->dump_ast(prefix + " ");
+  return ss.str();
 }
 
 string CaseStatement::dump_ast(string prefix) {
   cdebug << "CaseStatement::dump_ast: " << endl;
-  return "dump_ast not implemented for case";
+  stringstream ss;
+  if (const_expr) {
+    ss << "case\n" << prefix << "`- label: " << const_expr->dump_ast(prefix + "| ") << "\n";
+  }
+  else {
+    ss << "default\n";
+  }
+  ss << prefix << "`- stmt: " << stmt->dump_ast(prefix + " ");
+  return ss.str();
 }
 
 string WhileStatement::dump_ast(string prefix) {
@@ -239,6 +285,17 @@ string DoWhileStatement::dump_ast(string prefix) {
   return ss.str();
 }
 
+string ForStatement::dump_ast(string prefix) {
+  cdebug << "ForStatement::dump_ast: " << endl;
+  stringstream ss;
+  ss << "for\n" << prefix << "`- init: " << init->dump_ast(prefix + "| ") << "\n";
+  if (cond) ss << prefix << "`- cond: " << cond->dump_ast(prefix + "| ") << "\n";
+  if (step) ss << prefix << "`- step: " << step->dump_ast(prefix + "| ") << "\n";
+  if (stmt) ss << prefix << "`- stmt: " << stmt->dump_ast(prefix + " ");
+  else ss << prefix << "`- stmt: removed";
+  return ss.str();
+}
+
 string ReturnStatement::dump_ast(string prefix) {
   cdebug << "ReturnStatement::dump_ast: " << endl;
   if (ret_expr)
@@ -249,7 +306,7 @@ string ReturnStatement::dump_ast(string prefix) {
 
 string LabeledStatement::dump_ast(string prefix) {
   cdebug << "LabeledStatement::dump_ast: " << endl;
-  return label->name + "\n" + prefix + stmt->dump_ast(prefix + "   ");
+  return *label->name + "\n" + prefix + stmt->dump_ast(prefix + "   ");
 }
 
 string BreakStatement::dump_ast(string prefix) {
@@ -264,7 +321,7 @@ string ContinueStatement::dump_ast(string prefix) {
 
 string GotoStatement::dump_ast(string prefix) {
   cdebug << "GotoStatement::dump_ast: " << endl;
-  return "goto " + label;
+  return "goto " + *label;
 }
 
 string BlockStatement::dump_ast(string prefix) {
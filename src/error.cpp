@@ -1,10 +1,10 @@
 #include "error.hpp"
+#include "source.hpp"
 
-#include <stack>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <sstream>
-#include <fstream>
 
 #define C_HEADER "\033[95m"
 #define C_OKBLUE "\033[94m"
@@ -21,79 +21,142 @@ namespace ehdl {
 const int MAX_ERR = 5;
 const int MAX_WARN = 100;
 
-static stack<string> errors;
-static stack<string> warnings;
-static string filename = "translation_unit";
-static vector<string> filebuf;
+struct DiagInfo {
+  const char* name;
+  Severity severity;
+  const char* format;
+};
 
-std::string construct_code_display(ast::sympos pos) {
+static const DiagInfo diag_info[] = {
+#define DIAG(id, severity, format) {#id, severity, format},
+#include "diagnostics.def"
+#undef DIAG
+};
+
+thread_local DiagnosticSink* DiagnosticSink::current = nullptr;
+
+static std::string format_message(const Diagnostic& d) {
+  string message;
+  for (const char* f = diag_info[d.id].format; *f; f++) {
+    if (f[0] == '%' && isdigit(f[1]) && f[1] - '0' < d.args.size()) {
+      message += d.args[f[1] - '0'];
+      f++;
+    }
+    else message += *f;
+  }
+  return message;
+}
+
+// E_UNDECLARED_IDENTIFIER is undeclared-identifier
+static std::string json_id(DiagId id) {
+  string name = diag_info[id].name + 2;
+  for (char& c : name) c = (c == '_') ? '-' : tolower(c);
+  return name;
+}
+
+static std::string json_string(const string& s) {
+  stringstream out;
+  out << '"';
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') out << '\\' << c;
+    else if (c == '\n') out << "\\n";
+    else if (c == '\t') out << "\\t";
+    else if (c < 0x20) {
+      static const char* hex = "0123456789abcdef";
+      out << "\\u00" << hex[c >> 4] << hex[c & 15];
+    }
+    else out << c;
+  }
+  out << '"';
+  return out.str();
+}
+
+static std::string construct_location(const string& name, const SourceFile* source, ast::sympos pos) {
+  stringstream s;
+  if (!source || pos.end > source->text().size()) return name;
+  auto [line, column] = source->line_col(pos.begin);
+  s << source->get_name() << ":" << line << ":" << column;
+  return s.str();
+}
+
+static std::string construct_code_display(const SourceFile* source, ast::sympos pos) {
   stringstream s;
-  s << filebuf[pos.first_line-1] << endl;
+  // nodes built outside the parser have no line to show
+  if (!source || pos.end > source->text().size()) return s.str();
+  auto [line, column] = source->line_col(pos.begin);
+  string_view text = source->line(line);
+  s << text << endl;
   int i;
-  for (i=1; i<pos.first_column; i++) {
+  for (i=1; i<column; i++) {
     s << " ";
   }
   s << C_OKGREEN << "^";
-  if (pos.last_line != pos.first_line) return s.str();
-  for (i+=1; i<=pos.last_column; i++) {
+  if (column - 1 + (pos.end - pos.begin) > text.size()) return s.str();
+  for (i=1; i<pos.end-pos.begin; i++) {
     s << "~";
   }
   return s.str();
 }
 
-void err(string message, ast::sympos pos) {
-  if (errors.size() > MAX_ERR) {
-    print_errs();
-    cout << "Error limit reached, stopping emitting errors" << endl;
-    exit(0);
-  }
-  stringstream s;
-  s << C_BOLD << filename << ":" << pos.first_line << ":" << pos.first_column << ": " << C_FAIL << "error: " << C_ENDC << C_BOLD << message << C_ENDC << endl;
-  s << construct_code_display(pos) << C_ENDC << endl;
-  errors.push(s.str());
+void DiagnosticSink::report(DiagId id, ast::sympos pos, vector<string> args) {
+  if (diag_info[id].severity == SEV_ERROR) n_errors++;
+  diags.push_back({id, pos, std::move(args)});
 }
 
-void warn(string message, ast::sympos pos) {
-  if (warnings.size() > MAX_ERR) {
-    print_warns();
-    cout << "Warning limit reached, stopping emitting warnings" << endl;
-    return;
-  }
-  stringstream s;
-  s << C_BOLD << filename << ":" << pos.first_line << ":" << pos.first_column << ": " << C_WARNING << "warning: " << C_ENDC << C_BOLD << message << C_ENDC << endl;
-  s << construct_code_display(pos) << C_ENDC << endl;
-  warnings.push(s.str());
+void DiagnosticSink::append(DiagnosticSink& other) {
+  diags.insert(diags.end(), std::make_move_iterator(other.diags.begin()), std::make_move_iterator(other.diags.end()));
+  n_errors += other.n_errors;
+  other.diags.clear();
+  other.n_errors = 0;
 }
 
-int n_errs() { return errors.size(); }
-int n_warns() { return warnings.size(); }
+void DiagnosticSink::print(ostream& os, DiagnosticFormat format) const {
+  // reported diagnostics follow the passes, printed ones follow the source
+  vector<const Diagnostic*> order;
+  for (auto& d : diags) order.push_back(&d);
+  stable_sort(order.begin(), order.end(), [](const Diagnostic* a, const Diagnostic* b) {
+    return a->pos.begin < b->pos.begin;
+  });
 
-void print_errs() {
-  while (!errors.empty()) {
-    cout << errors.top();
-    errors.pop();
-  }
-}
+  string name = source ? source->get_name() : this->name;
+  int n_errs = 0, n_warns = 0;
+  for (const Diagnostic* d : order) {
+    const DiagInfo& info = diag_info[d->id];
+    int line = 0, column = 0;
+    if (source && d->pos.end <= source->text().size()) std::tie(line, column) = source->line_col(d->pos.begin);
+
+    if (format == DF_JSON) {
+      // one object per line, so the output of several units can be interleaved
+      os << "{\"file\": " << json_string(name) << ", \"line\": " << line << ", \"column\": " << column
+         << ", \"offset\": " << (line ? d->pos.begin : 0) << ", \"length\": " << d->pos.end - d->pos.begin
+         << ", \"severity\": \"" << (info.severity == SEV_ERROR ? "error" : "warning") << "\""
+         << ", \"id\": " << json_string(json_id(d->id)) << ", \"message\": " << json_string(format_message(*d)) << "}" << endl;
+      continue;
+    }
 
-void print_warns() {
-  while (!warnings.empty()) {
-    cout << warnings.top();
-    warnings.pop();
+    if (info.severity == SEV_ERROR && ++n_errs > MAX_ERR) {
+      if (n_errs == MAX_ERR + 1) os << "Error limit reached, stopping emitting errors" << endl;
+      continue;
+    }
+    if (info.severity == SEV_WARNING && ++n_warns > MAX_WARN) {
+      if (n_warns == MAX_WARN + 1) os << "Warning limit reached, stopping emitting warnings" << endl;
+      continue;
+    }
+    os << C_BOLD << construct_location(name, source, d->pos) << ": "
+       << (info.severity == SEV_ERROR ? C_FAIL "error: " : C_WARNING "warning: ") << C_ENDC
+       << C_BOLD << format_message(*d) << C_ENDC << endl;
+    string code = construct_code_display(source, d->pos);
+    if (!code.empty()) os << code << C_ENDC << endl;
   }
 }
 
-void set_filename(string name) {
-  filename = name;
-  filebuf.clear();
-  std::fstream file;
-  file.open(name,std::ios::in);
-
-  std::string str;
-  while(getline(file, str))
-  {
-    filebuf.push_back(str);
-  }
+DiagnosticSink& DiagnosticSink::active() {
+  static thread_local DiagnosticSink fallback;
+  return current ? *current : fallback;
 }
 
+void DiagnosticSink::set_active(DiagnosticSink* sink) {
+  current = sink;
 }
 
+}
@@ -1,16 +1,66 @@
 #pragma once
 
-#include <stack>
+#include <iostream>
 #include <string>
+#include <vector>
 #include "ast.hpp"
 using namespace std;
 
+class SourceFile;
+
 namespace ehdl {
-void err(string message, ast::sympos pos);
-void warn(string message, ast::sympos pos);
-void print_errs();
-void print_warns();
-void set_filename(string filename);
-int n_errs();
-int n_warns();
+
+enum Severity { SEV_ERROR, SEV_WARNING };
+
+enum DiagId {
+#define DIAG(id, severity, format) id,
+#include "diagnostics.def"
+#undef DIAG
+  NUM_DIAGS
+};
+
+enum DiagnosticFormat { DF_TEXT, DF_JSON };
+
+// position of diagnostics about the unit as a whole, printed without a line
+const ast::sympos NO_POS = {UINT32_MAX, UINT32_MAX};
+
+// A diagnostic as it is reported. It is only formatted and placed in the
+// source when it is printed, which is rare, so reporting one stays cheap.
+struct Diagnostic {
+  DiagId id;
+  ast::sympos pos;
+  vector<string> args;
+};
+
+// The diagnostics of one unit. A CompilerInstance owns one and makes it the
+// active sink of the thread compiling it; threads that help with a unit
+// report into sinks of their own, which are appended to the unit's.
+class DiagnosticSink {
+private:
+  const SourceFile* source = nullptr;
+  string name = "translation_unit";     // until the source is loaded
+  vector<Diagnostic> diags;
+  int n_errors = 0;
+
+  static thread_local DiagnosticSink* current;
+
+public:
+  void set_name(const string& filename) { name = filename; }
+  void set_source(const SourceFile* file) { source = file; }
+  void report(DiagId id, ast::sympos pos, vector<string> args);
+  void append(DiagnosticSink& other);       // moves the other sink's diagnostics here
+
+  int n_errs() const { return n_errors; }
+  int n_warns() const { return diags.size() - n_errors; }
+
+  // prints all diagnostics in source order, text stops after a few errors
+  void print(ostream& os, DiagnosticFormat format) const;
+
+  static DiagnosticSink& active();
+  static void set_active(DiagnosticSink* sink);
+};
+
+inline void report(DiagId id, ast::sympos pos, vector<string> args = {}) {
+  DiagnosticSink::active().report(id, pos, std::move(args));
+}
 }
@@ -0,0 +1,25 @@
+#include "intern.hpp"
+#include "timer.hpp"
+
+thread_local InternPool* InternPool::current = nullptr;
+
+istring InternPool::intern(std::string_view s) {
+  auto it = lookup.find(s);
+  if (it != lookup.end()) {
+    return it->second;
+  }
+  count_alloc();
+  storage.emplace_back(s);
+  istring handle = &storage.back();
+  lookup.emplace(*handle, handle);
+  return handle;
+}
+
+InternPool& InternPool::active() {
+  static thread_local InternPool fallback;
+  return current ? *current : fallback;
+}
+
+void InternPool::set_active(InternPool* pool) {
+  current = pool;
+}
@@ -0,0 +1,34 @@
+#ifndef INTERN
+#define INTERN
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std;
+
+// Handle to a string stored once in an InternPool. Equal strings always get
+// the same handle, so handles are compared and hashed as plain pointers.
+typedef const std::string* istring;
+
+class InternPool {
+private:
+    std::deque<std::string> storage;                // stable addresses
+    std::unordered_map<std::string_view, istring> lookup;   // keys view into storage
+
+    static thread_local InternPool* current;
+
+public:
+    istring intern(std::string_view s);
+    size_t size() const { return storage.size(); }
+
+    // pool shared by the lexer and all later passes of the unit being
+    // compiled on this thread
+    static InternPool& active();
+    static void set_active(InternPool* pool);
+};
+
+inline istring intern(std::string_view s) { return InternPool::active().intern(s); }
+
+#endif
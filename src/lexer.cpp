@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <cstring>
+#include "lexer.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+void yyerror(YYLTYPE* loc, ast::TranslationUnit* tu, yyscan_t scanner, const char *s);     // c.y
+
+// the character classes of c.l
+static inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\v' || c == '\f'; }
+static inline bool is_space(char c) { return c == ' ' || (unsigned char)(c - '\t') < 4; }
+static inline bool is_digit(char c) { return (unsigned char)(c - '0') < 10; }
+static inline bool is_octal(char c) { return (unsigned char)(c - '0') < 8; }
+static inline bool is_hex(char c) { return is_digit(c) || (unsigned char)((c | 0x20) - 'a') < 6; }
+static inline bool is_alpha(char c) { return (unsigned char)((c | 0x20) - 'a') < 26 || c == '_'; }
+static inline bool is_ident(char c) { return is_alpha(c) || is_digit(c); }
+
+// Byte compares of a whole vector. There are no unsigned byte compares
+// before AVX-512, but the classes are all ASCII, and bytes from 0x80 up
+// compare as negative, so they never fall in a range.
+#if defined(__AVX2__)
+#define VEC 32
+typedef __m256i vec;
+static inline vec load(const char* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline vec splat(char c) { return _mm256_set1_epi8(c); }
+static inline vec eq(vec a, vec b) { return _mm256_cmpeq_epi8(a, b); }
+static inline vec gt(vec a, vec b) { return _mm256_cmpgt_epi8(a, b); }
+static inline vec vand(vec a, vec b) { return _mm256_and_si256(a, b); }
+static inline vec vor(vec a, vec b) { return _mm256_or_si256(a, b); }
+static inline uint32_t bits(vec a) { return _mm256_movemask_epi8(a); }
+static const uint32_t ALL = 0xFFFFFFFF;
+#elif defined(__SSE2__)
+#define VEC 16
+typedef __m128i vec;
+static inline vec load(const char* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline vec splat(char c) { return _mm_set1_epi8(c); }
+static inline vec eq(vec a, vec b) { return _mm_cmpeq_epi8(a, b); }
+static inline vec gt(vec a, vec b) { return _mm_cmpgt_epi8(a, b); }
+static inline vec vand(vec a, vec b) { return _mm_and_si128(a, b); }
+static inline vec vor(vec a, vec b) { return _mm_or_si128(a, b); }
+static inline uint32_t bits(vec a) { return _mm_movemask_epi8(a); }
+static const uint32_t ALL = 0xFFFF;
+#endif
+
+#ifdef VEC
+static inline vec in_range(vec v, char lo, char hi) {
+  return vand(gt(v, splat(lo - 1)), gt(splat(hi + 1), v));
+}
+#endif
+
+// The scans below only load whole vectors that end inside the file, which
+// is mapped and has nothing readable after it; the rest goes byte by byte.
+
+static const char* skip_space(const char* p, const char* end) {
+#ifdef VEC
+  for (; end - p >= VEC; p += VEC) {
+    vec v = load(p);
+    uint32_t m = bits(vor(eq(v, splat(' ')), in_range(v, '\t', '\f')));
+    if (m != ALL) return p + __builtin_ctz(~m);
+  }
+#endif
+  while (p < end && is_space(*p)) p++;
+  return p;
+}
+
+static const char* skip_ident(const char* p, const char* end) {
+#ifdef VEC
+  for (; end - p >= VEC; p += VEC) {
+    vec v = load(p);
+    vec alpha = in_range(vor(v, splat(0x20)), 'a', 'z');
+    uint32_t m = bits(vor(vor(alpha, in_range(v, '0', '9')), eq(v, splat('_'))));
+    if (m != ALL) return p + __builtin_ctz(~m);
+  }
+#endif
+  while (p < end && is_ident(*p)) p++;
+  return p;
+}
+
+// the first c at or after p, or end
+static const char* find_char(const char* p, const char* end, char c) {
+#ifdef VEC
+  for (; end - p >= VEC; p += VEC) {
+    uint32_t m = bits(eq(load(p), splat(c)));
+    if (m) return p + __builtin_ctz(m);
+  }
+#endif
+  while (p < end && *p != c) p++;
+  return p;
+}
+
+// the "*/" at or after p, or end
+static const char* find_comment_end(const char* p, const char* end) {
+#ifdef VEC
+  for (; end - p > VEC; p += VEC) {
+    uint32_t m = bits(vand(eq(load(p), splat('*')), eq(load(p + 1), splat('/'))));
+    if (m) return p + __builtin_ctz(m);
+  }
+#endif
+  for (; end - p >= 2; p++) {
+    if (p[0] == '*' && p[1] == '/') return p;
+  }
+  return end;
+}
+
+// Keywords by a perfect hash of their first and last character and length,
+// so a lookup is one probe and one compare. The table is built at compile
+// time and a collision fails the build.
+struct Keyword {
+  const char* name;
+  size_t len;
+  int token;
+};
+
+static constexpr Keyword keyword_list[] = {
+  {"auto", 4, AUTO}, {"break", 5, BREAK}, {"case", 4, CASE}, {"char", 4, CHAR},
+  {"const", 5, CONST}, {"continue", 8, CONTINUE}, {"default", 7, DEFAULT}, {"do", 2, DO},
+  {"double", 6, DOUBLE}, {"else", 4, ELSE}, {"enum", 4, ENUM}, {"extern", 6, EXTERN},
+  {"float", 5, FLOAT}, {"for", 3, FOR}, {"goto", 4, GOTO}, {"if", 2, IF},
+  {"inline", 6, INLINE}, {"int", 3, INT}, {"long", 4, LONG}, {"register", 8, REGISTER},
+  {"restrict", 8, RESTRICT}, {"return", 6, RETURN}, {"short", 5, SHORT}, {"signed", 6, SIGNED},
+  {"sizeof", 6, SIZEOF}, {"static", 6, STATIC}, {"struct", 6, STRUCT}, {"switch", 6, SWITCH},
+  {"typedef", 7, TYPEDEF}, {"union", 5, UNION}, {"unsigned", 8, UNSIGNED}, {"void", 4, VOID},
+  {"volatile", 8, VOLATILE}, {"while", 5, WHILE}, {"_Alignas", 8, ALIGNAS}, {"_Alignof", 8, ALIGNOF},
+  {"_Atomic", 7, ATOMIC}, {"_Bool", 5, BOOL}, {"_Complex", 8, COMPLEX}, {"_Generic", 8, GENERIC},
+  {"_Imaginary", 10, IMAGINARY}, {"_Noreturn", 9, NORETURN}, {"_Static_assert", 14, STATIC_ASSERT},
+  {"_Thread_local", 13, THREAD_LOCAL}, {"__func__", 8, FUNC_NAME},
+};
+
+static constexpr unsigned keyword_hash(const char* s, size_t len) {
+  return ((unsigned char)s[0] * 10 + (unsigned char)s[len - 1] * 3 + len) & 127;
+}
+
+struct KeywordTable {
+  Keyword slots[128];
+
+  constexpr KeywordTable(): slots{} {
+    for (const Keyword& kw : keyword_list) {
+      Keyword& slot = slots[keyword_hash(kw.name, kw.len)];
+      if (slot.name) throw "keyword hash collision";
+      slot = kw;
+    }
+  }
+};
+
+static constexpr KeywordTable keywords;
+
+static int keyword(const char* s, size_t len) {
+  if (len < 2 || len > 14) return 0;
+  const Keyword& kw = keywords.slots[keyword_hash(s, len)];
+  return (kw.len == len && memcmp(kw.name, s, len) == 0) ? kw.token : 0;
+}
+
+Lexer::Lexer(const SourceFile* file) {
+  base = p = file->text().data();
+  end = base + file->text().size();
+}
+
+int Lexer::token(YYLTYPE* lloc, const char* start, int tok) {
+  lloc->begin = start - base;
+  lloc->end = p - base;
+  return tok;
+}
+
+int Lexer::value_token(YYSTYPE* lval, YYLTYPE* lloc, const char* start, int tok) {
+  lval->str = intern(std::string_view(start, p - start));
+  return token(lloc, start, tok);
+}
+
+// The match_ functions return the end of the longest match of a rule of
+// c.l at q, or q if there is none.
+
+// "#"{WS}*"pragma"{WS}+("unroll"|"nounroll"|"vectorize"|"novectorize")[^\n]*
+const char* Lexer::match_pragma(const char* q) const {
+  static const char* hints[] = {"unroll", "nounroll", "vectorize", "novectorize"};
+  const char* s = q + 1;
+  while (is_blank(at(s))) s++;
+  if (end - s < 6 || memcmp(s, "pragma", 6) != 0) return q;
+  s += 6;
+  if (!is_blank(at(s))) return q;
+  while (is_blank(at(s))) s++;
+  for (const char* hint : hints) {
+    size_t len = strlen(hint);
+    if (end - s >= len && memcmp(s, hint, len) == 0) return find_char(s + len, end, '\n');
+  }
+  return q;
+}
+
+// {HP}{H}+{IS}?, {NZ}{D}*{IS}? and "0"{O}*{IS}?
+const char* Lexer::match_int(const char* q) const {
+  const char* s = q;
+  if (at(s) == '0' && (at(s + 1) == 'x' || at(s + 1) == 'X') && is_hex(at(s + 2))) {
+    for (s += 2; is_hex(at(s)); s++);
+  }
+  else if (at(s) == '0') {
+    for (s++; is_octal(at(s)); s++);
+  }
+  else if (is_digit(at(s))) {
+    for (s++; is_digit(at(s)); s++);
+  }
+  else return q;
+
+  // (u|U)(l|L|ll|LL)? or (l|L|ll|LL)(u|U)?
+  bool is_unsigned = (at(s) == 'u' || at(s) == 'U');
+  if (is_unsigned) s++;
+  if ((at(s) == 'l' && at(s + 1) == 'l') || (at(s) == 'L' && at(s + 1) == 'L')) s += 2;
+  else if (at(s) == 'l' || at(s) == 'L') s++;
+  else return s;
+  if (!is_unsigned && (at(s) == 'u' || at(s) == 'U')) s++;
+  return s;
+}
+
+// the six floating constant rules of c.l, decimal and hex
+const char* Lexer::match_float(const char* q) const {
+  auto exponent = [this](const char* s, char e) {           // {E} or {P}, s if neither
+    if ((at(s) | 0x20) != e) return s;
+    const char* d = s + 1;
+    if (at(d) == '+' || at(d) == '-') d++;
+    if (!is_digit(at(d))) return s;
+    while (is_digit(at(d))) d++;
+    return d;
+  };
+  auto suffix = [this](const char* s) {                     // {FS}?
+    char c = at(s);
+    return (c == 'f' || c == 'F' || c == 'l' || c == 'L') ? s + 1 : s;
+  };
+
+  const char* best = q;
+  if (at(q) == '0' && (at(q + 1) == 'x' || at(q + 1) == 'X')) {
+    const char* h = q + 2;
+    while (is_hex(at(h))) h++;
+    bool digits = h > q + 2;
+    if (digits) {
+      const char* e = exponent(h, 'p');                     // {HP}{H}+{P}{FS}?
+      if (e > h) best = max(best, suffix(e));
+    }
+    if (at(h) == '.' && is_hex(at(h + 1))) {               // {HP}{H}*"."{H}+{P}{FS}?
+      const char* f = h + 1;
+      while (is_hex(at(f))) f++;
+      const char* e = exponent(f, 'p');
+      if (e > f) best = max(best, suffix(e));
+    }
+    if (digits && at(h) == '.') {                           // {HP}{H}+"."{P}{FS}?
+      const char* e = exponent(h + 1, 'p');
+      if (e > h + 1) best = max(best, suffix(e));
+    }
+    return best;
+  }
+
+  const char* d = q;
+  while (is_digit(at(d))) d++;
+  bool digits = d > q;
+  if (digits) {
+    const char* e = exponent(d, 'e');                       // {D}+{E}{FS}?
+    if (e > d) best = max(best, suffix(e));
+  }
+  if (at(d) == '.' && is_digit(at(d + 1))) {               // {D}*"."{D}+{E}?{FS}?
+    const char* f = d + 1;
+    while (is_digit(at(f))) f++;
+    best = max(best, suffix(exponent(f, 'e')));
+  }
+  if (digits && at(d) == '.') {                             // {D}+"."{E}?{FS}?
+    best = max(best, suffix(exponent(d + 1, 'e')));
+  }
+  return best;
+}
+
+// {ES}, a backslash and what it escapes; the digits past the first are also
+// ordinary characters of the constant, so they need not be part of it
+static const char* match_escape(const char* q, const char* end) {
+  if (end - q < 2) return q;
+  char c = q[1];
+  if (c && strchr("'\"?\\abfnrtv", c)) return q + 2;
+  if (is_octal(c)) return q + 2;
+  if (c == 'x' && end - q >= 3 && is_hex(q[2])) return q + 3;
+  return q;
+}
+
+// "'"([^'\\\n]|{ES})+"'", without its {CP}? prefix
+const char* Lexer::match_char(const char* q) const {
+  if (at(q) != '\'') return q;
+  const char* s = q + 1;
+  while (s < end && *s != '\'') {
+    if (*s == '\n') return q;
+    if (*s == '\\') {
+      const char* e = match_escape(s, end);
+      if (e == s) return q;
+      s = e;
+    }
+    else s++;
+  }
+  if (s == end || s == q + 1) return q;
+  return s + 1;
+}
+
+// \"([^"\\\n]|{ES})*\"
+const char* Lexer::match_string(const char* q) const {
+  if (at(q) != '"') return q;
+  const char* s = q + 1;
+  while (s < end && *s != '"') {
+    if (*s == '\n') return q;
+    if (*s == '\\') {
+      const char* e = match_escape(s, end);
+      if (e == s) return q;
+      s = e;
+    }
+    else s++;
+  }
+  if (s == end) return q;
+  return s + 1;
+}
+
+// ({SP}?\"([^"\\\n]|{ES})*\"{WS}*)+, so adjacent strings on a line are one
+// token, with the blanks after the last one
+const char* Lexer::match_strings(const char* q) const {
+  const char* last = q;
+  for (;;) {
+    const char* s = last;
+    if (at(s) == 'u' && at(s + 1) == '8') s += 2;
+    else if (at(s) == 'u' || at(s) == 'U' || at(s) == 'L') s++;
+    const char* e = match_string(s);
+    if (e == s) return last;
+    while (is_blank(at(e))) e++;
+    last = e;
+  }
+}
+
+// punctuators, longest first, and the digraphs of { } [ ]
+int Lexer::match_operator() {
+  char c = *p, c1 = at(p + 1), c2 = at(p + 2);
+  auto take = [this](int n, int tok) { p += n; return tok; };
+  switch (c) {
+    case ';': case ',': case '(': case ')': case '{': case '}':
+    case '[': case ']': case '~': case '?':
+      return take(1, c);
+    case '.':
+      if (c1 == '.' && c2 == '.') return take(3, ELLIPSIS);
+      return take(1, '.');
+    case '>':
+      if (c1 == '>' && c2 == '=') return take(3, RIGHT_ASSIGN);
+      if (c1 == '>') return take(2, RIGHT_OP);
+      if (c1 == '=') return take(2, GE_OP);
+      return take(1, '>');
+    case '<':
+      if (c1 == '<' && c2 == '=') return take(3, LEFT_ASSIGN);
+      if (c1 == '<') return take(2, LEFT_OP);
+      if (c1 == '=') return take(2, LE_OP);
+      if (c1 == '%') return take(2, '{');
+      if (c1 == ':') return take(2, '[');
+      return take(1, '<');
+    case '+':
+      if (c1 == '=') return take(2, ADD_ASSIGN);
+      if (c1 == '+') return take(2, INC_OP);
+      return take(1, '+');
+    case '-':
+      if (c1 == '=') return take(2, SUB_ASSIGN);
+      if (c1 == '-') return take(2, DEC_OP);
+      if (c1 == '>') return take(2, PTR_OP);
+      return take(1, '-');
+    case '*':
+      if (c1 == '=') return take(2, MUL_ASSIGN);
+      return take(1, '*');
+    case '/':
+      if (c1 == '=') return take(2, DIV_ASSIGN);
+      return take(1, '/');
+    case '%':
+      if (c1 == '=') return take(2, MOD_ASSIGN);
+      if (c1 == '>') return take(2, '}');
+      return take(1, '%');
+    case '&':
+      if (c1 == '=') return take(2, AND_ASSIGN);
+      if (c1 == '&') return take(2, AND_OP);
+      return take(1, '&');
+    case '^':
+      if (c1 == '=') return take(2, XOR_ASSIGN);
+      return take(1, '^');
+    case '|':
+      if (c1 == '=') return take(2, OR_ASSIGN);
+      if (c1 == '|') return take(2, OR_OP);
+      return take(1, '|');
+    case '=':
+      if (c1 == '=') return take(2, EQ_OP);
+      return take(1, '=');
+    case '!':
+      if (c1 == '=') return take(2, NE_OP);
+      return take(1, '!');
+    case ':':
+      if (c1 == '>') return take(2, ']');
+      return take(1, ':');
+  }
+  return 0;
+}
+
+int Lexer::next(YYSTYPE* lval, YYLTYPE* lloc) {
+  for (;;) {
+    p = skip_space(p, end);
+    if (p == end) return 0;
+    const char* start = p;
+    char c = *p;
+
+    if (c == '/' && at(p + 1) == '*') {
+      p = find_comment_end(p + 2, end);
+      if (p == end) {
+        YYLTYPE loc = {uint32_t(start - base), uint32_t(end - base)};
+        yyerror(&loc, nullptr, nullptr, "unterminated comment");
+        return 0;
+      }
+      p += 2;
+      continue;
+    }
+    if (c == '/' && at(p + 1) == '/') {
+      p = find_char(p + 2, end, '\n');
+      continue;
+    }
+    if (c == '#') {
+      const char* q = match_pragma(p);
+      if (q == p) {
+        p++;                        // any other directive is dropped like a bad character
+        continue;
+      }
+      p = q;
+      return value_token(lval, lloc, start, LOOP_PRAGMA);
+    }
+
+    if (is_alpha(c)) {
+      const char* q = skip_ident(p + 1, end);
+      size_t len = q - p;
+      bool prefix = len == 1 && (c == 'u' || c == 'U' || c == 'L');
+      if (prefix && at(q) == '\'') {
+        const char* lit = match_char(q);
+        if (lit != q) {
+          p = lit;
+          return value_token(lval, lloc, start, I_CONSTANT);
+        }
+      }
+      if ((prefix || (len == 2 && c == 'u' && p[1] == '8')) && at(q) == '"') {
+        const char* lit = match_strings(p);
+        if (lit != p) {
+          p = lit;
+          return value_token(lval, lloc, start, STRING_LITERAL);
+        }
+      }
+      p = q;
+      if (int tok = keyword(start, len)) return token(lloc, start, tok);
+      // c.l has no symbol table to find typedef names in either
+      return value_token(lval, lloc, start, IDENTIFIER);
+    }
+
+    if (is_digit(c) || (c == '.' && is_digit(at(p + 1)))) {
+      const char* int_end = match_int(p);
+      const char* float_end = match_float(p);
+      p = max(int_end, float_end);
+      return value_token(lval, lloc, start, float_end > int_end ? F_CONSTANT : I_CONSTANT);
+    }
+    if (c == '\'' || c == '"') {
+      const char* lit = (c == '\'') ? match_char(p) : match_strings(p);
+      if (lit == p) {
+        p++;
+        continue;
+      }
+      p = lit;
+      return value_token(lval, lloc, start, c == '\'' ? I_CONSTANT : STRING_LITERAL);
+    }
+
+    if (int tok = match_operator()) return token(lloc, start, tok);
+    p++;                            // a character no rule matches is dropped
+  }
+}
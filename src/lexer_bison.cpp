@@ -0,0 +1,19 @@
+#include "lexer.hpp"
+
+// The scanner interface the parser and CompilerInstance::parse use, for
+// builds with the hand-written Lexer instead of flex (make LEXER=hand).
+// Lexer reads the mapped file directly rather than through the reader.
+
+int yylex_init_extra(SourceReader* reader, yyscan_t* scanner) {
+  *scanner = new Lexer(reader->file);
+  return 0;
+}
+
+int yylex_destroy(yyscan_t scanner) {
+  delete (Lexer*)scanner;
+  return 0;
+}
+
+extern "C" int yylex(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, yyscan_t scanner) {
+  return ((Lexer*)scanner)->next(yylval_param, yylloc_param);
+}
@@ -0,0 +1,434 @@
+#include <set>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+#include "cfg.hpp"
+#include "debug.hpp"
+
+// Loop invariant code motion. For every while, do-while and for loop,
+// innermost first, the locals written anywhere in the loop (body, condition
+// and step) are collected; a subexpression that only reads locals outside
+// that set is computed once into a fresh local declared right before the
+// loop. Only expressions that cannot trap or have side effects are moved,
+// since the loop may run zero times.
+
+namespace ast {
+
+// state of the function being optimized
+struct LICMState {
+    std::set<int> address_taken;    // may change behind any pointer write
+    int next_idx = 0;               // first local index not used by the function
+    int n_hoisted = 0;
+};
+
+static thread_local LICMState* licm;
+
+struct LoopInfo {
+    std::set<int> written;
+    vector<Statement*> hoisted;     // declarations of the temporaries, in order
+};
+
+
+// locals written
+
+void Statement::find_writes(std::set<int>& written) {}
+
+void Expression::find_writes(std::set<int>& written) {}
+
+void TernaryExpression::find_writes(std::set<int>& written) {
+  cond->find_writes(written);
+  true_branch->find_writes(written);
+  false_branch->find_writes(written);
+}
+
+void FunctionInvocationExpression::find_writes(std::set<int>& written) {
+  if (params) {
+    for (auto param : *params) param->find_writes(written);
+  }
+}
+
+void BinaryExpression::find_writes(std::set<int>& written) {
+  Identifier* ident = dyn_cast<Identifier>(lhs);
+  switch (op) {
+    case OP_ASSIGN: case OP_MUL_ASSIGN: case OP_DIV_ASSIGN: case OP_MOD_ASSIGN:
+    case OP_ADD_ASSIGN: case OP_SUB_ASSIGN: case OP_LEFT_ASSIGN: case OP_RIGHT_ASSIGN:
+    case OP_AND_ASSIGN: case OP_XOR_ASSIGN: case OP_OR_ASSIGN:
+      if (ident) written.insert(ident->ident_info.idx);
+      break;
+    default:
+      break;
+  }
+  lhs->find_writes(written);
+  rhs->find_writes(written);
+}
+
+void SubscriptExpression::find_writes(std::set<int>& written) {
+  base->find_writes(written);
+  index->find_writes(written);
+}
+
+void MemberExpression::find_writes(std::set<int>& written) {
+  base->find_writes(written);
+}
+
+void UnaryExpression::find_writes(std::set<int>& written) {
+  Identifier* ident = dyn_cast<Identifier>(expr);
+  switch (op) {
+    case OP_PRE_INCR: case OP_PRE_DECR: case OP_POST_INCR: case OP_POST_DECR:
+      if (ident) written.insert(ident->ident_info.idx);
+      break;
+    default:
+      break;
+  }
+  expr->find_writes(written);
+}
+
+void DeclarationStatement::find_writes(std::set<int>& written) {
+  for (auto init_decl : *decl->decl_list) {
+    written.insert(init_decl->ident->ident_info.idx);
+    if (init_decl->init_expr) init_decl->init_expr->find_writes(written);
+  }
+}
+
+void ExpressionStatement::find_writes(std::set<int>& written) {
+  if (expr) expr->find_writes(written);
+}
+
+void IfStatement::find_writes(std::set<int>& written) {
+  cond->find_writes(written);
+  if (true_branch) true_branch->find_writes(written);
+  if (false_branch) false_branch->find_writes(written);
+}
+
+void SwitchStatement::find_writes(std::set<int>& written) {
+  expr->find_writes(written);
+  stmt->find_writes(written);
+}
+
+void CaseStatement::find_writes(std::set<int>& written) {
+  if (stmt) stmt->find_writes(written);
+}
+
+void WhileStatement::find_writes(std::set<int>& written) {
+  cond->find_writes(written);
+  if (stmt) stmt->find_writes(written);
+}
+
+void DoWhileStatement::find_writes(std::set<int>& written) {
+  cond->find_writes(written);
+  if (stmt) stmt->find_writes(written);
+}
+
+void ForStatement::find_writes(std::set<int>& written) {
+  init->find_writes(written);
+  if (cond) cond->find_writes(written);
+  if (step) step->find_writes(written);
+  if (stmt) stmt->find_writes(written);
+}
+
+void ReturnStatement::find_writes(std::set<int>& written) {
+  if (ret_expr) ret_expr->find_writes(written);
+}
+
+void BlockStatement::find_writes(std::set<int>& written) {
+  for (auto stmt : *this) stmt->find_writes(written);
+}
+
+
+// invariant expressions
+
+static SymbolType literal_type(Literal* lit) {
+  switch (lit->ltype) {
+    case LT_BOOL: return I1;
+    case LT_CHAR: return I8;
+    case LT_SHORT: return I16;
+    case LT_INT32: return I32;
+    case LT_INT64: return I64;
+    case LT_FLOAT: return FP32;
+    case LT_DOUBLE: return FP64;
+    default: return UNK;        // unsigned and string literals are not moved
+  }
+}
+
+static int type_rank(SymbolType st) {
+  switch (st) {
+    case I1: return 0;
+    case I8: return 1;
+    case I16: return 2;
+    case I32: return 3;
+    case I64: return 4;
+    case FP32: return 5;
+    case FP64: return 6;
+    default: return -1;
+  }
+}
+
+// an integer divisor that cannot trap whatever the dividend is
+static bool safe_divisor(Literal* divisor, SymbolType st) {
+  if (!divisor || !lit2bool(divisor)) return false;
+  bool is_signed = (st == I8 || st == I16 || st == I32 || st == I64);
+  // normalize_literal keeps data.l sign extended for every integer type
+  return !(is_signed && divisor->data.l == -1);
+}
+
+// Type codegen gives expr if it is loop invariant and safe to evaluate
+// early, UNK otherwise. Follows BinaryExpression::codegen: operands widen to
+// the higher rank, comparisons give a bool.
+static SymbolType invariant_type(Expression* expr, const LoopInfo& loop) {
+  if (Literal* lit = dyn_cast<Literal>(expr)) {
+    return literal_type(lit);
+  }
+  if (Identifier* ident = dyn_cast<Identifier>(expr)) {
+    const SymbolInfo& info = ident->ident_info;
+    if (info.idx < 0 || info.ptr_depth || info.array_size || loop.written.count(info.idx) || licm->address_taken.count(info.idx)) {
+      return UNK;
+    }
+    return type_rank(info.stype) < 0 ? UNK : info.stype;
+  }
+  if (UnaryExpression* un_exp = dyn_cast<UnaryExpression>(expr)) {
+    SymbolType st = invariant_type(un_exp->expr, loop);
+    if (st == UNK) return UNK;
+    switch (un_exp->op) {
+      case OP_UNARY_MINUS: return st;
+      case OP_NOT: return (st == FP32 || st == FP64) ? UNK : st;
+      case OP_BOOL_NOT: return I1;
+      default: return UNK;
+    }
+  }
+  if (BinaryExpression* bin_exp = dyn_cast<BinaryExpression>(expr)) {
+    SymbolType lt = invariant_type(bin_exp->lhs, loop);
+    SymbolType rt = invariant_type(bin_exp->rhs, loop);
+    if (lt == UNK || rt == UNK) return UNK;
+    SymbolType st = type_rank(rt) > type_rank(lt) ? rt : lt;
+    Literal* divisor = dyn_cast<Literal>(bin_exp->rhs);
+    switch (bin_exp->op) {
+      case OP_ADD: case OP_SUB: case OP_MUL:
+        return st;
+      case OP_DIV:
+        // hoisting must not introduce a division the loop would have skipped
+        // that traps: by zero, or MIN / -1 for signed types
+        if (st == FP32 || st == FP64 || safe_divisor(divisor, st)) return st;
+        return UNK;
+      case OP_MOD:
+        if (st != FP32 && st != FP64 && safe_divisor(divisor, st)) return st;
+        return UNK;
+      case OP_AND: case OP_OR: case OP_XOR: case OP_LSHIFT: case OP_RSHIFT:
+        return (st == FP32 || st == FP64) ? UNK : st;
+      case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE:
+        return I1;
+      default:
+        return UNK;
+    }
+  }
+  return UNK;
+}
+
+static std::set<TypeSpecifier> type_specs_for(SymbolType st) {
+  switch (st) {
+    case I1: return {TS_BOOL};
+    case I8: return {TS_SIGNED, TS_CHAR};
+    case I16: return {TS_SHORT};
+    case I64: return {TS_LONG};
+    case FP32: return {TS_FLOAT};
+    case FP64: return {TS_DOUBLE};
+    default: return {TS_INT};
+  }
+}
+
+// declares a new local initialized with expr and returns a read of it
+static Expression* hoist_into_temporary(Expression* expr, SymbolType st, LoopInfo& loop) {
+  int idx = licm->next_idx++;
+  Identifier* ident = new Identifier(intern("licm." + to_string(idx)));
+  ident->ident_info = {idx, 0, st};
+  ident->pos = expr->pos;
+
+  DeclarationSpecifiers* specs = new DeclarationSpecifiers();
+  specs->type_specs = type_specs_for(st);
+  vector<InitDeclarator*>* decl_list = new vector<InitDeclarator*>{ new InitDeclarator(0, ident, expr) };
+  DeclarationStatement* decl = new DeclarationStatement(new Declaration(specs, decl_list));
+  decl->pos = expr->pos;
+  loop.hoisted.push_back(decl);
+  licm->n_hoisted++;
+
+  return ident->copy_exp();
+}
+
+// replaces the largest invariant subexpressions of expr
+static Expression* hoist_expression(Expression* expr, LoopInfo& loop) {
+  BinaryExpression* bin_exp = dyn_cast<BinaryExpression>(expr);
+  UnaryExpression* un_exp = dyn_cast<UnaryExpression>(expr);
+  if (bin_exp || un_exp) {
+    SymbolType st = invariant_type(expr, loop);
+    if (st != UNK) return hoist_into_temporary(expr, st, loop);
+  }
+
+  if (bin_exp) {
+    // the target of an assignment is not a read
+    if (!isa<Identifier>(bin_exp->lhs)) bin_exp->lhs = hoist_expression(bin_exp->lhs, loop);
+    bin_exp->rhs = hoist_expression(bin_exp->rhs, loop);
+  }
+  else if (un_exp) {
+    if (un_exp->op != OP_AND && un_exp->op != OP_SIZEOF && un_exp->op != OP_ALIGNOF) {
+      un_exp->expr = hoist_expression(un_exp->expr, loop);
+    }
+  }
+  else if (SubscriptExpression* sub = dyn_cast<SubscriptExpression>(expr)) {
+    // the element itself may be stored to in the loop, its index can move
+    sub->base = hoist_expression(sub->base, loop);
+    sub->index = hoist_expression(sub->index, loop);
+  }
+  else if (MemberExpression* member = dyn_cast<MemberExpression>(expr)) {
+    if (member->arrow) member->base = hoist_expression(member->base, loop);
+  }
+  else if (FunctionInvocationExpression* call = dyn_cast<FunctionInvocationExpression>(expr)) {
+    if (call->params) {
+      for (auto& param : *call->params) param = hoist_expression(param, loop);
+    }
+  }
+  return expr;
+}
+
+void Statement::hoist(LoopInfo& loop) {}
+
+void DeclarationStatement::hoist(LoopInfo& loop) {
+  for (auto init_decl : *decl->decl_list) {
+    if (init_decl->init_expr) init_decl->init_expr = hoist_expression(init_decl->init_expr, loop);
+  }
+}
+
+void ExpressionStatement::hoist(LoopInfo& loop) {
+  if (expr) expr = hoist_expression(expr, loop);
+}
+
+void IfStatement::hoist(LoopInfo& loop) {
+  cond = hoist_expression(cond, loop);
+  if (true_branch) true_branch->hoist(loop);
+  if (false_branch) false_branch->hoist(loop);
+}
+
+void SwitchStatement::hoist(LoopInfo& loop) {
+  expr = hoist_expression(expr, loop);
+  stmt->hoist(loop);
+}
+
+void CaseStatement::hoist(LoopInfo& loop) {
+  if (stmt) stmt->hoist(loop);
+}
+
+void WhileStatement::hoist(LoopInfo& loop) {
+  cond = hoist_expression(cond, loop);
+  if (stmt) stmt->hoist(loop);
+}
+
+void DoWhileStatement::hoist(LoopInfo& loop) {
+  cond = hoist_expression(cond, loop);
+  if (stmt) stmt->hoist(loop);
+}
+
+void ForStatement::hoist(LoopInfo& loop) {
+  init->hoist(loop);
+  if (cond) cond = hoist_expression(cond, loop);
+  if (step) step->hoist(loop);
+  if (stmt) stmt->hoist(loop);
+}
+
+void ReturnStatement::hoist(LoopInfo& loop) {
+  if (ret_expr) ret_expr = hoist_expression(ret_expr, loop);
+}
+
+void BlockStatement::hoist(LoopInfo& loop) {
+  for (auto stmt : *this) stmt->hoist(loop);
+}
+
+
+// finding the loops
+
+// the temporaries followed by the loop, or the loop itself if nothing moved
+static Statement* hoist_loop(Statement* loop_stmt) {
+  LoopInfo loop;
+  loop_stmt->find_writes(loop.written);
+  loop_stmt->hoist(loop);
+  if (loop.hoisted.empty()) return loop_stmt;
+
+  BlockStatement* block = new BlockStatement();
+  block->pos = loop_stmt->pos;
+  for (auto decl : loop.hoisted) block->push_back(decl);
+  block->push_back(loop_stmt);
+  return block;
+}
+
+Statement* Statement::hoist_invariants() {
+  return this;
+}
+
+Statement* BlockStatement::hoist_invariants() {
+  for (auto& stmt : *this) stmt = stmt->hoist_invariants();
+  return this;
+}
+
+Statement* IfStatement::hoist_invariants() {
+  if (true_branch) true_branch = true_branch->hoist_invariants();
+  if (false_branch) false_branch = false_branch->hoist_invariants();
+  return this;
+}
+
+Statement* SwitchStatement::hoist_invariants() {
+  stmt = stmt->hoist_invariants();
+  return this;
+}
+
+// the label stays in front of the temporaries of a loop it labels
+Statement* CaseStatement::hoist_invariants() {
+  if (stmt) stmt = stmt->hoist_invariants();
+  return this;
+}
+
+Statement* WhileStatement::hoist_invariants() {
+  if (stmt) stmt = stmt->hoist_invariants();      // inner loops first
+  return hoist_loop(this);
+}
+
+Statement* DoWhileStatement::hoist_invariants() {
+  if (stmt) stmt = stmt->hoist_invariants();
+  return hoist_loop(this);
+}
+
+Statement* ForStatement::hoist_invariants() {
+  if (stmt) stmt = stmt->hoist_invariants();
+  return hoist_loop(this);
+}
+
+void Function::hoist_invariants() {
+  if (!stmts) return;
+
+  // a goto into the loop would skip the temporaries
+  CFG cfg(this);
+  if (!cfg.is_supported()) return;
+
+  LICMState state;
+  licm = &state;
+  find_address_taken(stmts, state.address_taken);
+
+  std::set<int> locals;
+  stmts->find_writes(locals);
+  if (params) {
+    for (auto param : *params->params) locals.insert(param->ident->ident_info.idx);
+  }
+  state.next_idx = locals.empty() ? 0 : *locals.rbegin() + 1;
+
+  stmts->hoist_invariants();
+  cdebug << "hoist_invariants: " << state.n_hoisted << " expressions moved out of loops in "
+         << *func_decl->ident->name << endl;
+  licm = nullptr;
+}
+
+void TranslationUnit::hoist_invariants() {
+  Function* func_ptr;
+  for (auto node_ptr : *nodes) {
+    if ((func_ptr = dyn_cast<Function>(node_ptr))) {
+      func_ptr->hoist_invariants();
+    }
+  }
+}
+
+}
@@ -1,345 +1,571 @@
 #include "symtab.hpp"
+#include <algorithm>
+#include <deque>
 #include <map>
+#include <unordered_set>
 #include "ast.hpp"
+#include "visitor.hpp"
 #include "debug.hpp"
 #include "consttab.hpp"
+#include "cfg.hpp"
+#include "compiler.hpp"
+
+// Sparse conditional constant propagation (Wegman and Zadeck) over the CFG of
+// each function. Every local gets a lattice value, undef, a constant or
+// overdefined, and a block is only visited once an edge into it is known to
+// be executable. A condition that is constant therefore keeps the other arm
+// out of the analysis entirely. Once the worklist is empty the blocks are
+// visited a final time to replace constant reads and subexpressions with
+// literals, and statements in blocks that were never reached are dropped.
+// Folding happens in place: a parent's child pointer only changes when a fold
+// actually happened, the literal put there is a copy of the pooled one for
+// the value with the position of what it replaces, and the replaced subtrees
+// go back to the arena once the function is done. Constant lattice values
+// point at pooled literals, or at literals of the tree, never at temporaries.
 
 namespace ast {
 
-ConstTable constant_table;
+// state of the function being propagated
+struct SCCPState {
+    std::set<int> untracked;        // locals with their address taken, statics, volatiles
+    bool rewrite = false;           // set for the final pass, once the solver converged
+    LiteralPool literals;           // constants of this function, shared by every use
+    int n_folded = 0;
+    vector<Node*> dead;             // roots of the subtrees replaced during rewrite
+};
+
+static thread_local SCCPState* sccp;
 
 Literal* LiteralCopy(Literal* src){
-    Literal* dest = new Literal("", LT_STRING);
+    Literal* dest = new Literal(0L, src->ltype);
     dest->data = src->data;
     dest->ltype = src->ltype;
     dest->value = src->value;
     return dest;
 }
 
-Expression* Expression::const_prop(){
-    // cout << "virtual" <<endl;
-    return nullptr;
+// pooled literal equal to the temporary lit, which goes back to the arena
+static Literal* pooled(Literal* lit) {
+    Literal* pooled_lit = sccp->literals.get(lit);
+    if (pooled_lit != lit) Node::release(lit);
+    return pooled_lit;
 }
 
-Statement* Statement::const_prop(){
-    // cout << "virtual const prop statement" <<endl;
-    return nullptr;
+// Locals whose values the lattice follows. Unsigned types are left out, their
+// literals are folded with signed arithmetic.
+static bool is_tracked(const SymbolInfo& info) {
+    if (info.idx < 0 || info.ptr_depth || info.array_size || sccp->untracked.count(info.idx)) return false;
+    switch (info.stype) {
+        case I1: case I8: case I16: case I32: case I64: case FP32: case FP64:
+            return true;
+        default:
+            return false;
+    }
 }
 
-Statement* BlockStatement::const_prop(){
-    for(int i = 0; i  < this->size(); i++) {
-        (*this)[i] = ((*this)[i])->const_prop();
+static bool is_fp_literal(Literal* l) {
+    return l->ltype == LT_FLOAT || l->ltype == LT_DOUBLE;
+}
+
+// literal holding val, to put in place of node; every use gets its own node
+// so that diagnostics on it point at the folded expression
+static Literal* replacement(const LatticeValue& val, Expression* node) {
+    sccp->n_folded++;
+    sccp->dead.push_back(node);
+    Literal* lit = cast<Literal>(sccp->literals.get(val.lit)->copy_exp());
+    lit->pos = node->pos;
+    return lit;
+}
+
+// value after assignment to a local of type stype
+static LatticeValue convert(const LatticeValue& val, SymbolType stype) {
+    if (!val.is_const()) return val;
+    Literal* lit = LiteralCopy(val.lit);
+    assign_literals(stype, lit);
+    return LatticeValue::constant(pooled(lit));
+}
+
+static Operator compound_op(Operator op) {
+    switch (op) {
+        case OP_MUL_ASSIGN: return OP_MUL;
+        case OP_DIV_ASSIGN: return OP_DIV;
+        case OP_MOD_ASSIGN: return OP_MOD;
+        case OP_ADD_ASSIGN: return OP_ADD;
+        case OP_SUB_ASSIGN: return OP_SUB;
+        case OP_LEFT_ASSIGN: return OP_LSHIFT;
+        case OP_RIGHT_ASSIGN: return OP_RSHIFT;
+        case OP_AND_ASSIGN: return OP_AND;
+        case OP_XOR_ASSIGN: return OP_XOR;
+        case OP_OR_ASSIGN: return OP_OR;
+        default: return op;
     }
-    return this;
 }
 
-
-void BlockStatement::remove_pointers(){
-    for(int i = 0; i  < this->size(); i++) {
-        (*this)[i]->remove_pointers();
+// Folds op over copies of two constants. Anything the folding routines would
+// report an error for, or trap on, is left to codegen as overdefined. MIN / -1
+// and MIN % -1 depend on the widened type, allocateBinaryExpression leaves
+// them unfolded.
+static LatticeValue fold_binary(Operator op, const LatticeValue& l, const LatticeValue& r) {
+    if (l.state == LATTICE_OVERDEF || r.state == LATTICE_OVERDEF) return LatticeValue::overdefined();
+    if (l.state == LATTICE_UNDEF || r.state == LATTICE_UNDEF) return LatticeValue::undef();
+    if (l.lit->ltype == LT_STRING || r.lit->ltype == LT_STRING) return LatticeValue::overdefined();
+
+    bool fp = is_fp_literal(l.lit) || is_fp_literal(r.lit);
+    switch (op) {
+        case OP_DIV:
+            if (!fp && !lit2bool(r.lit)) return LatticeValue::overdefined();
+            break;
+        case OP_MOD:
+            if (fp || !lit2bool(r.lit)) return LatticeValue::overdefined();
+            break;
+        case OP_AND: case OP_OR: case OP_XOR: case OP_LSHIFT: case OP_RSHIFT:
+            if (fp) return LatticeValue::overdefined();
+            break;
+        case OP_ADD: case OP_SUB: case OP_MUL:
+        case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE:
+        case OP_BOOL_AND: case OP_BOOL_OR:
+            break;
+        default:
+            return LatticeValue::overdefined();
+    }
+    Literal* lit = dyn_cast<Literal>(allocateBinaryExpression(LiteralCopy(l.lit), op, LiteralCopy(r.lit)));
+    return lit ? LatticeValue::constant(pooled(lit)) : LatticeValue::overdefined();
+}
+
+static LatticeValue fold_unary(Operator op, const LatticeValue& v) {
+    if (v.state != LATTICE_CONST) return v;
+    if (v.lit->ltype == LT_STRING) return LatticeValue::overdefined();
+    switch (op) {
+        case OP_NOT:
+            if (is_fp_literal(v.lit)) return LatticeValue::overdefined();
+            break;
+        case OP_UNARY_PLUS: case OP_UNARY_MINUS: case OP_BOOL_NOT:
+            break;
+        default:
+            return LatticeValue::overdefined();
     }
-    return;
+    Literal* lit = dyn_cast<Literal>(allocateUnaryExpression(op, LiteralCopy(v.lit)));
+    return lit ? LatticeValue::constant(pooled(lit)) : LatticeValue::overdefined();
 }
 
 
-Statement* IfStatement::const_prop(){
-    Expression* exp = cond->const_prop();
-    // cond = exp;    // delete old exp?
-    cond = FoldConstants(exp);
-
-    Literal* litcond = dynamic_cast<Literal*> (cond);
-
-    if (litcond) {
-        assign_literals(I1, litcond);  // convert to bool
-        if (litcond->data.l) {
-            false_branch = nullptr;
-        }
-        else{
-            true_branch = nullptr;
-        }
-        cond = litcond;   // although this conversion is taken care of during codegen
-    }
+// expressions
 
+Expression* Expression::const_prop(ConstEnv& env, LatticeValue& val){
+    val = LatticeValue::overdefined();
+    return this;
+}
 
-    if(true_branch) {
-        true_branch = true_branch->const_prop();
-        constant_table.clear_values();
-    }
-
-    
-    
-    if (false_branch) {
-        false_branch = false_branch->const_prop();
-        constant_table.clear_values();
-    }
-    
-    
+Expression* Literal::const_prop(ConstEnv& env, LatticeValue& val){
+    val = (ltype == LT_STRING) ? LatticeValue::overdefined() : LatticeValue::constant(this);
     return this;
 }
 
-void IfStatement::remove_pointers(){
-    cond->remove_pointers();
-    if (true_branch){
-        true_branch->remove_pointers();
+Expression* Identifier::const_prop(ConstEnv& env, LatticeValue& val){
+    if (!is_tracked(ident_info)) {
+        val = LatticeValue::overdefined();
+        return this;
     }
-    if (false_branch){
-        false_branch->remove_pointers();
+    val = env.get_value(ident_info.idx);
+    if (sccp->rewrite && val.is_const()) {
+        return replacement(val, this);
     }
+    return this;
 }
 
+Expression* BinaryExpression::const_prop(ConstEnv& env, LatticeValue& val){
+    LatticeValue l, r;
+    Identifier* ident = dyn_cast<Identifier>(lhs);
 
+    switch (op) {
+        case OP_ASSIGN:
+        case OP_MUL_ASSIGN: case OP_DIV_ASSIGN: case OP_MOD_ASSIGN:
+        case OP_ADD_ASSIGN: case OP_SUB_ASSIGN: case OP_LEFT_ASSIGN:
+        case OP_RIGHT_ASSIGN: case OP_AND_ASSIGN: case OP_XOR_ASSIGN: case OP_OR_ASSIGN:
+            rhs = rhs->const_prop(env, r);
+            if (ident && is_tracked(ident->ident_info)) {
+                if (op != OP_ASSIGN) {
+                    r = fold_binary(compound_op(op), env.get_value(ident->ident_info.idx), r);
+                }
+                val = convert(r, ident->ident_info.stype);
+                env.update_value(ident->ident_info.idx, val);
+            }
+            else {
+                if (!ident) lhs = lhs->const_prop(env, l);      // reads inside *p = ...
+                val = LatticeValue::overdefined();
+            }
+            return this;
+
+        case OP_BOOL_AND:
+        case OP_BOOL_OR: {
+            lhs = lhs->const_prop(env, l);
+            if (l.is_const() && lit2bool(l.lit) == (op == OP_BOOL_OR)) {
+                // short circuits, rhs is never evaluated
+                val = LatticeValue::constant(sccp->literals.get(LT_BOOL, op == OP_BOOL_OR));
+                if (sccp->rewrite && isa<Literal>(lhs)) return replacement(val, this);
+                return this;
+            }
+            ConstEnv rhs_env = env;
+            rhs = rhs->const_prop(rhs_env, r);
+            if (l.is_const()) env = rhs_env;
+            else env.meet(rhs_env);
+            val = fold_binary(op, l, r);
+            break;
+        }
 
+        case OP_SEQ:
+            lhs = lhs->const_prop(env, l);
+            rhs = rhs->const_prop(env, val);
+            return this;
 
-Statement* WhileStatement::const_prop(){
-    cond->remove_pointers();
-    stmt->remove_pointers();
-
-    constant_table.clear_values();
-
-    Expression* exp = cond->const_prop();
-    cond = FoldConstants(exp);
-    Literal* litcond = dynamic_cast<Literal*>(cond);
-    if (litcond) {
-        assign_literals(I1, litcond);  // convert to bool
-        if(!litcond->data.l){
-            stmt = nullptr;
-        }
-        cond = litcond;
+        default:
+            lhs = lhs->const_prop(env, l);
+            rhs = rhs->const_prop(env, r);
+            val = fold_binary(op, l, r);
+            break;
     }
-    if (stmt) {
-      stmt = stmt->const_prop();
+    if (sccp->rewrite && val.is_const() && isa<Literal>(lhs) && isa<Literal>(rhs)) {
+        return replacement(val, this);
     }
-    constant_table.clear_values();
     return this;
 }
 
-void WhileStatement::remove_pointers(){
-    cond->remove_pointers();
-    stmt->remove_pointers();
-    return;
+Expression* UnaryExpression::const_prop(ConstEnv& env, LatticeValue& val){
+    LatticeValue v;
+    Identifier* ident = dyn_cast<Identifier>(expr);
+
+    switch (op) {
+        case OP_AND:
+            // tracked locals never have their address taken, so &x reads nothing
+            if (!ident) expr = expr->const_prop(env, v);
+            val = LatticeValue::overdefined();
+            return this;
+
+        case OP_SIZEOF:
+        case OP_ALIGNOF:
+            val = LatticeValue::overdefined();              // operand is not evaluated
+            return this;
+
+        case OP_PRE_INCR:
+        case OP_PRE_DECR:
+        case OP_POST_INCR:
+        case OP_POST_DECR:
+            if (ident && is_tracked(ident->ident_info)) {
+                LatticeValue old = env.get_value(ident->ident_info.idx);
+                Operator step = (op == OP_PRE_INCR || op == OP_POST_INCR) ? OP_ADD : OP_SUB;
+                LatticeValue updated = convert(fold_binary(step, old, LatticeValue::constant(sccp->literals.get(LT_INT32, 1))),
+                                               ident->ident_info.stype);
+                env.update_value(ident->ident_info.idx, updated);
+                val = (op == OP_PRE_INCR || op == OP_PRE_DECR) ? updated : old;
+            }
+            else {
+                if (!ident) expr = expr->const_prop(env, v);
+                val = LatticeValue::overdefined();
+            }
+            return this;
+
+        default:
+            expr = expr->const_prop(env, v);
+            val = fold_unary(op, v);
+            if (sccp->rewrite && val.is_const() && isa<Literal>(expr)) {
+                return replacement(val, this);
+            }
+            return this;
+    }
 }
 
-Statement* ExpressionStatement::const_prop(){
+Expression* SubscriptExpression::const_prop(ConstEnv& env, LatticeValue& val){
+    LatticeValue v;
+    base = base->const_prop(env, v);
+    index = index->const_prop(env, v);
+    val = LatticeValue::overdefined();                  // array elements are not tracked
+    return this;
+}
 
-    
-  if (!expr) return this;
-    expr = expr->const_prop();  // delete old exp?
-    
-    expr = FoldConstants(expr);
+Expression* MemberExpression::const_prop(ConstEnv& env, LatticeValue& val){
+    LatticeValue v;
+    base = base->const_prop(env, v);
+    val = LatticeValue::overdefined();                  // fields are not tracked
+    return this;
+}
 
+Expression* TernaryExpression::const_prop(ConstEnv& env, LatticeValue& val){
+    LatticeValue c, t, f;
+    cond = cond->const_prop(env, c);
+    if (c.is_const()) {
+        if (lit2bool(c.lit)) true_branch = true_branch->const_prop(env, val);
+        else false_branch = false_branch->const_prop(env, val);
+        return this;
+    }
+    ConstEnv false_env = env;
+    true_branch = true_branch->const_prop(env, t);
+    false_branch = false_branch->const_prop(false_env, f);
+    env.meet(false_env);
+    val = t.meet(f);
     return this;
 }
 
+Expression* FunctionInvocationExpression::const_prop(ConstEnv& env, LatticeValue& val){
+    LatticeValue v;
+    if (params) {
+        for(int i = 0; i < params->size(); i++){
+            (*params)[i] = (*params)[i]->const_prop(env, v);
+        }
+    }
+    val = LatticeValue::overdefined();
+    return this;
+}
 
 
-Statement* DeclarationStatement::const_prop(){
-    for(int i = 0; i < (decl->decl_list)->size(); i++){
-        if((*(decl->decl_list))[i]->init_expr){
-             // cout << "Const ";
-            Expression* exp = (*(decl->decl_list))[i]->init_expr->const_prop();
-             // cout << "Const ";
-            // delete old exp? 
-            // dec->init_expr = exp;
-            
-            (*(decl->decl_list))[i]->init_expr = FoldConstants(exp);
+// statements
 
-            // cout<<"WHAT"<<endl;
+void Statement::const_prop(ConstEnv& env){
+}
 
-            if (dynamic_cast<Literal*> ((*(decl->decl_list))[i]->init_expr)){
-                // cout << "Const ";
+void ExpressionStatement::const_prop(ConstEnv& env){
+    LatticeValue val;
+    if (expr) expr = expr->const_prop(env, val);
+}
 
-                // cout << (*decl->decl_list)[i]->ident->ident_info.idx << endl;
-                Literal* initlit = dynamic_cast<Literal*> (((*(decl->decl_list))[i]->init_expr)->copy_exp());
-                if (!(*decl->decl_list)[i]->ident->ident_info.ptr_depth){
-                    // cout << (*decl->decl_list)[i]->ident->name<<endl;
-                    assign_literals(((*decl->decl_list)[i]->ident->ident_info.stype), (initlit));
-                    constant_table.update_value((*decl->decl_list)[i]->ident->ident_info.idx,(initlit));
-                    // cout<<initlit->ltype << " "<<initlit->data.d << endl;
-                }
-                else{
-                     constant_table.update_value((*decl->decl_list)[i]->ident->ident_info.idx, nullptr) ;
-                }
-                // cout << initlit->data.s << " " <<initlit->ltype << endl;
-            }
-            else{
-                constant_table.update_value((*decl->decl_list)[i]->ident->ident_info.idx, dynamic_cast<Literal*> ((*decl->decl_list)[i]->init_expr) );
-            }
+void DeclarationStatement::const_prop(ConstEnv& env){
+    for (auto init_decl : *decl->decl_list) {
+        LatticeValue val = LatticeValue::overdefined();    // uninitialized locals are left alone
+        if (init_decl->init_expr) {
+            init_decl->init_expr = init_decl->init_expr->const_prop(env, val);
+        }
+        SymbolInfo& info = init_decl->ident->ident_info;
+        if (is_tracked(info)) {
+            env.update_value(info.idx, convert(val, info.stype));
         }
     }
-    return this;
 }
 
-void DeclarationStatement::remove_pointers(){
-    for(int i = 0; i < (decl->decl_list)->size(); i++){
-        if((*(decl->decl_list))[i]->init_expr){
-             // cout << "Const ";
-            (*(decl->decl_list))[i]->init_expr->remove_pointers();
-        }
-            
-        constant_table.update_value((*decl->decl_list)[i]->ident->ident_info.idx, dynamic_cast<Literal*> ((*decl->decl_list)[i]->init_expr) );   // should i remove this????
-    }
-    return;
+void ReturnStatement::const_prop(ConstEnv& env){
+    LatticeValue val;
+    if (ret_expr) ret_expr = ret_expr->const_prop(env, val);
 }
 
-Statement* ReturnStatement::const_prop(){
-    if (ret_expr) {
-        Expression* exp = ret_expr->const_prop(); // delete old exp?
-        ret_expr = exp;
-        ret_expr = FoldConstants(ret_expr);
-        if (ret_expr) {
-            // cout << "return pointer exists" << endl;
-        }
-    }
-    return this;
+void Statement::prune(const CFG& cfg){
 }
 
-void ReturnStatement::remove_pointers(){
-    if(ret_expr){
-        ret_expr->remove_pointers();
-    }
+// drops stmt if control never reaches it. Case labels stay, their switch
+// has a branch to each, and so do declarations, a label after one can still
+// use the variable.
+static bool prune_stmt(Statement*& stmt, const CFG& cfg) {
+    if (!stmt || cfg.is_executable(stmt) || isa<CaseStatement>(stmt) || isa<DeclarationStatement>(stmt)) return false;
+    sccp->dead.push_back(stmt);
+    stmt = nullptr;
+    return true;
 }
 
-Expression* Identifier::const_prop(){
-    if (constant_table.is_constant(ident_info.idx)){
-        // cout<<"Found constant"<<endl;
-        Literal* l = dynamic_cast<Literal*>((constant_table.get_value(ident_info.idx))->copy_exp());
-        if(!l){
-            cout << "something is wrong" << endl;
-        }
-        return l;
+void BlockStatement::prune(const CFG& cfg){
+    // after a return, break or continue, or behind a constant condition
+    erase(std::remove_if(begin(), end(), [&](Statement* stmt) { return prune_stmt(stmt, cfg); }), end());
+    for (auto stmt : *this) {
+        stmt->prune(cfg);
     }
-    return this;   // copy current exp and return so old version can be deleted
 }
 
-Expression* BinaryExpression::const_prop(){
-    if (op == OP_ASSIGN) {
-        Expression* newrhs = rhs->const_prop();
-        rhs = FoldConstants(newrhs);
-        // if (rhs->const_value) {
-        //     const_value = rhs->const_value;
-        // }
-        // rhs = newrhs;
-        Identifier* ident = dynamic_cast<Identifier*> (lhs);
-        if (ident) {
-            Literal* rhslit =dynamic_cast<Literal*> (rhs);
-            if (rhslit) {
-                if(!(ident->ident_info.ptr_depth)){
-                    // cout << ident->name << endl;
-                    assign_literals(ident->ident_info.stype, rhslit);
-                    constant_table.update_value(ident->ident_info.idx, rhslit );
-                }
-            }
-            else{
-                constant_table.invalidate_value(ident->ident_info.idx);
-            }
-            
-        }
-        else{
-            lhs = lhs->const_prop();       // not sure
-        }
-        return this;
+void IfStatement::prune(const CFG& cfg){
+    // with true_branch gone, codegen evaluates cond and runs false_branch
+    prune_stmt(true_branch, cfg);
+    prune_stmt(false_branch, cfg);
+    if (true_branch) true_branch->prune(cfg);
+    if (false_branch) false_branch->prune(cfg);
+}
 
-    }                                // check for all assignment types
-    Expression* newlhs = lhs->const_prop();
-    Expression* newrhs = rhs->const_prop();   // delete old expressions
-    if (newrhs && newlhs) {
-        // cout << "Both exist\n";
-    } 
-    lhs = newlhs;
-    rhs = newrhs;
-    return  this;  // copy current exp and return so old version can be deleted
-}
-
-void BinaryExpression::remove_pointers(){
-    rhs->remove_pointers();
-    lhs->remove_pointers();
-    return;
-}
-
-Expression* UnaryExpression::const_prop(){
-    if(op == OP_AND){                           // check for all assignment types
-        // cout<<"POINTER" <<endl;
-        Identifier* ident = dynamic_cast<Identifier*> (expr);
-        if (ident) {
-            constant_table.pointer_taken(ident->ident_info.idx);
-        }
-        else{
-            expr = expr->const_prop();
-        }
-        return this;
-    }
-    else{
-        Expression* exp = expr->const_prop();
-        expr = exp;
-        return this;   // copy current exp and return so old version can be deleted
-    }
+void WhileStatement::prune(const CFG& cfg){
+    // cond is false on entry, the loop is left with an empty body
+    prune_stmt(stmt, cfg);
+    if (stmt) stmt->prune(cfg);
 }
 
-void UnaryExpression::remove_pointers(){
-    if(op == OP_AND){                           
-        Identifier* ident = dynamic_cast<Identifier*> (expr);
-        if (ident) {
-            constant_table.pointer_taken(ident->ident_info.idx);
-        }
-        else{
-            expr->remove_pointers();
-        }
-        return;
-    }
-    else{
-        expr->remove_pointers();
-        return;   // copy current exp and return so old version can be deleted
-    }
+void ForStatement::prune(const CFG& cfg){
+    prune_stmt(stmt, cfg);
+    prune_stmt(step, cfg);      // every iteration breaks or returns
+    if (stmt) stmt->prune(cfg);
 }
 
-Expression* FunctionInvocationExpression::const_prop(){
-    if (params) {
-        for(int i = 0; i < params->size(); i++){
-            Expression* exp = (*params)[i]->const_prop();
-            (*params)[i] = exp;
-            (*params)[i] = FoldConstants(exp);
-        }
+void DoWhileStatement::prune(const CFG& cfg){
+    if (stmt) stmt->prune(cfg);
+}
+
+void SwitchStatement::prune(const CFG& cfg){
+    // the body is only entered through its labels
+    stmt->prune(cfg);
+}
+
+void CaseStatement::prune(const CFG& cfg){
+    prune_stmt(stmt, cfg);
+    if (stmt) stmt->prune(cfg);
+}
+
+
+// nodes of the subtrees below a root, each once, in pre-order
+struct NodeCollector : RecursiveASTVisitor<NodeCollector> {
+    std::unordered_set<Node*> seen;
+    vector<Node*> nodes;
+
+    bool visitNode(Node* node) {
+        if (seen.insert(node).second) nodes.push_back(node);
+        return true;
+    }
+};
+
+// Hands the nodes replaced or pruned during rewrite back to the arena. The
+// desugaring of x op= e shares x between both sides, so a replaced subtree
+// can still have parts in the function; those stay. Pooled literals belong
+// to the pool.
+static void release_dead(Function* func) {
+    if (sccp->dead.empty()) return;
+    NodeCollector live, dead;
+    live.traverse(func);
+    for (auto root : sccp->dead) {
+        dead.traverse(root);
+    }
+    for (auto node : dead.nodes) {
+        Literal* lit = dyn_cast<Literal>(node);
+        if (!live.seen.count(node) && !(lit && lit->interned)) Node::release(node);
     }
-    return this;
 }
 
 
-void FunctionInvocationExpression::remove_pointers(){
-    if (params) {
-        for(int i = 0; i < params->size(); i++){
-            (*params)[i]->remove_pointers();
+// solver
+
+// runs the statements of a block and its branch condition over env, returns
+// the value of the condition
+static LatticeValue transfer(CFGBlock& block, ConstEnv& env) {
+    for (auto stmt : block.stmts) {
+        stmt->const_prop(env);
+    }
+    LatticeValue cond = LatticeValue::overdefined();
+    if (block.cond) {
+        *block.cond = (*block.cond)->const_prop(env, cond);
+    }
+    return cond;
+}
+
+// index of the successor a branch on the constant cond takes, -1 if any of
+// them can be
+static int taken_succ(const CFGBlock& block, const LatticeValue& cond) {
+    if (!block.cond || !cond.is_const()) return -1;
+    if (!block.sw) return lit2bool(cond.lit) ? 0 : 1;
+
+    LiteralType ltype = cond.lit->ltype;
+    if (ltype == LT_FLOAT || ltype == LT_DOUBLE || ltype == LT_FLOAT_LIKE || ltype == LT_STRING) return -1;
+    // labels are converted to the promoted type of the condition
+    unsigned long mask = (ltype == LT_INT64 || ltype == LT_UINT64) ? ~0UL : 0xffffffffUL;
+    const vector<CaseStatement*>& cases = block.sw->cases;
+    int default_succ = cases.size();        // the end of the switch, if it has no default
+    for (int i = 0; i < cases.size(); i++) {
+        Literal* label = dyn_cast_or_null<Literal>(cases[i]->const_expr);
+        if (!label) default_succ = i;
+        else if (((unsigned long) label->data.l & mask) == ((unsigned long) cond.lit->data.l & mask)) return i;
+    }
+    return default_succ;
+}
+
+// Returns the environment on entry to every block. Only edges that can be
+// taken are followed: a branch whose condition is constant marks just one of
+// its successors executable.
+static vector<ConstEnv> solve(CFG& cfg, const ConstEnv& entry) {
+    vector<ConstEnv> in(cfg.size());
+    vector<bool> queued(cfg.size(), false);
+    std::deque<int> worklist;
+
+    in[CFG::ENTRY] = entry;
+    cfg[CFG::ENTRY].executable = true;
+    worklist.push_back(CFG::ENTRY);
+    queued[CFG::ENTRY] = true;
+
+    while (!worklist.empty()) {
+        int block = worklist.front();
+        worklist.pop_front();
+        queued[block] = false;
+
+        ConstEnv env = in[block];
+        LatticeValue cond = transfer(cfg[block], env);
+        int taken = taken_succ(cfg[block], cond);
+
+        for (int i = 0; i < cfg[block].succs.size(); i++) {
+            if (taken >= 0 && i != taken) continue;
+
+            int succ = cfg[block].succs[i];
+            bool changed;
+            if (!cfg[succ].executable) {
+                cfg[succ].executable = true;
+                in[succ] = env;
+                changed = true;
+            }
+            else {
+                changed = in[succ].meet(env);
+            }
+            if (changed && !queued[succ]) {
+                worklist.push_back(succ);
+                queued[succ] = true;
+            }
         }
     }
-    return;
+    return in;
 }
 
-
 void TranslationUnit::const_prop() {
-  
   Function* func_ptr;
   for (auto node_ptr: *nodes){
-    if ((func_ptr = dynamic_cast<Function*>(node_ptr))) {
-      constant_table.clear_table();
+    if ((func_ptr = dyn_cast<Function>(node_ptr))) {
       func_ptr->const_prop();
     }
   }
-
 }
 
 void Function::const_prop(){
+    if (!stmts) return;
+
+    CFG cfg(this);
+    if (!cfg.is_supported()) {
+        cdebug << "const_prop: skipping " << *func_decl->ident->name << endl;
+        return;
+    }
+
+    SCCPState state;
+    sccp = &state;
+    find_address_taken(stmts, state.untracked);
+    for (int block = 0; block < cfg.size(); block++) {
+        for (auto stmt : cfg[block].stmts) {
+            DeclarationStatement* decl_stmt = dyn_cast<DeclarationStatement>(stmt);
+            if (!decl_stmt) continue;
+            DeclarationSpecifiers* specs = decl_stmt->decl->decl_specs;
+            if (specs->storage_specs.count(SS_STATIC) || specs->type_quals.count(TQ_VOLATILE)) {
+                for (auto init_decl : *decl_stmt->decl->decl_list) {
+                    state.untracked.insert(init_decl->ident->ident_info.idx);
+                }
+            }
+        }
+    }
+
+    ConstEnv entry;
     if (params) {
-        for(int i = 0; i < (params->params)->size(); i++){
-            constant_table.update_value((*(params->params))[i]->ident->ident_info.idx, nullptr);
+        for (auto param : *params->params) {
+            entry.update_value(param->ident->ident_info.idx, LatticeValue::overdefined());
         }
     }
-    
-    if (this->stmts) {
-        stmts->const_prop();
+    vector<ConstEnv> in = solve(cfg, entry);
+
+    state.rewrite = true;
+    for (int block = 0; block < cfg.size(); block++) {
+        if (cfg[block].executable) {
+            transfer(cfg[block], in[block]);
+        }
     }
-}
+    stmts->prune(cfg);
+    release_dead(this);
+    CompilerInstance::active()->time_report.add_folded(state.n_folded);
+    cdebug << "const_prop: " << state.n_folded << " expressions folded in " << *func_decl->ident->name << endl;
 
-Expression* Literal::const_prop(){
-    return this;
+#ifdef DEBUG
+    cfg.dump(cerr);
+#endif
+    sccp = nullptr;
 }
 
 
@@ -364,6 +590,21 @@ Expression* UnaryExpression::flatten_tree(Statement* b){
     return this;
 }
 
+Expression* SubscriptExpression::flatten_tree(Statement* b){
+    index = index->flatten_tree(b);
+    base = base->flatten_tree(b);
+    return this;
+}
+
+Expression* MemberExpression::flatten_tree(Statement* b){
+    base = base->flatten_tree(b);
+    return this;
+}
+
+Expression* TypeName::flatten_tree(Statement* b){
+    return this;
+}
+
 Expression* FunctionInvocationExpression::flatten_tree(Statement* b){
     fn = fn->flatten_tree(b);
 
@@ -379,7 +620,7 @@ Expression* FunctionInvocationExpression::flatten_tree(Statement* b){
 Expression* BinaryExpression::flatten_tree(Statement* b){
     // if (left_assoc_op)
     if (op == OP_ASSIGN) {
-        BlockStatement* bs = dynamic_cast<BlockStatement*>(b);
+        BlockStatement* bs = cast<BlockStatement>(b);
         lhs = lhs->flatten_tree(b);
         rhs = rhs->flatten_tree(b);
         bs->push_back(new ExpressionStatement(this));
@@ -400,25 +641,4 @@ Expression* Expression::flatten_tree(Statement* b){
 
 
 
-void Expression::remove_pointers(){
-    return;
-}
-
-void Statement::remove_pointers(){
-    return;
 }
-
-void ExpressionStatement::remove_pointers(){
-  if (expr) expr->remove_pointers();
-    return;
-}
-
-
-
-}
-
-
-
-
-
-
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <sstream>
+#include "records.hpp"
+#include "error.hpp"
+
+namespace ast {
+int getTypeSize(SymbolType ts, int ptr_depth);      // codegen.cpp
+}
+
+static long align_to(long offset, int align) {
+    return (offset + align - 1) / align * align;
+}
+
+string RecordLayout::name() const {
+    return string(is_union ? "union " : "struct ") + (tag ? *tag : "<anonymous>");
+}
+
+int RecordLayout::find_field(istring name) const {
+    for (int i = 0; i < fields.size(); i++) {
+        if (fields[i].name == name) return i;
+    }
+    return -1;
+}
+
+int RecordTable::add(istring tag, bool is_union, ast::sympos pos) {
+    RecordLayout layout;
+    layout.tag = tag;
+    layout.is_union = is_union;
+    layout.pos = pos;
+    records.push_back(layout);
+    return records.size() - 1;
+}
+
+void RecordTable::add_field(int record, istring name, SymbolInfo type) {
+    RecordLayout& layout = records[record];
+    long size = size_of(type);
+    int align = align_of(type);
+    long offset = layout.is_union ? 0 : align_to(layout.size, align);
+    layout.fields.push_back({name, type, offset});
+    layout.size = max(layout.size, offset + size);
+    layout.align = max(layout.align, align);
+}
+
+void RecordTable::finish(int record) {
+    RecordLayout& layout = records[record];
+    layout.size = align_to(layout.size, layout.align);
+    layout.complete = true;
+}
+
+long RecordTable::size_of(const SymbolInfo& type) const {
+    long size;
+    if (type.stype == REC && !type.ptr_depth) size = records[type.record].size;
+    else size = ast::getTypeSize(type.stype, type.ptr_depth);
+    return type.array_size ? size * type.array_size : size;
+}
+
+int RecordTable::align_of(const SymbolInfo& type) const {
+    if (type.stype == REC && !type.ptr_depth) return records[type.record].align;
+    return ast::getTypeSize(type.stype, type.ptr_depth);
+}
+
+void RecordTable::report_padding() const {
+    for (auto& layout : records) {
+        if (layout.is_union || !layout.complete || layout.fields.empty()) continue;
+
+        stringstream holes;
+        long padding = 0;
+        for (int i = 0; i < layout.fields.size(); i++) {
+            long end = layout.fields[i].offset + size_of(layout.fields[i].type);
+            long next = (i + 1 < layout.fields.size()) ? layout.fields[i + 1].offset : layout.size;
+            if (next > end) {
+                holes << (padding ? ", " : "") << next - end << " after '" << *layout.fields[i].name << "'";
+                padding += next - end;
+            }
+        }
+        if (!padding) continue;
+
+        // most aligned first leaves no holes between fields, and keeps the
+        // large fields together at the start of the cache line
+        vector<RecordField> order = layout.fields;
+        stable_sort(order.begin(), order.end(), [this](const RecordField& a, const RecordField& b) {
+            return align_of(a.type) > align_of(b.type);
+        });
+        long size = 0;
+        for (auto& field : order) {
+            size = align_to(size, align_of(field.type)) + size_of(field.type);
+        }
+        size = align_to(size, layout.align);
+
+        vector<string> args = {layout.name(), to_string(padding), holes.str(), to_string(layout.size)};
+        if (size >= layout.size) {
+            ehdl::report(ehdl::W_PADDING, layout.pos, args);
+            continue;
+        }
+        stringstream fields;
+        for (int i = 0; i < order.size(); i++) {
+            fields << (i ? ", '" : "'") << *order[i].name << "'";
+        }
+        args.push_back(fields.str());
+        args.push_back(to_string(size));
+        ehdl::report(ehdl::W_PADDING_REORDER, layout.pos, args);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef RECORDS
+#define RECORDS
+
+#include <string>
+#include <vector>
+#include "ast.hpp"
+#include "symtab.hpp"
+
+using namespace std;
+
+struct RecordField {
+    istring name;
+    SymbolInfo type;                // stype, ptr_depth, array_size and record
+    long offset;
+};
+
+// Layout of a struct or union as the x86-64 System V ABI defines it: fields
+// in declaration order, each at the next multiple of its alignment, the size
+// rounded up to the largest alignment. Union fields all start at offset 0.
+struct RecordLayout {
+    istring tag;                    // nullptr for anonymous records
+    bool is_union;
+    bool complete = false;          // set at the closing brace of the definition
+    ast::sympos pos;
+    vector<RecordField> fields;
+    long size = 0;
+    int align = 1;
+
+    string name() const;            // "struct S", for diagnostics
+    int find_field(istring name) const;     // -1 if there is no such field
+};
+
+// size_of and align_of need the other records for nested structs, so the
+// layout is done by the table
+class RecordTable {
+private:
+    vector<RecordLayout> records;
+
+public:
+    int add(istring tag, bool is_union, ast::sympos pos);
+    RecordLayout& operator[](int record) { return records[record]; }
+    const RecordLayout& operator[](int record) const { return records[record]; }
+    size_t size() const { return records.size(); }
+
+    // places a field after the ones before it
+    void add_field(int record, istring name, SymbolInfo type);
+    // pads the size to the alignment and marks the record complete
+    void finish(int record);
+
+    long size_of(const SymbolInfo& type) const;
+    int align_of(const SymbolInfo& type) const;
+
+    // -Wpadding: warns about every struct with padding, with the bytes lost
+    // after each field and a field order that needs less
+    void report_padding() const;
+};
+
+#endif
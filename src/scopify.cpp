@@ -1,13 +1,17 @@
 #include "ast.hpp"
 #include "debug.hpp"
 #include "error.hpp"
+#include "compiler.hpp"
 
 namespace ast {
 
-static SymbolTable *table;
+static thread_local SymbolTable *table;    // of the active CompilerInstance
+static thread_local RecordTable *records;
+static thread_local SwitchStatement *enclosing_switch;     // case labels are collected here
 
 
 SymbolType typespecs2st(std::set<TypeSpecifier> type_specs) {
+  if (type_specs.count(TS_STRUCT) || type_specs.count(TS_UNION)) return REC;
   if (type_specs.find(TS_FLOAT) != type_specs.end()) return FP32;
   if (type_specs.find(TS_DOUBLE) != type_specs.end()) return FP64;
   if (type_specs.find(TS_UNSIGNED) != type_specs.end()) {
@@ -26,11 +30,24 @@ SymbolType typespecs2st(std::set<TypeSpecifier> type_specs) {
   return I32;
 }
 
+// type of a declarator with these specifiers; the record specifier has been
+// scopified already
+static SymbolInfo declared_type(DeclarationSpecifiers* decl_specs, int ptr_depth) {
+  SymbolInfo info = {-1, ptr_depth, typespecs2st(decl_specs->type_specs)};
+  if (decl_specs->record_spec) info.record = decl_specs->record_spec->record;
+  return info;
+}
+
+// objects of a struct type need all of its fields, pointers to it don't
+static bool is_incomplete(const SymbolInfo& info) {
+  return info.stype == REC && !info.ptr_depth && !(*records)[info.record].complete;
+}
+
 void Identifier::scopify() {
   cdebug << "Identifier::scopify: " << endl;
   ident_info = table->find_symbol(name);
   if (ident_info.stype == UNK) {
-    ehdl::err("Use of undeclared identifier " + name, pos);
+    ehdl::report(ehdl::E_UNDECLARED_IDENTIFIER, pos, {*name});
   }
   // cout << name << " ";
   // cout << ident_info.ptr_depth << endl;
@@ -64,6 +81,27 @@ void UnaryExpression::scopify() {
   expr->scopify();
 }
 
+void SubscriptExpression::scopify() {
+  cdebug << "SubscriptExpression::scopify: " << endl;
+  base->scopify();
+  index->scopify();
+}
+
+void MemberExpression::scopify() {
+  cdebug << "MemberExpression::scopify: " << endl;
+  base->scopify();                  // the field is looked up by codegen, which knows the type of base
+}
+
+void TypeName::scopify() {
+  cdebug << "TypeName::scopify: " << endl;
+  decl_specs->scopify();
+  type_info.st = declared_type(decl_specs, ptr_depth);
+  type_info.is_ref = false;
+  if (is_incomplete(type_info.st)) {
+    ehdl::report(ehdl::E_SIZEOF_INCOMPLETE, pos, {(*records)[type_info.st.record].name()});
+  }
+}
+
 void Literal::scopify() {
   cdebug << "Literal::scopify: " << endl; 
   return;
@@ -89,7 +127,13 @@ void IfStatement::scopify() {
 
 void SwitchStatement::scopify() {
   cdebug << "SwitchStatement::scopify: " << endl;
-  return;
+  expr->scopify();
+  SwitchStatement* outer = enclosing_switch;
+  enclosing_switch = this;
+  table->enter_scope();
+  stmt->scopify();
+  table->exit_scope();
+  enclosing_switch = outer;
 }
 
 void WhileStatement::scopify() {
@@ -108,6 +152,18 @@ void DoWhileStatement::scopify() {
   table->exit_scope();
 }
 
+void ForStatement::scopify() {
+  cdebug << "ForStatement::scopify: " << endl;
+  table->enter_scope();             // a declaration in init is only visible in the loop
+  init->scopify();
+  if (cond) cond->scopify();
+  if (step) step->scopify();
+  table->enter_scope();
+  stmt->scopify();
+  table->exit_scope();
+  table->exit_scope();
+}
+
 void ContinueStatement::scopify() {
   cdebug << "ContinueStatement::scopify: " << endl;
   return;
@@ -122,7 +178,26 @@ void GotoStatement::scopify() {
 }
 void CaseStatement::scopify() {
   cdebug << "CaseStatement::scopify: " << endl;
-  return;
+  if (!enclosing_switch) {
+    ehdl::report(ehdl::E_LABEL_OUTSIDE_SWITCH, pos, {const_expr ? "case" : "default"});
+  }
+  else if (const_expr) {
+    const_expr->scopify();
+    Literal* lit = dyn_cast<Literal>(const_expr);
+    if (!lit || lit->ltype == LT_FLOAT || lit->ltype == LT_DOUBLE || lit->ltype == LT_FLOAT_LIKE || lit->ltype == LT_STRING) {
+      ehdl::report(ehdl::E_CASE_NOT_CONSTANT, pos);
+    }
+    else {
+      enclosing_switch->cases.push_back(this);
+    }
+  }
+  else {
+    for (auto other : enclosing_switch->cases) {
+      if (!other->const_expr) ehdl::report(ehdl::E_MULTIPLE_DEFAULT, pos);
+    }
+    enclosing_switch->cases.push_back(this);
+  }
+  stmt->scopify();
 }
 void LabeledStatement::scopify() {
   cdebug << "LabeledStatement::scopify: " << endl;
@@ -134,9 +209,85 @@ void ReturnStatement::scopify() {
   ret_expr->scopify();
 }
 
+// number of elements of an array declarator, which must be a positive
+// integer constant; 1 after an error so codegen can go on
+static int array_length(InitDeclarator* decl) {
+  decl->array_size->scopify();
+  Literal* lit = dyn_cast<Literal>(decl->array_size);
+  if (!lit || lit->ltype == LT_FLOAT || lit->ltype == LT_DOUBLE || lit->ltype == LT_FLOAT_LIKE || lit->ltype == LT_STRING) {
+    ehdl::report(ehdl::E_ARRAY_SIZE_NOT_CONSTANT, decl->pos, {*decl->ident->name});
+    return 1;
+  }
+  Literal* len = (Literal*) lit->copy_exp();
+  assign_literals(I64, len);
+  if (len->data.l <= 0) {
+    ehdl::report(ehdl::E_ARRAY_SIZE_NOT_POSITIVE, decl->pos, {*decl->ident->name});
+    return 1;
+  }
+  return len->data.l;
+}
+
 void DeclarationSpecifiers::scopify() {
   cdebug << "DeclarationSpecifiers::scopify: " << endl;
-  return;
+  if (record_spec) record_spec->scopify();
+}
+
+// Tags live in the symbol table next to ordinary names, under "struct S" or
+// "union S" which can't clash with an identifier. A reference to a tag that
+// is not visible declares an incomplete record, which a later definition in
+// the same scope completes.
+void RecordSpecifier::scopify() {
+  cdebug << "RecordSpecifier::scopify: " << endl;
+  bool is_union = (keyword == TS_UNION);
+  istring key = tag ? intern(string(is_union ? "union " : "struct ") + *tag) : nullptr;
+  if (!fields) {
+    SymbolInfo info = table->find_symbol(key);
+    if (info.stype == REC) {
+      record = info.record;
+    }
+    else {
+      record = records->add(tag, is_union, pos);
+      table->add_symbol(key, {-1, 0, REC, 0, record});
+    }
+    return;
+  }
+
+  if (key && table->check_scope(key)) {
+    record = table->find_symbol(key).record;
+    if ((*records)[record].complete) {
+      ehdl::report(ehdl::E_RECORD_REDEFINITION, pos, {(*records)[record].name()});
+      return;
+    }
+    (*records)[record].pos = pos;
+  }
+  else {
+    record = records->add(tag, is_union, pos);
+    if (key) table->add_symbol(key, {-1, 0, REC, 0, record});
+  }
+
+  for (Declaration* decl : *fields) {
+    decl->decl_specs->scopify();
+    if (!decl->decl_specs->storage_specs.empty()) {
+      ehdl::report(ehdl::E_FIELD_STORAGE_CLASS, decl->pos);
+    }
+    for (InitDeclarator* field : *decl->decl_list) {
+      SymbolInfo info = declared_type(decl->decl_specs, field->ptr_depth);
+      if (field->array_size) info.array_size = array_length(field);
+      if (field->init_expr) {
+        ehdl::report(ehdl::E_FIELD_INITIALIZER, field->pos, {*field->ident->name});
+      }
+      if ((*records)[record].find_field(field->ident->name) >= 0) {
+        ehdl::report(ehdl::E_DUPLICATE_MEMBER, field->pos, {*field->ident->name});
+      }
+      else if (is_incomplete(info) || (info.stype == VD && !info.ptr_depth)) {
+        ehdl::report(ehdl::E_FIELD_INCOMPLETE, field->pos, {*field->ident->name});
+      }
+      else {
+        records->add_field(record, field->ident->name, info);
+      }
+    }
+  }
+  records->finish(record);
 }
 
 void InitDeclarator::scopify() {
@@ -147,12 +298,18 @@ void InitDeclarator::scopify() {
 
 void Declaration::scopify() {
   cdebug << "Declaration::scopify: " << endl;
+  decl_specs->scopify();
   for (InitDeclarator *decl : *decl_list) {
     if (table->check_scope(decl->ident->name)) {
-      ehdl::err("Redeclaration of variable " + decl->ident->name, decl->pos);
+      ehdl::report(ehdl::E_REDECLARATION, decl->pos, {*decl->ident->name});
     }
     else {
-      table->add_symbol(decl->ident->name, {-1, decl->ptr_depth, typespecs2st(decl_specs->type_specs)});
+      SymbolInfo info = declared_type(decl_specs, decl->ptr_depth);
+      if (decl->array_size) info.array_size = array_length(decl);
+      if (is_incomplete(info)) {
+        ehdl::report(ehdl::E_VARIABLE_INCOMPLETE, decl->pos, {*decl->ident->name, (*records)[info.record].name()});
+      }
+      table->add_symbol(decl->ident->name, info);
       decl->ident->scopify();
       if(decl->init_expr){
         decl->init_expr->scopify();
@@ -176,10 +333,15 @@ void BlockStatement::scopify() {
 void PureDeclaration::scopify() {
   cdebug << "PureDeclaration::scopify: " << endl;
   if (table->check_scope(ident->name)) {
-    ehdl::err("Redeclaration of variable " + ident->name, pos);
+    ehdl::report(ehdl::E_REDECLARATION, pos, {*ident->name});
   }
   else {
-    table->add_symbol(ident->name, {-1, ptr_depth, typespecs2st(decl_specs->type_specs)});
+    decl_specs->scopify();
+    SymbolInfo info = declared_type(decl_specs, ptr_depth);
+    if (info.stype == REC && !ptr_depth) {
+      ehdl::report(ehdl::E_RECORD_PARAMETER, pos, {(*records)[info.record].name()});
+    }
+    table->add_symbol(ident->name, info);
     ident->scopify();
   }
 }
@@ -193,9 +355,14 @@ void FunctionParameterList::scopify() {
 }
 
 void Function::scopify() {
-  std::string name = func_decl->ident->name;
-  cdebug << "Function::scopify: " << name << endl;
-  table->add_symbol(name, {-1, func_decl->ptr_depth, typespecs2st(func_decl->decl_specs->type_specs)});
+  istring name = func_decl->ident->name;
+  cdebug << "Function::scopify: " << *name << endl;
+  func_decl->decl_specs->scopify();
+  SymbolInfo info = declared_type(func_decl->decl_specs, func_decl->ptr_depth);
+  if (info.stype == REC && !info.ptr_depth) {
+    ehdl::report(ehdl::E_RECORD_RETURN, func_decl->pos, {(*records)[info.record].name()});
+  }
+  table->add_symbol(name, info);
   func_decl->ident->scopify();
   cdebug<<"Function decl assigned type "<<typespecs2st(func_decl->decl_specs->type_specs)<<" ptr depth "<<func_decl->ptr_depth<<endl;
   table->reset_symb_identifier();
@@ -211,14 +378,13 @@ void TranslationUnit::scopify() {
     return;
   }
 
-  table = new SymbolTable();
+  table = &CompilerInstance::active()->symbols;
+  records = &CompilerInstance::active()->records;
 
   table->enter_scope();
 
   for (auto node : *nodes) {
       node->scopify();
   }
-
-  delete table;
 }
 };
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.hpp"
+
+SourceFile::~SourceFile() {
+    if (mapped) munmap((void*)data, size);
+}
+
+bool SourceFile::load() {
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        if (st.st_size > UINT32_MAX) {
+            close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            data = (const char*)addr;
+            size = st.st_size;
+            mapped = true;
+            madvise(addr, size, MADV_SEQUENTIAL);
+        }
+    }
+    if (!mapped) {
+        char buf[1 << 16];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof(buf))) > 0) contents.append(buf, n);
+        if (n < 0 || contents.size() > UINT32_MAX) {
+            close(fd);
+            return false;
+        }
+        data = contents.data();
+        size = contents.size();
+    }
+    close(fd);
+    return true;
+}
+
+void SourceFile::build_lines() const {
+    line_starts.push_back(0);
+    const char* p = data;
+    const char* end = data + size;
+    while ((p = (const char*)memchr(p, '\n', end - p))) {
+        p++;
+        line_starts.push_back(p - data);
+    }
+}
+
+pair<int, int> SourceFile::line_col(uint32_t offset) const {
+    std::call_once(lines_built, &SourceFile::build_lines, this);
+    int line = upper_bound(line_starts.begin(), line_starts.end(), offset) - line_starts.begin();
+    return {line, offset - line_starts[line - 1] + 1};
+}
+
+string_view SourceFile::line(int line) const {
+    std::call_once(lines_built, &SourceFile::build_lines, this);
+    if (line < 1 || line > line_starts.size()) return string_view();
+    size_t begin = line_starts[line - 1];
+    size_t end = (line < line_starts.size()) ? line_starts[line] - 1 : size;
+    return string_view(data + begin, end - begin);
+}
+
+const SourceFile* SourceManager::load(const string& name) {
+    auto it = files.find(name);
+    if (it != files.end()) return it->second.get();
+    auto file = make_unique<SourceFile>(name);
+    if (!file->load()) return nullptr;
+    return (files[name] = std::move(file)).get();
+}
+
+size_t SourceReader::read(char* buf, size_t max_size) {
+    string_view text = file->text();
+    size_t n = min(max_size, text.size() - next);
+    memcpy(buf, text.data() + next, n);
+    next += n;
+    return n;
+}
@@ -0,0 +1,73 @@
+#ifndef SOURCE
+#define SOURCE
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A source file, read once by mapping it into memory and shared by the
+// scanner and the diagnostics that quote it. Positions in it are byte offsets
+// (ast::sympos), which limits a file to 4 GB. The table of line starts that
+// turns an offset into a line and column is only built when a diagnostic
+// first needs one.
+class SourceFile {
+private:
+    string name;
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    string contents;                // files that cannot be mapped, like pipes
+
+    mutable std::once_flag lines_built;     // codegen threads share the file
+    mutable vector<uint32_t> line_starts;
+
+    void build_lines() const;
+
+public:
+    SourceFile(const string& name): name{name} {}
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    bool load();                    // false if the file cannot be read
+
+    const string& get_name() const { return name; }
+    string_view text() const { return string_view(data, size); }
+
+    // 1-based line and column of a byte offset
+    pair<int, int> line_col(uint32_t offset) const;
+    // a 1-based line, without its newline
+    string_view line(int line) const;
+};
+
+// The files of one unit. C has no modules and we have no preprocessor, so
+// this is the main file only, but diagnostics and the scanner never reopen
+// a file by name.
+class SourceManager {
+private:
+    unordered_map<string, unique_ptr<SourceFile>> files;
+
+public:
+    // maps the file on first use, nullptr if it cannot be read
+    const SourceFile* load(const string& name);
+};
+
+// How the flex scanner reads a file, see YY_INPUT in c.l. It tracks the
+// offset of the next token, which is what the scanner puts in yylloc.
+struct SourceReader {
+    const SourceFile* file;
+    size_t next = 0;                // bytes handed to the scanner so far
+    uint32_t offset = 0;
+
+    SourceReader(const SourceFile* file): file{file} {}
+    size_t read(char* buf, size_t max_size);
+};
+
+#endif
@@ -4,47 +4,54 @@
 
 using namespace std;
 
-SymbolTable::SymbolTable(): scopestack(), curr_symb_identifier{0}, depth{0} {}
+SymbolTable::SymbolTable(): heads(), bindings(), scope_marks(), curr_symb_identifier{0}, depth{0} {}
 
 void SymbolTable::enter_scope(){
   // cout<<"ENTERSCOPE---"<<endl;
   depth++;
-  unordered_map<string, SymbolInfo> newscope;
-  scopestack.push(newscope);
+  scope_marks.push_back(bindings.size());
 }
 
 void SymbolTable::exit_scope(){
   // cout<<"EXITSCOPE\n";
   depth--;
-  if(scopestack.empty()){
-    ehdl::err("Scope stack is empty while exiting scope", {});
+  if(scope_marks.empty()){
+    ehdl::report(ehdl::E_SCOPE_STACK_EMPTY, {}, {"exiting"});
   }
   else{
-    scopestack.pop();
+    // undo every binding made in this scope, restoring what it shadowed
+    size_t mark = scope_marks.back();
+    scope_marks.pop_back();
+    while(bindings.size() > mark){
+      ScopedBinding& b = bindings.back();
+      if(b.shadowed < 0){
+        heads.erase(b.name);
+      }
+      else{
+        heads[b.name] = b.shadowed;
+      }
+      bindings.pop_back();
+    }
   }
 }
 
-bool SymbolTable::check_scope(string x){
+bool SymbolTable::check_scope(istring x){
   // cout<<"CHECK:"<<x<<"->"<<endl;
-  if(scopestack.empty()){
-    ehdl::err("Scope stack is empty while checking scope", {});
+  if(scope_marks.empty()){
+    ehdl::report(ehdl::E_SCOPE_STACK_EMPTY, {}, {"checking"});
     return false; // can remove ig
   }
   else{
-    auto topscope = scopestack.top();
-    return (topscope.find(x) != topscope.end());
+    auto it = heads.find(x);
+    return (it != heads.end() && bindings[it->second].depth == depth);
   }
 }
 
-SymbolInfo SymbolTable::find_symbol(string x){
+SymbolInfo SymbolTable::find_symbol(istring x){
   // cout<<"FIND:"<<x<<"->"<<endl;
-  auto copystack = scopestack;
-  while(!copystack.empty()){
-    auto topscope = copystack.top();
-    if(topscope.find(x) != topscope.end()){
-      return topscope[x];
-    }
-    copystack.pop();
+  auto it = heads.find(x);
+  if(it != heads.end()){
+    return bindings[it->second].info;
   }
   return {-1, 0, UNK};
 }
@@ -53,9 +60,9 @@ void SymbolTable::reset_symb_identifier() {
     curr_symb_identifier = 0;
 }
 
-void SymbolTable::add_symbol(string x, SymbolInfo info){
+void SymbolTable::add_symbol(istring x, SymbolInfo info){
   if(check_scope(x)){
-    ehdl::err("Symbol " + x + " already exists in scope", {});
+    ehdl::report(ehdl::E_SYMBOL_EXISTS, {}, {*x});
   }
   else{
     if(depth == 1){
@@ -64,7 +71,9 @@ void SymbolTable::add_symbol(string x, SymbolInfo info){
     else{
       info.idx = curr_symb_identifier;
     }
-    scopestack.top()[x] = info;
+    auto it = heads.emplace(x, -1).first;
+    bindings.push_back({x, info, depth, it->second});
+    it->second = bindings.size() - 1;
     curr_symb_identifier++;
   }
 }
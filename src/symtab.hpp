@@ -2,8 +2,9 @@
 #define SYMBOLTABLE
 
 #include <unordered_map>
-#include <stack>
+#include <vector>
 #include <string>
+#include "intern.hpp"
 
 using namespace std;
 
@@ -22,6 +23,7 @@ enum SymbolType {
     PTR,
     FUNC,
     VD,
+    REC,        // struct or union, see SymbolInfo::record
     UNK
 };
 
@@ -29,11 +31,24 @@ struct SymbolInfo {
     int idx;
     int ptr_depth;
     SymbolType stype;
+    int array_size = 0;     // number of elements for arrays, 0 otherwise
+    int record = -1;        // index into the RecordTable for REC
+};
+
+// A single binding of a name. Bindings of the same name form a chain through
+// `shadowed`, innermost first, so lookup never has to walk the scope stack.
+struct ScopedBinding {
+    istring name;
+    SymbolInfo info;
+    int depth;
+    int shadowed;           // index of the binding this one hides, -1 if none
 };
 
 class SymbolTable {
 private:
-    std::stack<std::unordered_map<std::string, SymbolInfo>> scopestack;
+    std::unordered_map<istring, int> heads;         // name -> innermost binding
+    std::vector<ScopedBinding> bindings;            // doubles as the undo log
+    std::vector<size_t> scope_marks;                // bindings.size() at enter_scope
     int curr_symb_identifier;
      int depth;
 
@@ -41,11 +56,10 @@ public:
     SymbolTable();
     void enter_scope();
     void exit_scope();
-    void add_symbol(string x, SymbolInfo info);
+    void add_symbol(istring x, SymbolInfo info);
     void reset_symb_identifier();
-    SymbolInfo find_symbol(string x);
-    bool check_scope(string x);
+    SymbolInfo find_symbol(istring x);
+    bool check_scope(istring x);
 };
 
 #endif 
-
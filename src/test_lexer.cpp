@@ -0,0 +1,161 @@
+#include "lexer.hpp"
+#include "error.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+// Checks that the hand-written Lexer gives the same token stream as the flex
+// scanner, and measures both:
+//
+//   ./test_lexer examples/*.c
+
+// the flex scanner, generated from c.l
+int yylex_init_extra(SourceReader* reader, yyscan_t* scanner);
+int yylex_destroy(yyscan_t scanner);
+extern "C" int yylex(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, yyscan_t yyscanner);
+
+// what the rules of c.l have to agree on beyond the examples
+static const char* corner_cases = R"(
+#pragma unroll 4
+  #  pragma   novectorize(x)
+#pragma once
+#include <stdio.h>
+int8 _Bool __func__ _Static_assert double_ typedef_name u8 u U L
+u'a' U'\n' L'\'' 'ab' '\x4f' '\101' '\q' ''
+"a" "b"   u8"c"	L"d" "e\"f" "g\\" "h
+"i" x "j\z"
+0 00 07 08 0x 0x1f 0X1Fu 1u 1U 1l 1L 1ll 1LL 1ul 1llu 1LLU 1lu 1lL 1uu 12abc
+1. .5 1.5 1e5 1e 1e+ 1E-3f 1.e5 1.5l 0x1p3 0x.8p1 0x1.p-2 0x1.8 0x1.8P+3F 09.5 1..2 1.2.3
+... .. . -> ++ -- << >> <<= >>= <= >= == != && || *= /= %= += -= &= ^= |=
+<% %> <: :> %: ? ~ ! @ $ ` \ ;
+a/b/*c*/d//e
+/* * / ** */ x /**/ y /***/ z
+/* unterminated)";
+
+struct Token {
+  int tok;
+  ast::sympos pos;
+  istring str;
+};
+
+static bool has_value(int tok) {
+  return tok == IDENTIFIER || tok == I_CONSTANT || tok == F_CONSTANT || tok == STRING_LITERAL || tok == LOOP_PRAGMA;
+}
+
+static vector<Token> flex_tokens(const SourceFile* file) {
+  vector<Token> tokens;
+  SourceReader reader(file);
+  yyscan_t scanner;
+  yylex_init_extra(&reader, &scanner);
+  YYSTYPE lval;
+  YYLTYPE lloc;
+  while (int tok = yylex(&lval, &lloc, scanner)) {
+    tokens.push_back({tok, lloc, has_value(tok) ? lval.str : nullptr});
+  }
+  yylex_destroy(scanner);
+  return tokens;
+}
+
+static vector<Token> hand_tokens(const SourceFile* file) {
+  vector<Token> tokens;
+  Lexer lexer(file);
+  YYSTYPE lval;
+  YYLTYPE lloc;
+  while (int tok = lexer.next(&lval, &lloc)) {
+    tokens.push_back({tok, lloc, has_value(tok) ? lval.str : nullptr});
+  }
+  return tokens;
+}
+
+static string describe(const Token& t) {
+  stringstream s;
+  s << "token " << t.tok << " at [" << t.pos.begin << ", " << t.pos.end << ")";
+  if (t.str) s << " '" << *t.str << "'";
+  return s.str();
+}
+
+// true if both scanners agree on the file
+static bool compare(const SourceFile* file) {
+  vector<Token> expected = flex_tokens(file);
+  vector<Token> actual = hand_tokens(file);
+  for (size_t i = 0; i < max(expected.size(), actual.size()); i++) {
+    if (i < expected.size() && i < actual.size() && expected[i].tok == actual[i].tok &&
+        expected[i].pos.begin == actual[i].pos.begin && expected[i].pos.end == actual[i].pos.end &&
+        expected[i].str == actual[i].str) {
+      continue;
+    }
+    cout << file->get_name() << ": token " << i << " differs" << endl;
+    cout << "  flex: " << (i < expected.size() ? describe(expected[i]) : "end of file") << endl;
+    cout << "  hand: " << (i < actual.size() ? describe(actual[i]) : "end of file") << endl;
+    return false;
+  }
+  return true;
+}
+
+static string write_temp(const string& text) {
+  char name[] = "/tmp/test_lexer_XXXXXX";
+  int fd = mkstemp(name);
+  if (fd < 0 || write(fd, text.data(), text.size()) != (ssize_t)text.size()) {
+    cout << "Error: could not write " << name << endl;
+    exit(1);
+  }
+  close(fd);
+  return name;
+}
+
+// scans the file rounds times, returns the MB/s
+template<typename F>
+static double throughput(const SourceFile* file, int rounds, F scan) {
+  auto start = chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) scan(file);
+  chrono::duration<double> secs = chrono::steady_clock::now() - start;
+  return file->text().size() * rounds / secs.count() / 1e6;
+}
+
+int main(int argc, char** argv) {
+  const size_t BENCH_BYTES = 8 << 20;
+  const int ROUNDS = 3;
+  SourceManager sources;
+  string corner_file = write_temp(corner_cases);
+
+  vector<const SourceFile*> files;
+  files.push_back(sources.load(corner_file));
+  for (int i = 1; i < argc; i++) {
+    const SourceFile* file = sources.load(argv[i]);
+    if (!file) {
+      cout << "Error: could not open " << argv[i] << endl;
+      return 1;
+    }
+    files.push_back(file);
+  }
+
+  int mismatches = 0;
+  for (auto file : files) {
+    if (!compare(file)) mismatches++;
+  }
+
+  // the inputs over and over, as large generated sources are
+  string text;
+  while (text.size() < BENCH_BYTES) {
+    for (size_t i = 1; i < files.size(); i++) text += files[i]->text();
+    if (files.size() == 1) text += files[0]->text().substr(0, files[0]->text().rfind("/*"));
+  }
+  string bench_file = write_temp(text);
+  const SourceFile* bench = sources.load(bench_file);
+  double flex_mbs = throughput(bench, ROUNDS, flex_tokens);
+  double hand_mbs = throughput(bench, ROUNDS, hand_tokens);
+  unlink(corner_file.c_str());
+  unlink(bench_file.c_str());
+
+  cout << std::fixed << std::setprecision(1);
+  cout << std::left << std::setw(22) << "flex" << std::right << std::setw(10) << flex_mbs << " MB/s" << endl;
+  cout << std::left << std::setw(22) << "Lexer" << std::right << std::setw(10) << hand_mbs << " MB/s" << endl;
+  cout << mismatches << " of " << files.size() << " files scan differently" << endl;
+  return mismatches ? 1 : 0;
+}
@@ -1,19 +1,183 @@
 #include "ast.hpp"
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <random>
 
 using namespace std;
 
-void print_literal(ast::Literal& l) {
+// Checks the literal parsers against the C library and measures them:
+//
+//   ./test_literal              exactness and throughput over generated literals
+//   ./test_literal 0x8Af.38p2f  parses one floating constant and prints it
+
+namespace ast {
+void parse_int_literal(Literal* literal, const string& value);       // ast.cpp
+void parse_float_literal(Literal* literal, const string& value);
+}
+
+void print_literal(const string& text, ast::Literal& l) {
   double d = *((double*)&l.data);
-  cout << l.value << " " << std::setprecision(15) << d << " " << lt2str(l.ltype) << endl;
+  cout << text << " " << std::setprecision(15) << d << " " << lt2str(l.ltype) << endl;
+
+}
+
+// what the lexer accepts as a floating constant needs a '.' or an exponent
+static string as_float_constant(const char* s) {
+  string text = s;
+  if (text.find_first_of(".eEpP") == string::npos) text += ".";
+  return text;
+}
+
+// Floating constants the way generated tables have them: round trip digits of
+// arbitrary doubles, short decimals, long mantissas with large exponents, hex
+// floats and float constants.
+static vector<string> float_literals(size_t n) {
+  mt19937_64 rng(42);
+  vector<string> lits;
+  char buf[64];
+  while (lits.size() < n) {
+    unsigned long bits = rng();
+    double d;
+    float f;
+    switch (lits.size() % 5) {
+      case 0:
+        memcpy(&d, &bits, sizeof(d));
+        if (!isfinite(d)) continue;
+        snprintf(buf, sizeof(buf), "%.17g", fabs(d));
+        break;
+      case 1:
+        snprintf(buf, sizeof(buf), "%lu.%lu", bits % 1000, (bits >> 10) % 100000);
+        break;
+      case 2:
+        snprintf(buf, sizeof(buf), "%lu.%lue%d", bits % 100, (bits >> 7) % 10000000000000000000UL,
+                 int((bits >> 54) % 600) - 300);
+        break;
+      case 3:
+        memcpy(&d, &bits, sizeof(d));
+        if (!isfinite(d)) continue;
+        snprintf(buf, sizeof(buf), "%a", fabs(d));
+        break;
+      case 4: {
+        unsigned int fbits = bits;
+        memcpy(&f, &fbits, sizeof(f));
+        if (!isfinite(f)) continue;
+        snprintf(buf, sizeof(buf), "%.9g", fabs(f));
+        lits.push_back(as_float_constant(buf) + "f");
+        continue;
+      }
+    }
+    lits.push_back(as_float_constant(buf));
+  }
+  return lits;
+}
+
+// decimal, octal and hex constants with every suffix
+static vector<string> int_literals(size_t n) {
+  static const char* suffixes[] = {"", "u", "l", "ul", "LL", "llu", "Ul"};
+  mt19937_64 rng(7);
+  vector<string> lits;
+  char buf[64];
+  while (lits.size() < n) {
+    unsigned long v = rng() >> (rng() % 64);
+    const char* suffix = suffixes[lits.size() % 7];
+    switch (lits.size() % 3) {
+      // signed decimals past LONG_MAX warn, which is not what is measured
+      case 0: snprintf(buf, sizeof(buf), "%lu%s", strpbrk(suffix, "uU") ? v : v >> 1, suffix); break;
+      case 1: snprintf(buf, sizeof(buf), "0%lo%s", v, suffix); break;
+      case 2: snprintf(buf, sizeof(buf), "0x%lX%s", v, suffix); break;
+    }
+    lits.push_back(buf);
+  }
+  return lits;
+}
+
+static bool same_float(const string& text, ast::Literal& l) {
+  if (text.back() == 'f') {
+    float ref = strtof(text.substr(0, text.size() - 1).c_str(), nullptr);
+    return l.ltype == ast::LT_FLOAT && memcmp(&ref, &l.data.f, sizeof(float)) == 0;
+  }
+  double ref = strtod(text.c_str(), nullptr);
+  return l.ltype == ast::LT_DOUBLE && memcmp(&ref, &l.data.d, sizeof(double)) == 0;
+}
+
+// first type of C11 6.4.4.1 that holds v, for int and long of an LP64
+// target; long long is long. Decimals past LONG_MAX are unsigned, as in gcc
+static ast::LiteralType int_literal_type(const string& text, unsigned long v) {
+  size_t end = text.find_first_of("uUlL");
+  bool is_unsigned = end != string::npos && text.find_first_of("uU", end) != string::npos;
+  bool is_long = end != string::npos && text.find_first_of("lL", end) != string::npos;
+  bool decimal = text[0] != '0';
+  if (!is_unsigned && !is_long && v <= INT_MAX) return ast::LT_INT32;
+  if (!is_long && (is_unsigned || !decimal) && v <= UINT_MAX) return ast::LT_UINT32;
+  if (!is_unsigned && v <= LONG_MAX) return ast::LT_INT64;
+  return ast::LT_UINT64;
+}
+
+static bool same_int(const string& text, ast::Literal& l) {
+  unsigned long ref = strtoul(text.c_str(), nullptr, 0);
+  return (unsigned long) l.data.l == ref && l.ltype == int_literal_type(text, ref);
+}
+
+// parses every literal rounds times, returns the MB/s
+template<typename F>
+static double throughput(const vector<string>& lits, int rounds, F parse) {
+  size_t bytes = 0;
+  for (auto& text : lits) bytes += text.size();
+  auto start = chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (auto& text : lits) parse(text);
+  }
+  chrono::duration<double> secs = chrono::steady_clock::now() - start;
+  return bytes * rounds / secs.count() / 1e6;
+}
+
+static int benchmark() {
+  const size_t N = 200000;
+  const int ROUNDS = 5;
+  ast::Literal l(0L, ast::LT_DOUBLE);
+  volatile double sink = 0;
+  int mismatches = 0;
+
+  vector<string> floats = float_literals(N);
+  for (auto& text : floats) {
+    ast::parse_float_literal(&l, text);
+    if (!same_float(text, l)) {
+      if (mismatches++ < 10) cout << "mismatch: " << text << endl;
+    }
+  }
+  vector<string> ints = int_literals(N);
+  for (auto& text : ints) {
+    ast::parse_int_literal(&l, text);
+    if (!same_int(text, l)) {
+      if (mismatches++ < 10) cout << "mismatch: " << text << endl;
+    }
+  }
+
+  double float_mbs = throughput(floats, ROUNDS, [&](const string& text) { ast::parse_float_literal(&l, text); });
+  double strtod_mbs = throughput(floats, ROUNDS, [&](const string& text) { sink = strtod(text.c_str(), nullptr); });
+  double int_mbs = throughput(ints, ROUNDS, [&](const string& text) { ast::parse_int_literal(&l, text); });
+  double strtoul_mbs = throughput(ints, ROUNDS, [&](const string& text) { sink = strtoul(text.c_str(), nullptr, 0); });
 
+  cout << std::fixed << std::setprecision(1);
+  cout << std::left << std::setw(22) << "parse_float_literal" << std::right << std::setw(10) << float_mbs << " MB/s" << endl;
+  cout << std::left << std::setw(22) << "strtod" << std::right << std::setw(10) << strtod_mbs << " MB/s" << endl;
+  cout << std::left << std::setw(22) << "parse_int_literal" << std::right << std::setw(10) << int_mbs << " MB/s" << endl;
+  cout << std::left << std::setw(22) << "strtoul" << std::right << std::setw(10) << strtoul_mbs << " MB/s" << endl;
+  cout << mismatches << " of " << floats.size() + ints.size() << " literals differ from the C library" << endl;
+  return mismatches ? 1 : 0;
 }
 
 int main(int argc, char** argv) {
+  if (argc < 2) return benchmark();
 
   ast::Literal l(std::string(argv[1]), ast::LT_FLOAT_LIKE);
-  print_literal(l);
+  print_literal(argv[1], l);
   cout << 0x8Af.38p2f << endl;
 
   return 0;
@@ -0,0 +1,70 @@
+#include <iomanip>
+#include <map>
+#include <sys/resource.h>
+#include "timer.hpp"
+#include "ast.hpp"
+
+thread_local size_t n_tracked_allocs = 0;
+
+static double cpu_time_ms() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+static long peak_rss_kb() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+TimeReport::Scope::Scope(TimeReport& report, const string& name)
+    : report{report}, stats{name, 0, 0, 0, 0}, wall_start{std::chrono::steady_clock::now()},
+      cpu_start{cpu_time_ms()}, rss_start{peak_rss_kb()}, allocs_start{thread_alloc_count()}, trace{name} {}
+
+TimeReport::Scope::~Scope() {
+  stats.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start).count();
+  stats.cpu_ms = cpu_time_ms() - cpu_start;
+  stats.rss_kb = peak_rss_kb() - rss_start;
+  stats.allocs = thread_alloc_count() - allocs_start;
+  report.phases.push_back(stats);
+}
+
+
+void TimeReport::print(ostream& os, const string& filename, const Arena& arena) const {
+  os << "===-- time report: " << filename << " --===" << endl;
+  os << std::left << std::setw(14) << "phase" << std::right
+     << std::setw(12) << "wall (ms)" << std::setw(12) << "cpu (ms)"
+     << std::setw(12) << "rss (+KB)" << std::setw(12) << "allocs" << endl;
+
+  PhaseStats total{"total", 0, 0, 0, 0};
+  os << std::fixed << std::setprecision(3);
+  for (auto& p : phases) {
+    os << std::left << std::setw(14) << p.name << std::right
+       << std::setw(12) << p.wall_ms << std::setw(12) << p.cpu_ms
+       << std::setw(12) << p.rss_kb << std::setw(12) << p.allocs << endl;
+    total.wall_ms += p.wall_ms;
+    total.cpu_ms += p.cpu_ms;
+    total.rss_kb += p.rss_kb;
+    total.allocs += p.allocs;
+  }
+  os << std::left << std::setw(14) << total.name << std::right
+     << std::setw(12) << total.wall_ms << std::setw(12) << total.cpu_ms
+     << std::setw(12) << total.rss_kb << std::setw(12) << total.allocs << endl;
+  os.unsetf(std::ios::floatfield);
+
+  // every node lives in the unit's arena; subtrees dropped by constant
+  // propagation wait there to be reused and are not counted
+  std::map<string, size_t> counts;
+  size_t n_nodes = 0;
+  for (int kind = 0; kind <= ast::NK_TRANSLATION_UNIT; kind++) {
+    size_t n = arena.get_n_tagged(kind);
+    if (n) counts[ast::node_kind_name(ast::NodeKind(kind))] = n;
+    n_nodes += n;
+  }
+  os << "const_prop: " << n_folded << " expressions folded" << endl;
+  os << "ast nodes: " << n_nodes << " (" << arena.get_n_released() << " released)" << endl;
+  for (auto& c : counts) {
+    os << "  " << std::left << std::setw(30) << c.first << std::right << std::setw(8) << c.second << endl;
+  }
+}
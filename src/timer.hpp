@@ -0,0 +1,62 @@
+#ifndef TIMER
+#define TIMER
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "llvm/Support/TimeProfiler.h"
+#include "arena.hpp"
+
+using namespace std;
+
+struct PhaseStats {
+    string name;
+    double wall_ms;
+    double cpu_ms;          // whole process, includes helper threads
+    long rss_kb;            // growth of peak RSS during the phase
+    size_t allocs;          // by the arena and intern pool on the compiling thread
+};
+
+// Per-unit timings for --time-report. A Scope measures one phase; it also
+// opens a span in the LLVM time trace profiler, which is a no-op unless
+// --time-trace is on.
+class TimeReport {
+private:
+    vector<PhaseStats> phases;
+    size_t n_folded = 0;            // expressions const_prop replaced by literals
+
+public:
+    class Scope {
+    private:
+        TimeReport& report;
+        PhaseStats stats;
+        std::chrono::steady_clock::time_point wall_start;
+        double cpu_start;
+        long rss_start;
+        size_t allocs_start;
+        llvm::TimeTraceScope trace;
+
+    public:
+        Scope(TimeReport& report, const string& name);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    const vector<PhaseStats>& get_phases() const { return phases; }
+    void add_folded(size_t n) { n_folded += n; }
+
+    // phase table, the number of folded expressions and the number of live
+    // AST nodes of each type
+    void print(ostream& os, const string& filename, const Arena& arena) const;
+};
+
+// Allocations the compiler's own allocators made on this thread so far: AST
+// nodes and blocks from an Arena, strings added to an InternPool. LLVM's are
+// not counted, so nothing else pays for the report.
+extern thread_local size_t n_tracked_allocs;
+inline void count_alloc() { n_tracked_allocs++; }
+inline size_t thread_alloc_count() { return n_tracked_allocs; }
+
+#endif
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "ast.hpp"
+
+namespace ast {
+
+// Dispatches on Node::kind to Derived::visitX. Unimplemented visits fall back
+// to the visit of the base class (visitExpression, visitStatement,
+// visitLoopStatement, then visitNode), so a pass only writes the cases it
+// cares about:
+//
+//   struct CallCounter : ASTVisitor<CallCounter, int> {
+//     int visitFunctionInvocationExpression(FunctionInvocationExpression*) { return 1; }
+//   };
+template<typename Derived, typename RetTy = void>
+class ASTVisitor {
+public:
+  RetTy visit(Node* node) {
+    switch (node->kind) {
+      case NK_IDENTIFIER: return derived().visitIdentifier(cast<Identifier>(node));
+      case NK_TERNARY: return derived().visitTernaryExpression(cast<TernaryExpression>(node));
+      case NK_CALL: return derived().visitFunctionInvocationExpression(cast<FunctionInvocationExpression>(node));
+      case NK_BINARY: return derived().visitBinaryExpression(cast<BinaryExpression>(node));
+      case NK_UNARY: return derived().visitUnaryExpression(cast<UnaryExpression>(node));
+      case NK_SUBSCRIPT: return derived().visitSubscriptExpression(cast<SubscriptExpression>(node));
+      case NK_MEMBER: return derived().visitMemberExpression(cast<MemberExpression>(node));
+      case NK_TYPE_NAME: return derived().visitTypeName(cast<TypeName>(node));
+      case NK_LITERAL: return derived().visitLiteral(cast<Literal>(node));
+      case NK_DECLARATION_STATEMENT: return derived().visitDeclarationStatement(cast<DeclarationStatement>(node));
+      case NK_EXPRESSION_STATEMENT: return derived().visitExpressionStatement(cast<ExpressionStatement>(node));
+      case NK_IF: return derived().visitIfStatement(cast<IfStatement>(node));
+      case NK_SWITCH: return derived().visitSwitchStatement(cast<SwitchStatement>(node));
+      case NK_WHILE: return derived().visitWhileStatement(cast<WhileStatement>(node));
+      case NK_DO_WHILE: return derived().visitDoWhileStatement(cast<DoWhileStatement>(node));
+      case NK_FOR: return derived().visitForStatement(cast<ForStatement>(node));
+      case NK_RETURN: return derived().visitReturnStatement(cast<ReturnStatement>(node));
+      case NK_GOTO: return derived().visitGotoStatement(cast<GotoStatement>(node));
+      case NK_CONTINUE: return derived().visitContinueStatement(cast<ContinueStatement>(node));
+      case NK_BREAK: return derived().visitBreakStatement(cast<BreakStatement>(node));
+      case NK_BLOCK: return derived().visitBlockStatement(cast<BlockStatement>(node));
+      case NK_LABELED: return derived().visitLabeledStatement(cast<LabeledStatement>(node));
+      case NK_CASE: return derived().visitCaseStatement(cast<CaseStatement>(node));
+      case NK_RECORD_SPECIFIER: return derived().visitRecordSpecifier(cast<RecordSpecifier>(node));
+      case NK_DECLARATION_SPECIFIERS: return derived().visitDeclarationSpecifiers(cast<DeclarationSpecifiers>(node));
+      case NK_PURE_DECLARATION: return derived().visitPureDeclaration(cast<PureDeclaration>(node));
+      case NK_PARAMETER_LIST: return derived().visitFunctionParameterList(cast<FunctionParameterList>(node));
+      case NK_INIT_DECLARATOR: return derived().visitInitDeclarator(cast<InitDeclarator>(node));
+      case NK_DECLARATION: return derived().visitDeclaration(cast<Declaration>(node));
+      case NK_FUNCTION: return derived().visitFunction(cast<Function>(node));
+      case NK_TRANSLATION_UNIT: return derived().visitTranslationUnit(cast<TranslationUnit>(node));
+    }
+    llvm_unreachable("unknown node kind");
+  }
+
+  RetTy visitNode(Node* node) { return RetTy(); }
+  RetTy visitExpression(Expression* node) { return derived().visitNode(node); }
+  RetTy visitStatement(Statement* node) { return derived().visitNode(node); }
+  RetTy visitLoopStatement(LoopStatement* node) { return derived().visitStatement(node); }
+
+  RetTy visitIdentifier(Identifier* node) { return derived().visitExpression(node); }
+  RetTy visitTernaryExpression(TernaryExpression* node) { return derived().visitExpression(node); }
+  RetTy visitFunctionInvocationExpression(FunctionInvocationExpression* node) { return derived().visitExpression(node); }
+  RetTy visitBinaryExpression(BinaryExpression* node) { return derived().visitExpression(node); }
+  RetTy visitUnaryExpression(UnaryExpression* node) { return derived().visitExpression(node); }
+  RetTy visitSubscriptExpression(SubscriptExpression* node) { return derived().visitExpression(node); }
+  RetTy visitMemberExpression(MemberExpression* node) { return derived().visitExpression(node); }
+  RetTy visitTypeName(TypeName* node) { return derived().visitExpression(node); }
+  RetTy visitLiteral(Literal* node) { return derived().visitExpression(node); }
+
+  RetTy visitDeclarationStatement(DeclarationStatement* node) { return derived().visitStatement(node); }
+  RetTy visitExpressionStatement(ExpressionStatement* node) { return derived().visitStatement(node); }
+  RetTy visitIfStatement(IfStatement* node) { return derived().visitStatement(node); }
+  RetTy visitSwitchStatement(SwitchStatement* node) { return derived().visitStatement(node); }
+  RetTy visitWhileStatement(WhileStatement* node) { return derived().visitLoopStatement(node); }
+  RetTy visitDoWhileStatement(DoWhileStatement* node) { return derived().visitLoopStatement(node); }
+  RetTy visitForStatement(ForStatement* node) { return derived().visitLoopStatement(node); }
+  RetTy visitReturnStatement(ReturnStatement* node) { return derived().visitStatement(node); }
+  RetTy visitGotoStatement(GotoStatement* node) { return derived().visitStatement(node); }
+  RetTy visitContinueStatement(ContinueStatement* node) { return derived().visitStatement(node); }
+  RetTy visitBreakStatement(BreakStatement* node) { return derived().visitStatement(node); }
+  RetTy visitBlockStatement(BlockStatement* node) { return derived().visitStatement(node); }
+  RetTy visitLabeledStatement(LabeledStatement* node) { return derived().visitStatement(node); }
+  RetTy visitCaseStatement(CaseStatement* node) { return derived().visitStatement(node); }
+
+  RetTy visitRecordSpecifier(RecordSpecifier* node) { return derived().visitNode(node); }
+  RetTy visitDeclarationSpecifiers(DeclarationSpecifiers* node) { return derived().visitNode(node); }
+  RetTy visitPureDeclaration(PureDeclaration* node) { return derived().visitNode(node); }
+  RetTy visitFunctionParameterList(FunctionParameterList* node) { return derived().visitNode(node); }
+  RetTy visitInitDeclarator(InitDeclarator* node) { return derived().visitNode(node); }
+  RetTy visitDeclaration(Declaration* node) { return derived().visitNode(node); }
+  RetTy visitFunction(Function* node) { return derived().visitNode(node); }
+  RetTy visitTranslationUnit(TranslationUnit* node) { return derived().visitNode(node); }
+
+private:
+  Derived& derived() { return *static_cast<Derived*>(this); }
+};
+
+// Walks a subtree in pre-order: visits a node, then traverses its children in
+// source order. A visit returning false ends the whole traversal, which
+// traverse then reports by returning false. Null children are skipped.
+//
+//   struct AddressTakenFinder : RecursiveASTVisitor<AddressTakenFinder> {
+//     bool visitUnaryExpression(UnaryExpression* un_exp) { ...; return true; }
+//   };
+//   AddressTakenFinder().traverse(func->stmts);
+template<typename Derived>
+class RecursiveASTVisitor : public ASTVisitor<Derived, bool> {
+public:
+  bool visitNode(Node* node) { return true; }
+
+  bool traverse(Node* node) {
+    if (!node) return true;
+    if (!this->visit(node)) return false;
+    return traverse_children(node);
+  }
+
+  template<typename T>
+  bool traverse(std::vector<T*>* nodes) {
+    if (!nodes) return true;
+    for (T* node : *nodes) {
+      if (!traverse(node)) return false;
+    }
+    return true;
+  }
+
+  bool traverse_children(Node* node) {
+    switch (node->kind) {
+      case NK_IDENTIFIER:
+      case NK_LITERAL:
+      case NK_GOTO:
+      case NK_CONTINUE:
+      case NK_BREAK:
+        return true;
+      case NK_TERNARY: {
+        TernaryExpression* n = cast<TernaryExpression>(node);
+        return traverse(n->cond) && traverse(n->true_branch) && traverse(n->false_branch);
+      }
+      case NK_CALL: {
+        FunctionInvocationExpression* n = cast<FunctionInvocationExpression>(node);
+        return traverse(n->fn) && traverse(n->params);
+      }
+      case NK_BINARY: {
+        BinaryExpression* n = cast<BinaryExpression>(node);
+        return traverse(n->lhs) && traverse(n->rhs);
+      }
+      case NK_UNARY:
+        return traverse(cast<UnaryExpression>(node)->expr);
+      case NK_SUBSCRIPT: {
+        SubscriptExpression* n = cast<SubscriptExpression>(node);
+        return traverse(n->base) && traverse(n->index);
+      }
+      case NK_MEMBER:
+        return traverse(cast<MemberExpression>(node)->base);
+      case NK_TYPE_NAME:
+        return traverse(cast<TypeName>(node)->decl_specs);
+      case NK_DECLARATION_STATEMENT:
+        return traverse(cast<DeclarationStatement>(node)->decl);
+      case NK_EXPRESSION_STATEMENT:
+        return traverse(cast<ExpressionStatement>(node)->expr);
+      case NK_IF: {
+        IfStatement* n = cast<IfStatement>(node);
+        return traverse(n->cond) && traverse(n->true_branch) && traverse(n->false_branch);
+      }
+      case NK_SWITCH: {
+        SwitchStatement* n = cast<SwitchStatement>(node);
+        return traverse(n->expr) && traverse(n->stmt);
+      }
+      case NK_WHILE: {
+        WhileStatement* n = cast<WhileStatement>(node);
+        return traverse(n->cond) && traverse(n->stmt);
+      }
+      case NK_DO_WHILE: {
+        DoWhileStatement* n = cast<DoWhileStatement>(node);
+        return traverse(n->stmt) && traverse(n->cond);
+      }
+      case NK_FOR: {
+        ForStatement* n = cast<ForStatement>(node);
+        return traverse(n->init) && traverse(n->cond) && traverse(n->step) && traverse(n->stmt);
+      }
+      case NK_RETURN:
+        return traverse(cast<ReturnStatement>(node)->ret_expr);
+      case NK_BLOCK: {
+        for (Statement* stmt : *cast<BlockStatement>(node)) {
+          if (!traverse(stmt)) return false;
+        }
+        return true;
+      }
+      case NK_LABELED: {
+        LabeledStatement* n = cast<LabeledStatement>(node);
+        return traverse(n->label) && traverse(n->stmt);
+      }
+      case NK_CASE: {
+        CaseStatement* n = cast<CaseStatement>(node);
+        return traverse(n->const_expr) && traverse(n->stmt);
+      }
+      case NK_RECORD_SPECIFIER:
+        return traverse(cast<RecordSpecifier>(node)->fields);
+      case NK_DECLARATION_SPECIFIERS:
+        return traverse(cast<DeclarationSpecifiers>(node)->record_spec);
+      case NK_PURE_DECLARATION: {
+        PureDeclaration* n = cast<PureDeclaration>(node);
+        return traverse(n->decl_specs) && traverse(n->ident);
+      }
+      case NK_PARAMETER_LIST:
+        return traverse(cast<FunctionParameterList>(node)->params);
+      case NK_INIT_DECLARATOR: {
+        InitDeclarator* n = cast<InitDeclarator>(node);
+        return traverse(n->ident) && traverse(n->array_size) && traverse(n->init_expr);
+      }
+      case NK_DECLARATION: {
+        Declaration* n = cast<Declaration>(node);
+        return traverse(n->decl_specs) && traverse(n->decl_list);
+      }
+      case NK_FUNCTION: {
+        Function* n = cast<Function>(node);
+        return traverse(n->func_decl) && traverse(n->params) && traverse(n->stmts);
+      }
+      case NK_TRANSLATION_UNIT:
+        return traverse(cast<TranslationUnit>(node)->nodes);
+    }
+    llvm_unreachable("unknown node kind");
+  }
+};
+
+}